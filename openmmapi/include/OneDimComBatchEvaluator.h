@@ -0,0 +1,77 @@
+#ifndef OPENMM_ONEDIMCOMBATCHEVALUATOR_H_
+#define OPENMM_ONEDIMCOMBATCHEVALUATOR_H_
+
+
+#include "OneDimComForce.h"
+#include <string>
+#include <vector>
+#include "internal/OneDimComReduction.h"
+#include "internal/windowsExportExample.h"
+
+namespace OpenMM {
+class ThreadPool;
+}
+
+namespace OneDimComPlugin {
+
+/**
+ * This class evaluates the displacement and energy of a OneDimComForce for many
+ * frames of a trajectory, without creating a Context.  Frames are split between
+ * threads, and each one is reduced with the same atom list and signed weights the
+ * platform kernels use.
+ *
+ * The energy is the one a Context would report for the force: the harmonic restraint
+ * plus any variance restraint, the displacement itself when the force acts as a
+ * collective variable, and 0 when it acts as a constraint.
+ *
+ * A frame is numAtoms consecutive (x, y, z) triples of 32 bit floats, and frames
+ * are stored one after another.
+ */
+
+class OPENMM_EXPORT_EXAMPLE OneDimComBatchEvaluator {
+public:
+    /**
+     * Create a OneDimComBatchEvaluator.  The definition of the force is copied, so
+     * later changes to it have no effect.
+     *
+     * @param force        the force to evaluate
+     * @param numThreads   the number of threads to use, or 0 to use one per core
+     */
+    OneDimComBatchEvaluator(const OneDimComForce& force, int numThreads=0);
+    ~OneDimComBatchEvaluator();
+    int getNumThreads() const;
+    /**
+     * Evaluate frames held in memory.
+     *
+     * @param coordinates     numFrames*numAtoms*3 coordinates
+     * @param numAtoms        the number of atoms in each frame
+     * @param numFrames       the number of frames
+     * @param displacements   on exit, the displacement in each frame.  This must have room for numFrames values.
+     * @param energies        on exit, the energy in each frame.  This must have room for numFrames values, or may be NULL.
+     */
+    void evaluate(const float* coordinates, int numAtoms, long long numFrames, double* displacements, double* energies);
+    /**
+     * Evaluate every frame in a raw binary coordinate file.  The file is memory mapped
+     * rather than read.
+     *
+     * @param filename        the file to evaluate
+     * @param numAtoms        the number of atoms in each frame
+     * @param displacements   on exit, the displacement in each frame
+     * @param energies        on exit, the energy in each frame
+     */
+    void evaluateFile(const std::string& filename, int numAtoms, std::vector<double>& displacements, std::vector<double>& energies);
+private:
+    OneDimComBatchEvaluator(const OneDimComBatchEvaluator&);
+    OneDimComBatchEvaluator& operator=(const OneDimComBatchEvaluator&);
+    class EvaluateTask;
+    class MappedFile;
+    double computeEnergy(double displacement, double variance) const;
+    OneDimComReduction reduction;
+    double k, r0, varianceForceConst, variance0;
+    bool useConstraint, useAsCollectiveVariable;
+    OpenMM::ThreadPool* threads;
+};
+
+} // namespace OneDimComPlugin
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef OPENMM_ONEDIMCOMCOLVARREADER_H_
+#define OPENMM_ONEDIMCOMCOLVARREADER_H_
+
+
+#include <string>
+#include <vector>
+#include "internal/windowsExportExample.h"
+
+namespace OneDimComPlugin {
+
+/**
+ * This class loads a colvar file written by a OneDimComForce (see
+ * OneDimComForce::setColvarFile()) into arrays.
+ */
+
+class OPENMM_EXPORT_EXAMPLE OneDimComColvarReader {
+public:
+    /**
+     * Read a colvar file.
+     *
+     * @param filename   the file to read
+     */
+    OneDimComColvarReader(const std::string& filename);
+
+    int getNumRecords() const;
+    const std::vector<long long>& getSteps() const;
+    const std::vector<float>& getDisplacements() const;
+    const std::vector<float>& getEnergies() const;
+private:
+    std::vector<long long> steps;
+    std::vector<float> displacements;
+    std::vector<float> energies;
+};
+
+} // namespace OneDimComPlugin
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef OPENMM_ONEDIMCOMCOMBINATIONFORCE_H_
+#define OPENMM_ONEDIMCOMCOMBINATIONFORCE_H_
+
+
+#include "openmm/Context.h"
+#include "openmm/Force.h"
+#include <vector>
+#include "internal/windowsExportExample.h"
+
+namespace OneDimComPlugin {
+
+/**
+ * This class implements a harmonic force of the form E = 0.5 * k * (X - r_0)^2,
+ * where X = sum_g c_g * x_g is a linear combination of the centers x_g of any
+ * number of groups along the x axis, and r_0 is the equilibrium value.
+ *
+ * For example, the position of a peptide relative to the average of two
+ * leaflets uses coefficients 1, -0.5 and -0.5.  All groups are reduced
+ * together in a single pass.
+ */
+
+class OPENMM_EXPORT_EXAMPLE OneDimComCombinationForce : public OpenMM::Force {
+public:
+    /**
+     * Create an OneDimComCombinationForce with no groups.
+     */
+    OneDimComCombinationForce(float k, float r0);
+
+    int getNumGroups() const;
+    /**
+     * Add a group to the combination.
+     *
+     * @param indices      the indices of the atoms in the group
+     * @param weights      the weight of each atom, which must sum to 1
+     * @param coefficient  the coefficient of this group's center in the combination
+     * @return the index of the group that was added
+     */
+    int addGroup(const std::vector<int>& indices, const std::vector<float>& weights, float coefficient);
+    const std::vector<int>& getGroupIndices(int index) const;
+    const std::vector<float>& getGroupWeights(int index) const;
+    float getGroupCoefficient(int index) const;
+    float getForceConst() const;
+    float getR0() const;
+
+    void setGroupParameters(int index, const std::vector<int>& indices, const std::vector<float>& weights, float coefficient);
+    void setForceConst(float k);
+    void setR0(float r0);
+
+    void updateParametersInContext(OpenMM::Context& context);
+    void validate();
+protected:
+    OpenMM::ForceImpl* createImpl() const;
+private:
+    class GroupInfo;
+    std::vector<GroupInfo> groups;
+    float k, r0;
+};
+
+/**
+ * This is an internal class used to record information about a group.
+ * @private
+ */
+class OneDimComCombinationForce::GroupInfo {
+public:
+    std::vector<int> indices;
+    std::vector<float> weights;
+    float coefficient;
+    GroupInfo() : coefficient(0.0) {
+    }
+    GroupInfo(const std::vector<int>& indices, const std::vector<float>& weights, float coefficient) :
+            indices(indices), weights(weights), coefficient(coefficient) {
+    }
+};
+
+} // namespace OneDimComPlugin
+
+#endif
@@ -4,6 +4,9 @@
 
 #include "openmm/Context.h"
 #include "openmm/Force.h"
+#include "openmm/Platform.h"
+#include <map>
+#include <string>
 #include <vector>
 #include "internal/windowsExportExample.h"
 
@@ -38,16 +41,464 @@ public:
     void setForceConst(float k);
     void setR0(float r0);
 
+    /**
+     * Get whether the evaluation cache is enabled.  When enabled, repeated
+     * evaluations at the same time, periodic box and parameters reuse the
+     * displacement from the previous evaluation instead of reducing the
+     * groups again, as long as the group coordinates are unchanged.
+     */
+    bool getUseEvaluationCache() const;
+    /**
+     * Set whether the evaluation cache is enabled.  OpenMM does not tell forces
+     * when positions are set, so a cached displacement is only reused after the
+     * coordinates of the group atoms have been checked against a checksum taken
+     * when it was computed.  That check reads the coordinates but not the weights,
+     * and is done on the device, so positions set without advancing time, as by
+     * setPositions() or an energy minimizer, are always picked up.
+     */
+    void setUseEvaluationCache(bool use);
+    /**
+     * Get whether the displacement is held at r0 by a constraint instead of
+     * the harmonic restraint.
+     */
+    bool getUseConstraint() const;
+    /**
+     * Set whether the displacement is held at r0 by a constraint instead of
+     * the harmonic restraint.  At the start of each step the positions and
+     * velocities of the group atoms are projected so the displacement is exactly
+     * r0 and does not change, and the force constant is ignored.
+     *
+     * A force cannot act after the integrator has moved the atoms, so the projection
+     * lags integration by one step.  Forces are always computed from projected
+     * positions, but the positions returned by getState() after step() are those
+     * the integrator produced, and their displacement differs from r0 by the drift
+     * of that step until the next step begins.  The group atoms must not take part
+     * in any other constraints.
+     */
+    void setUseConstraint(bool use);
+    /**
+     * Get whether the force acts as a collective variable instead of a restraint.
+     */
+    bool getUseAsCollectiveVariable() const;
+    /**
+     * Set whether the force acts as a collective variable instead of a restraint.
+     * The energy is then the displacement itself and the forces are minus its
+     * gradient, with the force constant and r0 ignored.  This is meant for use
+     * inside a CustomCVForce, where it costs a single reduction over the groups
+     * plus a constant force on each group atom.  The CustomCVForce still evaluates
+     * it in its own inner Context, which this mode cannot avoid.  Code that
+     * composes the variable itself can skip that by combining getDisplacement()
+     * with getCollectiveVariableGradient().  It cannot be combined with the
+     * constraint.
+     */
+    void setUseAsCollectiveVariable(bool use);
+    /**
+     * Get the number of steps between evaluations of the restraint.
+     */
+    int getEvaluationStride() const;
+    /**
+     * Get whether the forces are applied as impulses on the evaluation steps, rather
+     * than held between them.
+     */
+    bool getUseImpulse() const;
+    /**
+     * Evaluate the restraint only on every stride'th step, for multiple time step
+     * integration with an ordinary integrator.  With impulses the forces are
+     * multiplied by stride on the evaluation steps and are zero in between, which
+     * gives the same average force and is the usual r-RESPA splitting.  Otherwise the
+     * force from the most recent evaluation is applied unchanged on every step.
+     * Either way, the energy reported by getState() is always that of the current
+     * positions, which costs a reduction (but no forces) on steps in between.  The
+     * stride cannot be combined with the constraint or collective variable modes.
+     *
+     * @param stride       the number of steps between evaluations, where 1 evaluates
+     *                     every step
+     * @param useImpulse   true to apply scaled forces only on evaluation steps, false
+     *                     to hold the most recent force in between
+     */
+    void setEvaluationStride(int stride, bool useImpulse=true);
+    /**
+     * Get the rate at which r0 changes with time, in nm/ps.
+     */
+    double getR0Rate() const;
+    /**
+     * Get the rate at which the force constant changes with time, in kJ/mol/nm^2/ps.
+     */
+    double getForceConstRate() const;
+    /**
+     * Change r0 and the force constant linearly with the simulation time, for steered
+     * pulling.  At time t the force uses r0 + r0Rate*t and k + forceConstRate*t, where
+     * r0 and k are those of the active parameter set.  This only applies when the force
+     * acts as a restraint.  Both rates default to 0.
+     *
+     * @param r0Rate           the rate at which r0 changes, in nm/ps
+     * @param forceConstRate   the rate at which the force constant changes
+     */
+    void setPullingSchedule(double r0Rate, double forceConstRate=0.0);
+    /**
+     * Get which group's variance is restrained: 0 for none, 1 or 2 for that group.
+     */
+    int getVarianceGroup() const;
+    /**
+     * Get the force constant of the variance restraint, in kJ/mol/nm^4.
+     */
+    double getVarianceForceConst() const;
+    /**
+     * Get the equilibrium variance of the variance restraint, in nm^2.
+     */
+    double getVariance0() const;
+    /**
+     * Add a harmonic restraint on the spread of one group along the axis, such as a
+     * membrane thickness.  The variance is the weighted variance of the x coordinates,
+     * var = sum(w*x^2) - sum(w*x)^2, and the energy gains a term
+     * 0.5*varianceK*(var - variance0)^2.  Both moments are computed in the same pass
+     * over the atoms as the displacement.  Set the main force constant to 0 to restrain
+     * only the variance.  This can only be used when the force acts as a restraint
+     * without an evaluation stride.
+     *
+     * @param group       the group to restrain, 1 or 2, or 0 to remove the restraint
+     * @param varianceK   the force constant, in kJ/mol/nm^4
+     * @param variance0   the equilibrium variance, in nm^2
+     */
+    void setVarianceRestraint(int group, double varianceK, double variance0);
+    /**
+     * Get whether r0 is a dynamical variable, as set by setExtendedLagrangian().
+     */
+    bool getUseExtendedLagrangian() const;
+    /**
+     * Get the name of the Context parameter that holds the dynamical r0.  Its velocity
+     * is held by a parameter with "Velocity" appended.
+     */
+    const std::string& getExtendedParameterName() const;
+    /**
+     * Get the mass of the dynamical r0, in kJ/mol*ps^2/nm^2 (equivalently amu).
+     */
+    double getExtendedMass() const;
+    /**
+     * Get the temperature the dynamical r0 is coupled to, in K.
+     */
+    double getExtendedTemperature() const;
+    /**
+     * Get the friction coefficient of the dynamical r0, in 1/ps.
+     */
+    double getExtendedFriction() const;
+    /**
+     * Get the random number seed of the dynamical r0's thermostat.
+     */
+    int getExtendedRandomSeed() const;
+    /**
+     * Turn r0 into a fictitious particle that is coupled to the displacement through the
+     * harmonic term, as in temperature accelerated MD (TAMD/d-AFED).  It has its own
+     * mass, and a Langevin thermostat at its own temperature, usually well above that
+     * of the system.  The force integrates it once per step, before the forces are
+     * computed, with the same step size as the integrator.  The coupling uses the
+     * displacement of the latest evaluation the device has finished copying back,
+     * without ever waiting for it.  That is normally the evaluation of the previous
+     * step, so r0 lags the system by one step, but it can be older when the device
+     * runs further behind the host.  After a checkpoint is loaded, or the time is
+     * otherwise set to a step that doesn't follow the last one, the groups are
+     * reduced once on the spot instead.
+     *
+     * Its position and velocity are Context parameters, so they are included in
+     * checkpoints and can be read or set with Context::getParameter() and
+     * Context::setParameter().  The thermostat's random numbers are drawn afresh from
+     * the seed and the step number every step, so with a nonzero seed a run continued
+     * from a checkpoint gets the same noise as one that never stopped.  The
+     * position starts at r0, and overrides the r0 of the active parameter set.  Its
+     * moves are part of the dynamics, so they are not counted by getAccumulatedWork().
+     * This can only be used when the force acts as a restraint, and not together with
+     * a pulling schedule.
+     *
+     * @param name          the name of the Context parameter to hold r0
+     * @param mass          the mass of r0, or 0 to make r0 a fixed parameter again
+     * @param temperature   the temperature of the thermostat, in K
+     * @param friction      the friction coefficient of the thermostat, in 1/ps
+     * @param randomSeed    the seed of the thermostat's random numbers, or 0 to pick one
+     */
+    void setExtendedLagrangian(const std::string& name, double mass, double temperature, double friction, int randomSeed=0);
+    /**
+     * Get the number of displacement thresholds that are watched for crossings.
+     */
+    int getNumThresholds() const;
+    /**
+     * Add a threshold on the displacement, such as a milestone or a forward flux
+     * interface.  Every evaluation compares the displacement with each threshold,
+     * and the first time one is crossed the step and direction are recorded in the
+     * Context, without any transfer back to the host.  Thresholds are not checked
+     * when the force acts as a constraint.
+     *
+     * @param value    the displacement of the threshold, in nm
+     * @return the index of the threshold that was added
+     */
+    int addThreshold(double value);
+    /**
+     * Get the displacement of a threshold, in nm.
+     */
+    double getThreshold(int index) const;
+    /**
+     * Set the displacement of a threshold, in nm.
+     */
+    void setThreshold(int index, double value);
+    /**
+     * Get the file the displacement and energy are streamed to, or an empty
+     * string if they are not recorded.
+     */
+    const std::string& getColvarFile() const;
+    /**
+     * Get the number of steps between records in the colvar file.
+     */
+    int getColvarInterval() const;
+    /**
+     * Stream the displacement, energy and step number to a binary colvar file
+     * every interval steps.  The energy includes the variance restraint, if there
+     * is one.  The displacement is copied from the device without waiting for it,
+     * and the file is written from a background thread, so a simulation never
+     * stops for either.  The file is complete once the Context is destroyed, and
+     * can be loaded with OneDimComColvarReader.  Pass an empty filename to stop
+     * recording.  This takes effect when a Context is created.  Only one Context at
+     * a time can write a given file, so creating a second Context from the same
+     * System while the first still exists throws an exception.  Give each Context
+     * its own file by changing the filename before creating it.
+     *
+     * @param filename   the file to write, which is overwritten
+     * @param interval   the number of steps between records
+     */
+    void setColvarFile(const std::string& filename, int interval);
+
+    /**
+     * Get the number of parameter sets.  Set 0 is always the force's own force
+     * constant, r0 and weights, and the rest were added with addParameterSet().
+     */
+    int getNumParameterSets() const;
+    /**
+     * Add a parameter set that a Context can switch to with setActiveParameterSet().
+     * The groups are the same as for the force's own parameters and only the
+     * weights may differ.  Sets added after a Context was created only reach it
+     * through updateParametersInContext().
+     *
+     * @param k          the force constant
+     * @param r0         the equilibrium displacement
+     * @param weights1   the weights of the group 1 atoms
+     * @param weights2   the weights of the group 2 atoms
+     * @return the index of the new set
+     */
+    int addParameterSet(float k, float r0, const std::vector<float>& weights1, const std::vector<float>& weights2);
+    /**
+     * Get the parameters of a set.
+     *
+     * @param index           the index of the set
+     * @param[out] k          the force constant
+     * @param[out] r0         the equilibrium displacement
+     * @param[out] weights1   the weights of the group 1 atoms
+     * @param[out] weights2   the weights of the group 2 atoms
+     */
+    void getParameterSet(int index, float& k, float& r0, std::vector<float>& weights1, std::vector<float>& weights2) const;
+    /**
+     * Change the parameters of a set added with addParameterSet().  Set 0 is changed
+     * with the ordinary setters instead.
+     *
+     * @param index      the index of the set
+     * @param k          the force constant
+     * @param r0         the equilibrium displacement
+     * @param weights1   the weights of the group 1 atoms
+     * @param weights2   the weights of the group 2 atoms
+     */
+    void setParameterSet(int index, float k, float r0, const std::vector<float>& weights1, const std::vector<float>& weights2);
+    /**
+     * Get which parameter set is in use in a Context.
+     */
+    int getActiveParameterSet(OpenMM::Context& context);
+    /**
+     * Switch the parameter set in use in a Context.  Every set is already held by the
+     * platform, so this takes the same time no matter how large the groups are.  New
+     * Contexts start with set 0.
+     *
+     * @param context   the Context to switch
+     * @param index     the index of the set to use
+     */
+    void setActiveParameterSet(OpenMM::Context& context, int index);
+    /**
+     * Publish a new force constant and r0 for the active parameter set of a Context,
+     * without stopping the thread that is integrating it.  This may be called from
+     * another thread, such as an adaptive steering controller, while the simulation is
+     * running.  It never blocks, and the next force evaluation picks up the most
+     * recently published values, so intermediate ones may be skipped.  Only one thread
+     * may publish to a Context at a time.
+     *
+     * The values only live in the Context.  Neither the force nor the parameter set
+     * they override is changed, and a later updateParametersInContext() or
+     * setActiveParameterSet() drops them, so switching away from a set and back
+     * restores its own values.
+     *
+     * @param context   the Context to publish to
+     * @param k         the new force constant
+     * @param r0        the new equilibrium displacement
+     */
+    void publishParameters(OpenMM::Context& context, float k, float r0);
+    /**
+     * Publish a new force constant, r0 and group weights for the active parameter set
+     * of a Context.  This behaves like the version without weights.
+     *
+     * @param context    the Context to publish to
+     * @param k          the new force constant
+     * @param r0         the new equilibrium displacement
+     * @param weights1   the new weights of the group 1 atoms
+     * @param weights2   the new weights of the group 2 atoms
+     */
+    void publishParameters(OpenMM::Context& context, float k, float r0, const std::vector<float>& weights1, const std::vector<float>& weights2);
+
     void updateParametersInContext(OpenMM::Context& context);
     void validate();
+
+    /**
+     * Get the gradient of the displacement with respect to the positions.  Only the
+     * x coordinates of the group atoms contribute and the displacement is linear in
+     * them, so the gradient is constant and is returned in sparse form.  An atom
+     * that appears in both groups is listed once.
+     *
+     * @param particles   on exit, the indices of the group atoms in increasing order
+     * @param gradient    on exit, the derivative of the displacement with respect to
+     *                    the x coordinate of each of those atoms
+     */
+    void getCollectiveVariableGradient(std::vector<int>& particles, std::vector<double>& gradient) const;
+
+    /**
+     * Get the current displacement between the groups in a Context.
+     */
+    double getDisplacement(OpenMM::Context& context);
+    /**
+     * Get the generalized force along the displacement that the constraint exerted
+     * during the most recent step, in kJ/mol/nm.  Because the displacement is linear
+     * in the positions its mass metric is constant, so the average of this over a
+     * simulation is the derivative of the free energy with respect to r0.  This is
+     * only meaningful when the constraint is in use.
+     */
+    double getConstraintForce(OpenMM::Context& context);
+    /**
+     * Get a description of how the platform reduces the groups in a Context.  Each
+     * platform times its options the first time it sees a group of a given size
+     * class (the number of bits needed to hold the number of atoms), and reuses the
+     * choice for every later Context in the same process.
+     */
+    std::string getExecutionStrategy(OpenMM::Context& context);
+    /**
+     * Get the variance of the restrained group, in nm^2, as of the last force evaluation
+     * of a Context.  This is 0 if there is no variance restraint.
+     */
+    double getVariance(OpenMM::Context& context);
+    /**
+     * Get the nonequilibrium work done on a Context by changes to the force constant
+     * and r0, in kJ/mol, since it was created or the work was last reset.  Whenever
+     * the parameters used by an evaluation differ from those of the previous one, the
+     * difference between the energies under the new and old parameters at the new
+     * positions is added.  That covers the pulling schedule, updateParametersInContext()
+     * and setActiveParameterSet() alike, and is the discrete work that appears in the
+     * Jarzynski and Crooks relations.  The moves of a dynamical r0 are not included.
+     * Work is only accumulated when the force acts as a restraint, and with an
+     * evaluation stride only on the evaluation steps.
+     */
+    double getAccumulatedWork(OpenMM::Context& context);
+    /**
+     * Set the work accumulated in a Context back to 0.
+     */
+    void resetAccumulatedWork(OpenMM::Context& context);
+    /**
+     * Get the first threshold crossing recorded in a Context since it was created or
+     * the event was last reset.  A crossing is seen when the displacements of two
+     * consecutive evaluations lie on opposite sides of a threshold.  If several are
+     * crossed at once, the one closest to the earlier displacement, which is the one
+     * the trajectory passed first, is reported.
+     *
+     * @param context     the Context to query
+     * @param threshold   on exit, the index of the threshold that was crossed
+     * @param step        on exit, the step of the evaluation that saw the crossing
+     * @param direction   on exit, 1 if the displacement increased through the
+     *                    threshold and -1 if it decreased
+     * @return true if a crossing was recorded, false otherwise
+     */
+    bool getThresholdEvent(OpenMM::Context& context, int& threshold, long long& step, int& direction);
+    /**
+     * Clear the recorded crossing so the next one can be seen.  The displacement of
+     * the next evaluation is taken as the new starting point, so this should also be
+     * called after positions are changed by hand.
+     */
+    void resetThresholdEvent(OpenMM::Context& context);
+    /**
+     * Step the integrator of a Context until a threshold is crossed.  The steps are
+     * taken in blocks of checkInterval, and the event is only read back between
+     * blocks, so up to checkInterval-1 steps may follow the crossing.  The step it
+     * happened on is available from getThresholdEvent().
+     *
+     * @param context         the Context to integrate
+     * @param steps           the maximum number of steps to take
+     * @param checkInterval   the number of steps between checks for an event
+     * @return the number of steps that were taken
+     */
+    int stepUntilThreshold(OpenMM::Context& context, int steps, int checkInterval=100);
+    /**
+     * Compute the energy of the current configuration of a Context under a set of
+     * windows, each with its own force constant and r0.  The displacement is only
+     * reduced once, however many windows there are.  The parameters of the force
+     * itself are not changed.  A variance restraint adds the same term to the energy
+     * of every window.
+     *
+     * @param context   the Context to evaluate
+     * @param ks        the force constant of each window
+     * @param r0s       the equilibrium displacement of each window
+     * @return the energy under each window
+     */
+    std::vector<double> computeWindowEnergies(OpenMM::Context& context, const std::vector<double>& ks, const std::vector<double>& r0s);
+
+    /**
+     * Compile the kernels used by the forces in this plugin ahead of time, so they
+     * are already in the platform's on-disk kernel cache when a real Context first
+     * evaluates them.  For the CUDA platform this is the directory given by the
+     * CudaTempDirectory property, which can be shared between processes.
+     *
+     * @param platform     the platform to compile the kernels for
+     * @param properties   platform properties, such as the device to compile for
+     */
+    static void prewarmKernels(OpenMM::Platform& platform, const std::map<std::string, std::string>& properties=std::map<std::string, std::string>());
 protected:
     OpenMM::ForceImpl* createImpl() const;
 private:
+    class ParameterSetInfo;
+    void validateWeights(const std::vector<float>& weights1, const std::vector<float>& weights2) const;
     std::vector<int> group1;
     std::vector<int> group2;
     std::vector<float> weights1;
     std::vector<float> weights2;
     float k, r0;
+    bool useEvaluationCache;
+    bool useConstraint;
+    bool useAsCollectiveVariable;
+    int evaluationStride;
+    bool useImpulse;
+    double r0Rate, forceConstRate;
+    std::vector<double> thresholds;
+    int varianceGroup;
+    double varianceForceConst, variance0;
+    std::string extendedName;
+    double extendedMass, extendedTemperature, extendedFriction;
+    int extendedRandomSeed;
+    std::string colvarFile;
+    int colvarInterval;
+    std::vector<ParameterSetInfo> parameterSets;
+};
+
+/**
+ * This is an internal class used to record information about a parameter set.
+ * @private
+ */
+class OneDimComForce::ParameterSetInfo {
+public:
+    float k, r0;
+    std::vector<float> weights1, weights2;
+    ParameterSetInfo() : k(0.0), r0(0.0) {
+    }
+    ParameterSetInfo(float k, float r0, const std::vector<float>& weights1, const std::vector<float>& weights2) :
+            k(k), r0(r0), weights1(weights1), weights2(weights2) {
+    }
 };
 
 } // namespace OneDimComPlugin
@@ -33,6 +33,9 @@
  * -------------------------------------------------------------------------- */
 
 #include "OneDimComForce.h"
+#include "OneDimComCombinationForce.h"
+#include "OneDimComPairwiseForce.h"
+#include "OneDimComRegionForce.h"
 #include "openmm/KernelImpl.h"
 #include "openmm/Platform.h"
 #include "openmm/System.h"
@@ -67,7 +70,196 @@ public:
      */
     virtual double execute(OpenMM::ContextImpl& context, bool includeForces, bool includeEnergy) = 0;
     /**
-     * Copy changed parameters over to a context.
+     * Execute the kernel reusing the displacement kept by the most recent evaluation,
+     * skipping the reduction over the group atoms.  This is only valid if the
+     * parameters have not changed since then and refreshDisplacement() has been called
+     * for the current positions.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    virtual double executeCached(OpenMM::ContextImpl& context, bool includeForces, bool includeEnergy) = 0;
+    /**
+     * Execute the kernel with the displacement itself as the energy, adding minus its
+     * gradient to the forces.  The force constant and r0 are not used.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param reduce         true if the displacement should be computed from the current
+     *                       positions, false to reuse the most recent one, which must
+     *                       have been refreshed as for executeCached()
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    virtual double executeCollectiveVariable(OpenMM::ContextImpl& context, bool reduce, bool includeForces, bool includeEnergy) = 0;
+    /**
+     * Execute the kernel for a force that is only evaluated every few steps.  The forces
+     * come from the kept displacement and the energy from the current positions, which
+     * differ between evaluations.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param reduce         true if the displacement should be computed from the current
+     *                       positions and kept, false to keep the previous one
+     * @param forceScale     the factor to multiply the forces by, or 0 to apply none
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    virtual double executeStride(OpenMM::ContextImpl& context, bool reduce, double forceScale, bool includeEnergy) = 0;
+    /**
+     * Get the displacement computed by the most recent call to execute() or computeDisplacement().
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    virtual double getDisplacement(OpenMM::ContextImpl& context) = 0;
+    /**
+     * Compute the displacement for the current positions without applying any forces
+     * or energy, along with the variance of a restrained group.  The result is kept
+     * just like one computed by execute().
+     *
+     * @param context        the context in which to execute this kernel
+     * @return the displacement
+     */
+    virtual double computeDisplacement(OpenMM::ContextImpl& context) = 0;
+    /**
+     * Make sure the kept displacement, and the variance of a restrained group, belong
+     * to the current positions.  The coordinates of the group atoms are compared with
+     * those the displacement was computed from, through a checksum where reading them
+     * back would be expensive, and the displacement is only computed again if they
+     * differ.  This never waits for the device.
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    virtual void refreshDisplacement(OpenMM::ContextImpl& context) = 0;
+    /**
+     * Project the positions and velocities of the group atoms so that the displacement
+     * is exactly r0 and has no velocity, and record the constraint force this required.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param stepSize       the size of the step that produced the current positions
+     */
+    virtual void applyConstraint(OpenMM::ContextImpl& context, double stepSize) = 0;
+    /**
+     * Get the generalized force along the displacement exerted by the most recent call
+     * to applyConstraint().
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    virtual double getConstraintForce(OpenMM::ContextImpl& context) = 0;
+    /**
+     * Get a description of the strategy chosen for reducing the groups, such as
+     * "serial" or "blocks=1 threads=256".
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    virtual std::string getExecutionStrategy(OpenMM::ContextImpl& context) = 0;
+    /**
+     * Switch to another of the parameter sets copied by initialize() or
+     * copyParametersToContext().
+     *
+     * @param context        the context in which to execute this kernel
+     * @param index          the index of the set to use
+     */
+    virtual void setActiveParameterSet(OpenMM::ContextImpl& context, int index) = 0;
+    /**
+     * Override the force constant and r0 of the active set until the next call to this,
+     * setActiveParameterSet() or copyParametersToContext().
+     *
+     * @param context        the context in which to execute this kernel
+     * @param k              the force constant to use
+     * @param r0             the equilibrium displacement to use
+     * @param doesWork       true if the change should be counted by getWork(), false if it
+     *                       is part of the dynamics, as for a dynamical r0
+     */
+    virtual void setScheduledParameters(OpenMM::ContextImpl& context, double k, double r0, bool doesWork) = 0;
+    /**
+     * Override the force constant, r0 and optionally the weights of the active set with
+     * values published by OneDimComForce::publishParameters(), until the next call to
+     * setActiveParameterSet() or copyParametersToContext().  The stored sets are not
+     * changed.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param k              the force constant to use
+     * @param r0             the equilibrium displacement to use
+     * @param weights1       the weights of the group 1 atoms, or an empty vector to keep them
+     * @param weights2       the weights of the group 2 atoms, or an empty vector to keep them
+     */
+    virtual void setPublishedParameters(OpenMM::ContextImpl& context, double k, double r0,
+            const std::vector<float>& weights1, const std::vector<float>& weights2) = 0;
+    /**
+     * Get the work accumulated by execute(), executeCached() and executeStride() from
+     * changes in the parameters between one evaluation and the next.
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    virtual double getWork(OpenMM::ContextImpl& context) = 0;
+    /**
+     * Get the variance of the restrained group from the last call to execute() or
+     * computeDisplacement().
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    virtual double getVariance(OpenMM::ContextImpl& context) = 0;
+    /**
+     * The number of displacements recordDisplacement() can hold before they are collected.
+     */
+    static const int MaxRecordedDisplacements = 64;
+    /**
+     * Start copying the displacement and variance of the last evaluation to the host,
+     * without waiting for the copy to finish, so they can be collected later by
+     * getRecordedDisplacement().  No more than MaxRecordedDisplacements may be waiting
+     * to be collected at once.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param reduce         true if the displacement should first be computed from the
+     *                       current positions and kept, as by computeDisplacement()
+     */
+    virtual void recordDisplacement(OpenMM::ContextImpl& context, bool reduce) = 0;
+    /**
+     * Collect the oldest displacement and variance started by recordDisplacement().
+     *
+     * @param context        the context in which to execute this kernel
+     * @param wait           true to wait for the copy to finish, false to give up if it hasn't
+     * @param displacement   on exit, the recorded displacement
+     * @param variance       on exit, the recorded variance, or 0 if there is no variance restraint
+     * @return true if a displacement was collected, false if none was waiting or ready
+     */
+    virtual bool getRecordedDisplacement(OpenMM::ContextImpl& context, bool wait, double& displacement, double& variance) = 0;
+    /**
+     * Set the accumulated work to 0.
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    virtual void resetWork(OpenMM::ContextImpl& context) = 0;
+    /**
+     * Compare the displacement of the last evaluation with that of the one before,
+     * and if no crossing is recorded yet, record the threshold between them that
+     * lies closest to the earlier one.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param step           the step of the last evaluation
+     */
+    virtual void checkThresholds(OpenMM::ContextImpl& context, long long step) = 0;
+    /**
+     * Get the recorded threshold crossing.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param threshold      on exit, the index of the threshold that was crossed
+     * @param step           on exit, the step it was crossed on
+     * @param direction      on exit, the direction it was crossed in
+     * @return true if a crossing was recorded
+     */
+    virtual bool getThresholdEvent(OpenMM::ContextImpl& context, int& threshold, long long& step, int& direction) = 0;
+    /**
+     * Clear the recorded crossing and forget the previous displacement.
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    virtual void resetThresholdEvent(OpenMM::ContextImpl& context) = 0;
+    /**
+     * Copy changed parameters, including every parameter set, over to a context.  The
+     * active set is not changed.
      *
      * @param context    the context to copy parameters to
      * @param force      the OneDimComForce to copy the parameters from
@@ -75,6 +267,120 @@ public:
     virtual void copyParametersToContext(OpenMM::ContextImpl& context, const OneDimComForce& force) = 0;
 };
 
+/**
+ * This kernel is invoked by OneDimComCombinationForce to calculate the forces acting on the system and the energy of the system.
+ */
+class CalcOneDimComCombinationForceKernel : public OpenMM::KernelImpl {
+public:
+    static std::string Name() {
+        return "CalcOneDimComCombinationForce";
+    }
+    CalcOneDimComCombinationForceKernel(std::string name, const OpenMM::Platform& platform) : OpenMM::KernelImpl(name, platform) {
+    }
+    /**
+     * Initialize the kernel.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param force      the OneDimComCombinationForce this kernel will be used for
+     */
+    virtual void initialize(const OpenMM::System& system, const OneDimComCombinationForce& force) = 0;
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    virtual double execute(OpenMM::ContextImpl& context, bool includeForces, bool includeEnergy) = 0;
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the OneDimComCombinationForce to copy the parameters from
+     */
+    virtual void copyParametersToContext(OpenMM::ContextImpl& context, const OneDimComCombinationForce& force) = 0;
+};
+
+/**
+ * This kernel is invoked by OneDimComRegionForce to calculate the forces acting on the system and the energy of the system.
+ */
+class CalcOneDimComRegionForceKernel : public OpenMM::KernelImpl {
+public:
+    static std::string Name() {
+        return "CalcOneDimComRegionForce";
+    }
+    CalcOneDimComRegionForceKernel(std::string name, const OpenMM::Platform& platform) : OpenMM::KernelImpl(name, platform) {
+    }
+    /**
+     * Initialize the kernel.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param force      the OneDimComRegionForce this kernel will be used for
+     */
+    virtual void initialize(const OpenMM::System& system, const OneDimComRegionForce& force) = 0;
+    /**
+     * Rebuild the list of candidate atoms close enough to the region to be evaluated,
+     * if asked to or if any candidate has moved further than half the skin since the
+     * list was last built.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param force          true if the list must be rebuilt regardless of how far the candidates have moved
+     */
+    virtual void refreshRegion(OpenMM::ContextImpl& context, bool force) = 0;
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    virtual double execute(OpenMM::ContextImpl& context, bool includeForces, bool includeEnergy) = 0;
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the OneDimComRegionForce to copy the parameters from
+     */
+    virtual void copyParametersToContext(OpenMM::ContextImpl& context, const OneDimComRegionForce& force) = 0;
+};
+
+/**
+ * This kernel is invoked by OneDimComPairwiseForce to calculate the forces acting on the system and the energy of the system.
+ */
+class CalcOneDimComPairwiseForceKernel : public OpenMM::KernelImpl {
+public:
+    static std::string Name() {
+        return "CalcOneDimComPairwiseForce";
+    }
+    CalcOneDimComPairwiseForceKernel(std::string name, const OpenMM::Platform& platform) : OpenMM::KernelImpl(name, platform) {
+    }
+    /**
+     * Initialize the kernel.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param force      the OneDimComPairwiseForce this kernel will be used for
+     */
+    virtual void initialize(const OpenMM::System& system, const OneDimComPairwiseForce& force) = 0;
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    virtual double execute(OpenMM::ContextImpl& context, bool includeForces, bool includeEnergy) = 0;
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the OneDimComPairwiseForce to copy the parameters from
+     */
+    virtual void copyParametersToContext(OpenMM::ContextImpl& context, const OneDimComPairwiseForce& force) = 0;
+};
+
 }
 
 #endif /*EXAMPLE_KERNELS_H_*/
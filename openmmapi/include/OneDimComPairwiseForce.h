@@ -0,0 +1,119 @@
+#ifndef OPENMM_ONEDIMCOMPAIRWISEFORCE_H_
+#define OPENMM_ONEDIMCOMPAIRWISEFORCE_H_
+
+
+#include "openmm/Context.h"
+#include "openmm/Force.h"
+#include <vector>
+#include "internal/windowsExportExample.h"
+
+namespace OneDimComPlugin {
+
+/**
+ * This class restrains the separations along the x axis between the centers of
+ * any number of groups.  Each pair adds a term of the form
+ * E = 0.5 * k * (x_2 - x_1 - r_0)^2, where x_1 and x_2 are the centers of its two
+ * groups.  A wall only applies its term on one side of r_0.
+ *
+ * Every group is reduced to its center once per evaluation, however many pairs
+ * it takes part in, so restraining all N(N-1)/2 separations between N groups
+ * costs little more than restraining one.
+ */
+
+class OPENMM_EXPORT_EXAMPLE OneDimComPairwiseForce : public OpenMM::Force {
+public:
+    /**
+     * The form of the term applied to a pair.
+     */
+    enum PairType {
+        /**
+         * A harmonic restraint on both sides of r0.
+         */
+        Harmonic = 0,
+        /**
+         * A harmonic wall that only acts when the separation is below r0.
+         */
+        LowerWall = 1,
+        /**
+         * A harmonic wall that only acts when the separation is above r0.
+         */
+        UpperWall = 2
+    };
+    /**
+     * Create an OneDimComPairwiseForce with no groups or pairs.
+     */
+    OneDimComPairwiseForce();
+
+    int getNumGroups() const;
+    int getNumPairs() const;
+    /**
+     * Add a group whose center can be used by pairs.
+     *
+     * @param indices      the indices of the atoms in the group
+     * @param weights      the weight of each atom, which must sum to 1
+     * @return the index of the group that was added
+     */
+    int addGroup(const std::vector<int>& indices, const std::vector<float>& weights);
+    /**
+     * Add a restraint on the separation x_2 - x_1 between the centers of two groups.
+     *
+     * @param group1       the index of the first group
+     * @param group2       the index of the second group
+     * @param k            the force constant
+     * @param r0           the equilibrium separation, or the position of the wall
+     * @param type         the form of the term
+     * @return the index of the pair that was added
+     */
+    int addPair(int group1, int group2, float k, float r0, PairType type=Harmonic);
+    const std::vector<int>& getGroupIndices(int index) const;
+    const std::vector<float>& getGroupWeights(int index) const;
+    void getPairParameters(int index, int& group1, int& group2, float& k, float& r0, PairType& type) const;
+
+    void setGroupParameters(int index, const std::vector<int>& indices, const std::vector<float>& weights);
+    void setPairParameters(int index, int group1, int group2, float k, float r0, PairType type=Harmonic);
+
+    void updateParametersInContext(OpenMM::Context& context);
+    void validate();
+protected:
+    OpenMM::ForceImpl* createImpl() const;
+private:
+    class GroupInfo;
+    class PairInfo;
+    std::vector<GroupInfo> groups;
+    std::vector<PairInfo> pairs;
+};
+
+/**
+ * This is an internal class used to record information about a group.
+ * @private
+ */
+class OneDimComPairwiseForce::GroupInfo {
+public:
+    std::vector<int> indices;
+    std::vector<float> weights;
+    GroupInfo() {
+    }
+    GroupInfo(const std::vector<int>& indices, const std::vector<float>& weights) :
+            indices(indices), weights(weights) {
+    }
+};
+
+/**
+ * This is an internal class used to record information about a pair.
+ * @private
+ */
+class OneDimComPairwiseForce::PairInfo {
+public:
+    int group1, group2;
+    float k, r0;
+    PairType type;
+    PairInfo() : group1(-1), group2(-1), k(0.0), r0(0.0), type(Harmonic) {
+    }
+    PairInfo(int group1, int group2, float k, float r0, PairType type) :
+            group1(group1), group2(group2), k(k), r0(r0), type(type) {
+    }
+};
+
+} // namespace OneDimComPlugin
+
+#endif
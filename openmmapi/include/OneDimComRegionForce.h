@@ -0,0 +1,79 @@
+#ifndef OPENMM_ONEDIMCOMREGIONFORCE_H_
+#define OPENMM_ONEDIMCOMREGIONFORCE_H_
+
+
+#include "openmm/Context.h"
+#include "openmm/Force.h"
+#include <vector>
+#include "internal/windowsExportExample.h"
+
+namespace OneDimComPlugin {
+
+/**
+ * This class implements a harmonic force of the form E = 0.5 * k * (X_R - x_1 - r_0)^2,
+ * where x_1 is the weighted center of a fixed group along the x axis, and X_R is the
+ * center of mass of those candidate atoms that lie inside a slab lower <= x <= upper.
+ *
+ * Membership of the slab is switched smoothly to zero over a distance switchWidth
+ * outside each face, so the forces stay continuous as atoms enter and leave.  Rather
+ * than test every candidate at every step, the atoms within switchWidth + skin of
+ * the slab are collected into an active list every refreshInterval steps, and only
+ * those are evaluated in between.  Every evaluation also finds the largest distance
+ * any candidate has moved since the list was built, which is done on the device
+ * without waiting for it, and rebuilds the list early once that exceeds skin/2, so
+ * a candidate can never reach the switching region unseen.  As the switched mass of the region falls below the mass of the lightest
+ * candidate, the restraint is faded out smoothly along with it, so the region
+ * contributes nothing once it is empty without the energy jumping on the way.
+ */
+
+class OPENMM_EXPORT_EXAMPLE OneDimComRegionForce : public OpenMM::Force {
+public:
+    /**
+     * Create an OneDimComRegionForce.
+     *
+     * @param group1      the indices of the atoms in the fixed group
+     * @param weights1    the weight of each atom in the fixed group, which must sum to 1
+     * @param candidates  the indices of the atoms that may enter the slab
+     * @param lower       the lower face of the slab
+     * @param upper       the upper face of the slab
+     * @param k           the force constant
+     * @param r0          the equilibrium displacement
+     */
+    OneDimComRegionForce(const std::vector<int>& group1, const std::vector<float>& weights1,
+            const std::vector<int>& candidates, float lower, float upper, float k, float r0);
+
+    const std::vector<int>& getGroup1Indices() const;
+    const std::vector<float>& getGroup1Weights() const;
+    const std::vector<int>& getCandidates() const;
+    float getLower() const;
+    float getUpper() const;
+    float getSwitchWidth() const;
+    float getSkin() const;
+    int getRefreshInterval() const;
+    float getForceConst() const;
+    float getR0() const;
+
+    void setGroup1Weights(const std::vector<float>& weights);
+    void setRegion(float lower, float upper);
+    void setSwitchWidth(float width);
+    void setSkin(float skin);
+    void setRefreshInterval(int interval);
+    void setForceConst(float k);
+    void setR0(float r0);
+
+    void updateParametersInContext(OpenMM::Context& context);
+    void validate();
+protected:
+    OpenMM::ForceImpl* createImpl() const;
+private:
+    std::vector<int> group1;
+    std::vector<float> weights1;
+    std::vector<int> candidates;
+    float lower, upper, switchWidth, skin;
+    int refreshInterval;
+    float k, r0;
+};
+
+} // namespace OneDimComPlugin
+
+#endif
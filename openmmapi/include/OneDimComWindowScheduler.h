@@ -0,0 +1,119 @@
+#ifndef OPENMM_ONEDIMCOMWINDOWSCHEDULER_H_
+#define OPENMM_ONEDIMCOMWINDOWSCHEDULER_H_
+
+
+#include "OneDimComForce.h"
+#include "openmm/Context.h"
+#include "openmm/Integrator.h"
+#include "openmm/Platform.h"
+#include "openmm/System.h"
+#include <random>
+#include <vector>
+#include "internal/windowsExportExample.h"
+
+namespace OpenMM {
+class ThreadPool;
+}
+
+namespace OneDimComPlugin {
+
+/**
+ * This class runs many umbrella windows in a single process.  Every window has its
+ * own Context, but they all share one System, and with it one copy of the group
+ * definitions.  Windows differ only in the force constant and r0 of a OneDimComForce
+ * in that System.
+ *
+ * step() advances all windows at once on a pool of threads, which take windows one
+ * at a time from a shared counter so that slow windows don't hold up the others.
+ * This is meant for the Reference and CPU platforms, where each Context runs on the
+ * thread that calls it.
+ *
+ * attemptExchanges() performs Hamiltonian replica exchange between neighboring
+ * windows.  The acceptance test only needs the displacement of each Context, and an
+ * accepted exchange swaps the window parameters of the two Contexts rather than
+ * their coordinates, so no state is ever copied.
+ *
+ * Each window is stored as a parameter set of the OneDimComForce that is passed in,
+ * and the scheduler adds these sets to that force itself rather than to a copy, since
+ * the Contexts are created from the caller's System.  The sets remain in the force
+ * after the scheduler is deleted, so any Context created later from the same System
+ * holds them as well, and the indices returned by later calls to addParameterSet()
+ * start after them.
+ */
+
+class OPENMM_EXPORT_EXAMPLE OneDimComWindowScheduler {
+public:
+    /**
+     * Create a OneDimComWindowScheduler with no windows.
+     *
+     * @param system       the System shared by every window.  It must outlive the scheduler.
+     * @param force        the OneDimComForce in system whose parameters vary between windows.
+     *                     The scheduler permanently adds a parameter set to it for each window,
+     *                     so it must not be shared with another scheduler.
+     * @param platform     the platform to create Contexts for
+     * @param numThreads   the number of threads to use, or 0 to use one per core
+     */
+    OneDimComWindowScheduler(const OpenMM::System& system, OneDimComForce& force, OpenMM::Platform& platform, int numThreads=0);
+    ~OneDimComWindowScheduler();
+    /**
+     * Add a window.  Windows should be added in order of r0, since exchanges are only
+     * attempted between neighbors.
+     *
+     * @param integrator   the integrator for the window, which the scheduler takes ownership of
+     * @param k            the force constant of the window
+     * @param r0           the equilibrium displacement of the window
+     * @return the index of the window that was added
+     */
+    int addWindow(OpenMM::Integrator* integrator, double k, double r0);
+    int getNumWindows() const;
+    int getNumThreads() const;
+    double getForceConst(int window) const;
+    double getR0(int window) const;
+    /**
+     * Get the Context that is currently sampling a window.  This changes when an
+     * exchange is accepted.
+     */
+    OpenMM::Context& getContext(int window);
+    /**
+     * Advance every window by a number of steps.
+     */
+    void step(int steps);
+    /**
+     * Get the current displacement in every window.
+     */
+    std::vector<double> getDisplacements();
+    /**
+     * Attempt exchanges between neighboring windows.  Successive calls alternate
+     * between pairing windows (0,1), (2,3), ... and (1,2), (3,4), ...
+     *
+     * @param temperature   the temperature of the simulations, in Kelvin
+     * @return the number of exchanges that were accepted
+     */
+    int attemptExchanges(double temperature);
+    /**
+     * Set the seed for the random numbers used to accept or reject exchanges.
+     */
+    void setRandomNumberSeed(int seed);
+private:
+    OneDimComWindowScheduler(const OneDimComWindowScheduler&);
+    OneDimComWindowScheduler& operator=(const OneDimComWindowScheduler&);
+    class StepTask;
+    void setWindowParameters(int window);
+    const OpenMM::System& system;
+    OneDimComForce& force;
+    OpenMM::Platform& platform;
+    OpenMM::ThreadPool* threads;
+    std::vector<OpenMM::Integrator*> integrators;
+    std::vector<OpenMM::Context*> contexts;
+    std::vector<double> ks, r0s;
+    // the index in contexts of the Context sampling each window
+    std::vector<int> windowContext;
+    // the parameter set of each window, and the number of sets each Context holds
+    std::vector<int> windowSet, contextSets;
+    int exchangeOffset;
+    std::mt19937 random;
+};
+
+} // namespace OneDimComPlugin
+
+#endif
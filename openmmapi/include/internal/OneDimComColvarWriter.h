@@ -0,0 +1,91 @@
+#ifndef OPENMM_ONEDIMCOMCOLVARWRITER_H_
+#define OPENMM_ONEDIMCOMCOLVARWRITER_H_
+
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "windowsExportExample.h"
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace OneDimComPlugin {
+
+/**
+ * This class streams the displacement and energy of a force to a binary colvar
+ * file from a background thread.  Records are collected in a front buffer that
+ * is handed to the writer thread once it is full, so the simulation thread never
+ * waits on the disk.  If the writer is still busy with the previous buffer, the
+ * front buffer keeps filling, but once it holds a second block the simulation
+ * thread waits for the writer, so no more than four blocks are ever held in memory.
+ *
+ * Only one writer in a process may have a given file open at a time, and creating
+ * a second one for it throws an exception without touching the file.
+ *
+ * The file starts with the 8 byte magic string "ODCOLVAR", a 32 bit format version
+ * and a 32 bit record size, followed by records of a 64 bit step number and
+ * 32 bit floating point displacement and energy, all in native byte order.
+ */
+
+class OPENMM_EXPORT_EXAMPLE OneDimComColvarWriter {
+public:
+    struct Record {
+        long long step;
+        float displacement;
+        float energy;
+    };
+    static const char* Magic() {
+        return "ODCOLVAR";
+    }
+    static const int Version = 1;
+    OneDimComColvarWriter(const std::string& filename);
+    ~OneDimComColvarWriter();
+    void write(long long step, float displacement, float energy);
+private:
+    void handOff(bool wait);
+    void run();
+    void releaseFile();
+    static const int BlockSize = 4096;
+    std::string filename;
+    std::ofstream file;
+    std::vector<Record> front, back;
+    std::mutex lock;
+    std::condition_variable condition;
+    bool backPending, finished;
+    std::thread thread;
+};
+
+} // namespace OneDimComPlugin
+
+#endif /*OPENMM_ONEDIMCOMCOLVARWRITER_H_*/
@@ -33,8 +33,13 @@
  * -------------------------------------------------------------------------- */
 
 #include "OneDimComForce.h"
+#include "OneDimComColvarWriter.h"
 #include "openmm/internal/ForceImpl.h"
 #include "openmm/Kernel.h"
+#include "openmm/Vec3.h"
+#include <atomic>
+#include <deque>
+#include <random>
 #include <utility>
 #include <set>
 #include <string>
@@ -42,6 +47,7 @@
 namespace OneDimComPlugin {
 
 class System;
+class CalcOneDimComForceKernel;
 
 /**
  * This is the internal implementation of OneDimComForce.
@@ -55,18 +61,95 @@ public:
     const OneDimComForce& getOwner() const {
         return owner;
     }
-    void updateContextState(OpenMM::ContextImpl& context) {
-        // This force field doesn't update the state directly.
-    }
+    void updateContextState(OpenMM::ContextImpl& context);
     double calcForcesAndEnergy(OpenMM::ContextImpl& context, bool includeForces, bool includeEnergy, int groups);
-    std::map<std::string, double> getDefaultParameters() {
-        return std::map<std::string, double>(); // This force field doesn't define any parameters.
-    }
+    std::map<std::string, double> getDefaultParameters();
     std::vector<std::string> getKernelNames();
     void updateParametersInContext(OpenMM::ContextImpl& context);
+    double getDisplacement(OpenMM::ContextImpl& context);
+    double getConstraintForce(OpenMM::ContextImpl& context);
+    std::string getExecutionStrategy(OpenMM::ContextImpl& context);
+    int getActiveParameterSet() const {
+        return activeParameterSet;
+    }
+    void setActiveParameterSet(OpenMM::ContextImpl& context, int index);
+    double getVariance(OpenMM::ContextImpl& context);
+    double getAccumulatedWork(OpenMM::ContextImpl& context);
+    void resetAccumulatedWork(OpenMM::ContextImpl& context);
+    bool getThresholdEvent(OpenMM::ContextImpl& context, int& threshold, long long& step, int& direction);
+    void resetThresholdEvent(OpenMM::ContextImpl& context);
+    void publishParameters(double k, double r0, const std::vector<float>& weights1, const std::vector<float>& weights2);
 private:
+    // a displacement the kernel is copying out, which either belongs in the
+    // colvar file, drives a dynamical r0, or drove one before a checkpoint was
+    // loaded and is only collected to keep the kernel's records in step
+    struct PendingRecord {
+        enum Kind {Colvar, Extended, Discarded};
+        long long step;
+        double k, r0;
+        Kind kind;
+    };
+    struct PublishedParameters {
+        double k, r0;
+        // empty when the weights are left as they are
+        std::vector<float> weights1, weights2;
+    };
+    CalcOneDimComForceKernel& ensureKernel(OpenMM::ContextImpl& context);
+    bool matchesLastEvaluation(OpenMM::ContextImpl& context);
+    void recordEvaluation(OpenMM::ContextImpl& context);
+    void writeColvar(OpenMM::ContextImpl& context, bool reduce);
+    void queueRecord(OpenMM::ContextImpl& context, const PendingRecord& record, bool reduce);
+    bool collectRecord(OpenMM::ContextImpl& context, bool wait);
+    void recordParameterSets();
+    void applySchedule(OpenMM::ContextImpl& context);
+    void applyPublishedParameters(OpenMM::ContextImpl& context);
+    void applyExtendedR0(OpenMM::ContextImpl& context);
+    void integrateExtendedR0(OpenMM::ContextImpl& context);
+    double executeStride(OpenMM::ContextImpl& context, bool includeForces, bool includeEnergy);
     const OneDimComForce& owner;
     OpenMM::Kernel kernel;
+    bool hasKernel;
+    // the force constant and r0 of the active set, and of every set
+    // most recently passed to the kernel
+    double forceConst, r0;
+    std::vector<double> setForceConsts, setR0s;
+    OneDimComColvarWriter* colvarWriter;
+    double lastColvarTime;
+    // the records whose displacements the kernel is still copying, oldest
+    // first, and the context they are collected from when this is deleted
+    std::deque<PendingRecord> pendingRecords;
+    OpenMM::ContextImpl* colvarContext;
+    // key of the evaluation whose displacement is held by the kernel, which
+    // compares the positions itself when the key matches
+    bool hasLastEvaluation;
+    double lastTime;
+    OpenMM::Vec3 lastBoxVectors[3];
+    int lastParameterVersion;
+    int parameterVersion;
+    // the step of the most recent evaluation when using a stride
+    long long lastStrideStep;
+    int activeParameterSet;
+    // published values override the active set without replacing it, and
+    // are dropped when the set is switched or the parameters are updated
+    bool hasPublishedParameters;
+    double publishedForceConst, publishedR0;
+    // a triple buffer for parameters published from another thread.  The
+    // publisher fills publishSlot and swaps it into sharedSlot, and the
+    // evaluation swaps its own readSlot out of sharedSlot when that holds
+    // something new, so neither side ever waits for the other
+    PublishedParameters publishedParameters[3];
+    int publishSlot, readSlot;
+    std::atomic<int> sharedSlot;
+    static const int FreshSlot = 4;
+    // the thermostat of a dynamical r0, whose generator is reseeded from
+    // the seed and step every step, the step it was last integrated for, and
+    // the displacement of the most recent collected evaluation that drives it
+    unsigned int extendedSeed;
+    long long lastExtendedStep;
+    std::mt19937 extendedRandom;
+    std::normal_distribution<double> extendedGaussian;
+    bool hasExtendedDisplacement;
+    double extendedDisplacement;
 };
 
 }
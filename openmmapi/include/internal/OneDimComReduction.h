@@ -0,0 +1,134 @@
+#ifndef OPENMM_ONEDIMCOMREDUCTION_H_
+#define OPENMM_ONEDIMCOMREDUCTION_H_
+
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "OneDimComForce.h"
+#include "OneDimComCombinationForce.h"
+#include "windowsExportExample.h"
+#include <vector>
+
+namespace OneDimComPlugin {
+
+/**
+ * This class holds the single concatenated list of atoms and signed weights that the
+ * groups of a force are reduced over.  Group 1 weights are positive, group 2 weights
+ * are negative, and the displacement is minus the weighted sum of the x coordinates,
+ * so that it is positive when group 2 is to the right of group 1.  For a
+ * OneDimComCombinationForce each group's weights are scaled by minus its coefficient.
+ * For a OneDimComForce with a variance restraint it also records the range of the
+ * list that holds the restrained group.
+ *
+ * Every platform and the batch evaluator use this same layout, so they all reduce
+ * the same sum in the same order.
+ */
+
+class OPENMM_EXPORT_EXAMPLE OneDimComReduction {
+public:
+    OneDimComReduction(const OneDimComForce& force);
+    /**
+     * Lay out the groups of a force with the weights of one of its parameter sets.
+     */
+    OneDimComReduction(const OneDimComForce& force, int parameterSet);
+    OneDimComReduction(const OneDimComCombinationForce& force);
+    int getNumAtoms() const {
+        return indices.size();
+    }
+    const std::vector<int>& getIndices() const {
+        return indices;
+    }
+    const std::vector<float>& getWeights() const {
+        return weights;
+    }
+    /**
+     * Get the first entry in the list that belongs to the group with a variance
+     * restraint.
+     */
+    int getVarianceStart() const {
+        return varianceStart;
+    }
+    /**
+     * Get the end of the range of entries that belongs to the group with a variance
+     * restraint.  This equals getVarianceStart() if there is no restraint.
+     */
+    int getVarianceEnd() const {
+        return varianceEnd;
+    }
+    /**
+     * Compute the displacement on the host.
+     *
+     * @param x        the x coordinate of atom 0
+     * @param stride   the distance between the x coordinates of consecutive atoms
+     */
+    template <class T>
+    double computeDisplacement(const T* x, int stride) const {
+        double sum = 0.0;
+        for (int i=0; i<indices.size(); ++i)
+            sum -= x[indices[i]*(long long) stride] * weights[i];
+        return sum;
+    }
+    /**
+     * Compute the displacement and the variance of the restrained group on the host,
+     * in the same single pass as the platform kernels.  The moments are taken relative
+     * to the first atom of the group to keep their difference accurate.
+     *
+     * @param x              the x coordinate of atom 0
+     * @param stride         the distance between the x coordinates of consecutive atoms
+     * @param displacement   on exit, the displacement
+     * @param variance       on exit, the variance, or 0 if there is no variance restraint
+     */
+    template <class T>
+    void computeMoments(const T* x, int stride, double& displacement, double& variance) const {
+        double origin = (varianceEnd > varianceStart ? x[indices[varianceStart]*(long long) stride] : 0.0);
+        double sum = 0.0, first = 0.0, second = 0.0;
+        for (int i=0; i<indices.size(); ++i) {
+            double xi = x[indices[i]*(long long) stride];
+            sum -= xi * weights[i];
+            if (i >= varianceStart && i < varianceEnd) {
+                double w = (weights[i] < 0 ? -weights[i] : weights[i]);
+                first += w*(xi-origin);
+                second += w*(xi-origin)*(xi-origin);
+            }
+        }
+        displacement = sum;
+        variance = second-first*first;
+    }
+private:
+    void initialize(const OneDimComForce& force, const std::vector<float>& weights1, const std::vector<float>& weights2);
+    std::vector<int> indices;
+    std::vector<float> weights;
+    int varianceStart, varianceEnd;
+};
+
+} // namespace OneDimComPlugin
+
+#endif /*OPENMM_ONEDIMCOMREDUCTION_H_*/
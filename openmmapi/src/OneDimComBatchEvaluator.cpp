@@ -0,0 +1,169 @@
+#include "OneDimComBatchEvaluator.h"
+#include "internal/OneDimComReduction.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/internal/ThreadPool.h"
+#include <algorithm>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+class OneDimComBatchEvaluator::EvaluateTask : public ThreadPool::Task {
+public:
+    EvaluateTask(const OneDimComBatchEvaluator& owner, const float* coordinates, int numAtoms, long long numFrames,
+            double* displacements, double* energies) : owner(owner), coordinates(coordinates), numAtoms(numAtoms),
+            numFrames(numFrames), displacements(displacements), energies(energies) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        // every frame costs the same, so each thread takes one contiguous block
+        long long start = (numFrames*threadIndex)/threads.getNumThreads();
+        long long end = (numFrames*(threadIndex+1))/threads.getNumThreads();
+        for (long long frame=start; frame<end; ++frame) {
+            double displacement, variance;
+            owner.reduction.computeMoments(coordinates+frame*numAtoms*3, 3, displacement, variance);
+            displacements[frame] = displacement;
+            if (energies != NULL)
+                energies[frame] = owner.computeEnergy(displacement, variance);
+        }
+    }
+private:
+    const OneDimComBatchEvaluator& owner;
+    const float* coordinates;
+    int numAtoms;
+    long long numFrames;
+    double* displacements;
+    double* energies;
+};
+
+class OneDimComBatchEvaluator::MappedFile {
+public:
+    MappedFile(const string& filename) : data(NULL), size(0) {
+#ifdef WIN32
+        file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            throw OpenMMException("Unable to open coordinate file "+filename);
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        size = fileSize.QuadPart;
+        mapping = NULL;
+        if (size > 0) {
+            mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping != NULL)
+                data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if (data == NULL) {
+                close();
+                throw OpenMMException("Unable to map coordinate file "+filename);
+            }
+        }
+#else
+        file = open(filename.c_str(), O_RDONLY);
+        if (file == -1)
+            throw OpenMMException("Unable to open coordinate file "+filename);
+        struct stat info;
+        fstat(file, &info);
+        size = info.st_size;
+        if (size > 0) {
+            data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+            if (data == MAP_FAILED) {
+                data = NULL;
+                close();
+                throw OpenMMException("Unable to map coordinate file "+filename);
+            }
+            madvise(data, size, MADV_SEQUENTIAL);
+        }
+#endif
+    }
+    ~MappedFile() {
+        close();
+    }
+    const float* getData() const {
+        return reinterpret_cast<const float*>(data);
+    }
+    long long getSize() const {
+        return size;
+    }
+private:
+    void close() {
+#ifdef WIN32
+        if (data != NULL)
+            UnmapViewOfFile(data);
+        if (mapping != NULL)
+            CloseHandle(mapping);
+        CloseHandle(file);
+#else
+        if (data != NULL)
+            munmap(data, size);
+        ::close(file);
+#endif
+    }
+#ifdef WIN32
+    HANDLE file, mapping;
+#else
+    int file;
+#endif
+    void* data;
+    long long size;
+};
+
+OneDimComBatchEvaluator::OneDimComBatchEvaluator(const OneDimComForce& force, int numThreads) : reduction(force),
+        k(force.getForceConst()), r0(force.getR0()), varianceForceConst(force.getVarianceForceConst()), variance0(force.getVariance0()),
+        useConstraint(force.getUseConstraint()), useAsCollectiveVariable(force.getUseAsCollectiveVariable()) {
+    threads = new ThreadPool(numThreads);
+}
+
+OneDimComBatchEvaluator::~OneDimComBatchEvaluator() {
+    delete threads;
+}
+
+int OneDimComBatchEvaluator::getNumThreads() const {
+    return threads->getNumThreads();
+}
+
+double OneDimComBatchEvaluator::computeEnergy(double displacement, double variance) const {
+    // the same energy a Context reports for the force in each of its modes
+    if (useAsCollectiveVariable)
+        return displacement;
+    if (useConstraint)
+        return 0.0;
+    double energy = 0.5*k*(displacement-r0)*(displacement-r0);
+    if (reduction.getVarianceEnd() > reduction.getVarianceStart())
+        energy += 0.5*varianceForceConst*(variance-variance0)*(variance-variance0);
+    return energy;
+}
+
+void OneDimComBatchEvaluator::evaluate(const float* coordinates, int numAtoms, long long numFrames, double* displacements, double* energies) {
+    if (numAtoms <= 0)
+        throw OpenMMException("OneDimComBatchEvaluator: The number of atoms must be positive");
+    const vector<int>& indices = reduction.getIndices();
+    for (int i=0; i<indices.size(); ++i) {
+        if (indices[i] < 0 || indices[i] >= numAtoms)
+            throw OpenMMException("OneDimComBatchEvaluator: The frames do not contain every atom in the groups");
+    }
+    if (numFrames == 0)
+        return;
+    EvaluateTask task(*this, coordinates, numAtoms, numFrames, displacements, energies);
+    threads->execute(task);
+    threads->waitForThreads();
+}
+
+void OneDimComBatchEvaluator::evaluateFile(const string& filename, int numAtoms, vector<double>& displacements, vector<double>& energies) {
+    if (numAtoms <= 0)
+        throw OpenMMException("OneDimComBatchEvaluator: The number of atoms must be positive");
+    MappedFile file(filename);
+    long long frameSize = numAtoms*3*(long long) sizeof(float);
+    if (file.getSize()%frameSize != 0)
+        throw OpenMMException("The size of "+filename+" is not a whole number of frames");
+    long long numFrames = file.getSize()/frameSize;
+    displacements.resize(numFrames);
+    energies.resize(numFrames);
+    if (numFrames > 0)
+        evaluate(file.getData(), numAtoms, numFrames, &displacements[0], &energies[0]);
+}
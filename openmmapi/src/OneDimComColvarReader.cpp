@@ -0,0 +1,49 @@
+#include "OneDimComColvarReader.h"
+#include "internal/OneDimComColvarWriter.h"
+#include "openmm/OpenMMException.h"
+#include <cstring>
+#include <fstream>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+OneDimComColvarReader::OneDimComColvarReader(const string& filename) {
+    ifstream file(filename.c_str(), ios::in | ios::binary);
+    if (!file)
+        throw OpenMMException("Unable to open colvar file "+filename);
+
+    char magic[8];
+    int version, recordSize;
+    file.read(magic, 8);
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    file.read(reinterpret_cast<char*>(&recordSize), sizeof(recordSize));
+    if (!file || strncmp(magic, OneDimComColvarWriter::Magic(), 8) != 0)
+        throw OpenMMException(filename+" is not a colvar file");
+    if (version != OneDimComColvarWriter::Version || recordSize != sizeof(OneDimComColvarWriter::Record))
+        throw OpenMMException("Unsupported colvar file version in "+filename);
+
+    // a partially written record at the end of the file is ignored
+    OneDimComColvarWriter::Record record;
+    while (file.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+        steps.push_back(record.step);
+        displacements.push_back(record.displacement);
+        energies.push_back(record.energy);
+    }
+}
+
+int OneDimComColvarReader::getNumRecords() const {
+    return steps.size();
+}
+
+const vector<long long>& OneDimComColvarReader::getSteps() const {
+    return steps;
+}
+
+const vector<float>& OneDimComColvarReader::getDisplacements() const {
+    return displacements;
+}
+
+const vector<float>& OneDimComColvarReader::getEnergies() const {
+    return energies;
+}
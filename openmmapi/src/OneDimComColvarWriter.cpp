@@ -0,0 +1,134 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "internal/OneDimComColvarWriter.h"
+#include "openmm/OpenMMException.h"
+#include <set>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+// the files every writer in the process has open, so that two Contexts created
+// from the same System can't truncate and interleave the same file
+static mutex openFilesLock;
+static set<string> openFiles;
+
+OneDimComColvarWriter::OneDimComColvarWriter(const string& filename) : filename(filename), backPending(false), finished(false) {
+    {
+        lock_guard<mutex> guard(openFilesLock);
+        if (!openFiles.insert(filename).second)
+            throw OpenMMException("The colvar file "+filename+" is already being written by another Context");
+    }
+    file.open(filename.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!file) {
+        releaseFile();
+        throw OpenMMException("Unable to open colvar file "+filename);
+    }
+    int version = Version;
+    int recordSize = sizeof(Record);
+    file.write(Magic(), 8);
+    file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    file.write(reinterpret_cast<const char*>(&recordSize), sizeof(recordSize));
+    front.reserve(BlockSize);
+    back.reserve(BlockSize);
+    thread = std::thread(&OneDimComColvarWriter::run, this);
+}
+
+OneDimComColvarWriter::~OneDimComColvarWriter() {
+    // hand over whatever is left and wait for it to reach the disk
+    handOff(true);
+    {
+        unique_lock<mutex> guard(lock);
+        finished = true;
+    }
+    condition.notify_one();
+    thread.join();
+    file.close();
+    releaseFile();
+}
+
+void OneDimComColvarWriter::releaseFile() {
+    lock_guard<mutex> guard(openFilesLock);
+    openFiles.erase(filename);
+}
+
+void OneDimComColvarWriter::write(long long step, float displacement, float energy) {
+    Record record;
+    record.step = step;
+    record.displacement = displacement;
+    record.energy = energy;
+    front.push_back(record);
+
+    // if the writer is still busy when a second block has filled up, wait
+    // for it rather than let the front buffer grow without bound
+    if (front.size() >= BlockSize)
+        handOff(front.size() >= 2*BlockSize);
+}
+
+void OneDimComColvarWriter::handOff(bool wait) {
+    {
+        unique_lock<mutex> guard(lock);
+        if (wait) {
+            while (backPending)
+                condition.wait(guard);
+        }
+        else if (backPending) {
+            // the writer is still busy, so keep filling the front buffer
+            return;
+        }
+        if (front.empty())
+            return;
+        front.swap(back);
+        backPending = true;
+    }
+    condition.notify_one();
+}
+
+void OneDimComColvarWriter::run() {
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        while (!backPending && !finished)
+            condition.wait(guard);
+        if (!backPending)
+            break;
+
+        // the back buffer belongs to this thread until backPending is cleared,
+        // so the lock can be released while writing it out
+        guard.unlock();
+        file.write(reinterpret_cast<const char*>(&back[0]), back.size()*sizeof(Record));
+        file.flush();
+        back.clear();
+        guard.lock();
+        backPending = false;
+        condition.notify_one();
+    }
+}
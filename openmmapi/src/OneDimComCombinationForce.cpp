@@ -0,0 +1,99 @@
+#include "OneDimComCombinationForce.h"
+#include "internal/OneDimComCombinationForceImpl.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <sstream>
+
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+OneDimComCombinationForce::OneDimComCombinationForce(float k, float r0) : k(k), r0(r0) {
+}
+
+int OneDimComCombinationForce::getNumGroups() const {
+    return groups.size();
+}
+
+int OneDimComCombinationForce::addGroup(const vector<int>& indices, const vector<float>& weights, float coefficient) {
+    groups.push_back(GroupInfo(indices, weights, coefficient));
+    validate();
+    return groups.size() - 1;
+}
+
+const vector<int>& OneDimComCombinationForce::getGroupIndices(int index) const {
+    ASSERT_VALID_INDEX(index, groups);
+    return groups[index].indices;
+}
+
+const vector<float>& OneDimComCombinationForce::getGroupWeights(int index) const {
+    ASSERT_VALID_INDEX(index, groups);
+    return groups[index].weights;
+}
+
+float OneDimComCombinationForce::getGroupCoefficient(int index) const {
+    ASSERT_VALID_INDEX(index, groups);
+    return groups[index].coefficient;
+}
+
+float OneDimComCombinationForce::getForceConst() const {
+    return k;
+}
+
+float OneDimComCombinationForce::getR0() const {
+    return r0;
+}
+
+void OneDimComCombinationForce::setGroupParameters(int index, const vector<int>& indices, const vector<float>& weights, float coefficient) {
+    ASSERT_VALID_INDEX(index, groups);
+    if(indices.size() != groups[index].indices.size()) {
+        throw OpenMMException("Size does not match when setting group indices.");
+    }
+    groups[index] = GroupInfo(indices, weights, coefficient);
+    validate();
+}
+
+void OneDimComCombinationForce::setForceConst(float new_k) {
+    k = new_k;
+}
+
+void OneDimComCombinationForce::setR0(float new_r0) {
+    r0 = new_r0;
+}
+
+void OneDimComCombinationForce::validate() {
+    for (int i=0; i<groups.size(); ++i) {
+        stringstream name;
+        name << "group " << i;
+        if(groups[i].indices.size() != groups[i].weights.size()) {
+            throw OpenMMException(name.str() + " indices and weights are not the same length");
+        }
+
+        float total = 0.0;
+        for(vector<float>::const_iterator it=groups[i].weights.begin(); it!=groups[i].weights.end(); ++it) {
+            if(*it < 0.0) {
+                throw OpenMMException(name.str() + " weights contain value < 0.");
+            }
+            if(*it > 1.0) {
+                throw OpenMMException(name.str() + " weights contain value > 1.");
+            }
+            total += *it;
+        }
+        if(fabs(total - 1.0) > 1.0e-4) {
+            throw OpenMMException(name.str() + " weights do not sum to 1.0");
+        }
+    }
+}
+
+ForceImpl* OneDimComCombinationForce::createImpl() const {
+    return new OneDimComCombinationForceImpl(*this);
+}
+
+void OneDimComCombinationForce::updateParametersInContext(Context& context) {
+    validate();
+    dynamic_cast<OneDimComCombinationForceImpl&>(getImplInContext(context)).updateParametersInContext(getContextImpl(context));
+}
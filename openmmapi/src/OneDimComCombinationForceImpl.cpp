@@ -0,0 +1,90 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "internal/OneDimComCombinationForceImpl.h"
+#include "OneDimComKernels.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/internal/ContextImpl.h"
+#include <cmath>
+#include <map>
+#include <set>
+#include <sstream>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+OneDimComCombinationForceImpl::OneDimComCombinationForceImpl(const OneDimComCombinationForce& owner) : owner(owner), hasKernel(false) {
+}
+
+OneDimComCombinationForceImpl::~OneDimComCombinationForceImpl() {
+}
+
+void OneDimComCombinationForceImpl::initialize(ContextImpl& context) {
+    const System& system = context.getSystem();
+    for (int i=0; i<owner.getNumGroups(); ++i) {
+        const vector<int>& indices = owner.getGroupIndices(i);
+        for (vector<int>::const_iterator it=indices.begin(); it!=indices.end(); ++it) {
+            if (*it < 0 || *it >= system.getNumParticles()) {
+                stringstream msg;
+                msg << "OneDimComCombinationForce: Illegal particle index in group " << i << ": " << *it;
+                throw OpenMMException(msg.str());
+            }
+        }
+    }
+}
+
+CalcOneDimComCombinationForceKernel& OneDimComCombinationForceImpl::ensureKernel(ContextImpl& context) {
+    // as for OneDimComForce, the kernel is only created on first use
+    if (!hasKernel) {
+        kernel = context.getPlatform().createKernel(CalcOneDimComCombinationForceKernel::Name(), context);
+        kernel.getAs<CalcOneDimComCombinationForceKernel>().initialize(context.getSystem(), owner);
+        hasKernel = true;
+    }
+    return kernel.getAs<CalcOneDimComCombinationForceKernel>();
+}
+
+double OneDimComCombinationForceImpl::calcForcesAndEnergy(ContextImpl& context, bool includeForces, bool includeEnergy, int groups) {
+    if ((groups&(1<<owner.getForceGroup())) != 0)
+        return ensureKernel(context).execute(context, includeForces, includeEnergy);
+    return 0.0;
+}
+
+std::vector<std::string> OneDimComCombinationForceImpl::getKernelNames() {
+    std::vector<std::string> names;
+    names.push_back(CalcOneDimComCombinationForceKernel::Name());
+    return names;
+}
+
+void OneDimComCombinationForceImpl::updateParametersInContext(ContextImpl& context) {
+    if (hasKernel)
+        kernel.getAs<CalcOneDimComCombinationForceKernel>().copyParametersToContext(context, owner);
+}
@@ -1,9 +1,15 @@
 #include "OneDimComForce.h"
+#include "OneDimComCombinationForce.h"
+#include "OneDimComPairwiseForce.h"
+#include "OneDimComRegionForce.h"
 #include "internal/OneDimComForceImpl.h"
 #include "openmm/OpenMMException.h"
+#include "openmm/System.h"
+#include "openmm/VerletIntegrator.h"
 #include "openmm/internal/AssertionUtilities.h"
 #include <vector>
 #include <algorithm>
+#include <map>
 #include <math.h>
 
 
@@ -15,7 +21,8 @@ OneDimComForce::OneDimComForce(const vector<int>& group1, const vector<int>& gro
         const vector<float>& weights1, const vector<float>& weights2,
         float k, float r0):
         group1(group1), group2(group2), weights1(weights1),
-        weights2(weights2), k(k), r0(r0) {
+        weights2(weights2), k(k), r0(r0), useEvaluationCache(false), useConstraint(false), useAsCollectiveVariable(false), evaluationStride(1), useImpulse(true), r0Rate(0.0), forceConstRate(0.0), varianceGroup(0), varianceForceConst(0.0), variance0(0.0),
+        extendedMass(0.0), extendedTemperature(0.0), extendedFriction(0.0), extendedRandomSeed(0), colvarInterval(0) {
     validate();
 }
 
@@ -84,6 +91,153 @@ void OneDimComForce::setR0(float new_r0) {
     r0 = new_r0;
 }
 
+bool OneDimComForce::getUseEvaluationCache() const {
+    return useEvaluationCache;
+}
+
+void OneDimComForce::setUseEvaluationCache(bool use) {
+    useEvaluationCache = use;
+}
+
+bool OneDimComForce::getUseConstraint() const {
+    return useConstraint;
+}
+
+void OneDimComForce::setUseConstraint(bool use) {
+    useConstraint = use;
+}
+
+bool OneDimComForce::getUseAsCollectiveVariable() const {
+    return useAsCollectiveVariable;
+}
+
+void OneDimComForce::setUseAsCollectiveVariable(bool use) {
+    useAsCollectiveVariable = use;
+}
+
+int OneDimComForce::getEvaluationStride() const {
+    return evaluationStride;
+}
+
+bool OneDimComForce::getUseImpulse() const {
+    return useImpulse;
+}
+
+void OneDimComForce::setEvaluationStride(int stride, bool impulse) {
+    if (stride < 1) {
+        throw OpenMMException("The evaluation stride must be at least 1.");
+    }
+    evaluationStride = stride;
+    useImpulse = impulse;
+}
+
+double OneDimComForce::getR0Rate() const {
+    return r0Rate;
+}
+
+double OneDimComForce::getForceConstRate() const {
+    return forceConstRate;
+}
+
+void OneDimComForce::setPullingSchedule(double r0Rate, double forceConstRate) {
+    this->r0Rate = r0Rate;
+    this->forceConstRate = forceConstRate;
+}
+
+int OneDimComForce::getVarianceGroup() const {
+    return varianceGroup;
+}
+
+double OneDimComForce::getVarianceForceConst() const {
+    return varianceForceConst;
+}
+
+double OneDimComForce::getVariance0() const {
+    return variance0;
+}
+
+void OneDimComForce::setVarianceRestraint(int group, double varianceK, double variance0) {
+    if (group < 0 || group > 2) {
+        throw OpenMMException("The variance group must be 0, 1 or 2");
+    }
+    varianceGroup = group;
+    varianceForceConst = varianceK;
+    this->variance0 = variance0;
+}
+
+bool OneDimComForce::getUseExtendedLagrangian() const {
+    return extendedMass > 0.0;
+}
+
+const string& OneDimComForce::getExtendedParameterName() const {
+    return extendedName;
+}
+
+double OneDimComForce::getExtendedMass() const {
+    return extendedMass;
+}
+
+double OneDimComForce::getExtendedTemperature() const {
+    return extendedTemperature;
+}
+
+double OneDimComForce::getExtendedFriction() const {
+    return extendedFriction;
+}
+
+int OneDimComForce::getExtendedRandomSeed() const {
+    return extendedRandomSeed;
+}
+
+void OneDimComForce::setExtendedLagrangian(const string& name, double mass, double temperature, double friction, int randomSeed) {
+    if (mass < 0.0 || temperature < 0.0 || friction < 0.0) {
+        throw OpenMMException("The mass, temperature and friction of r0 must not be negative");
+    }
+    if (mass > 0.0 && name.empty()) {
+        throw OpenMMException("A dynamical r0 needs a parameter name");
+    }
+    extendedName = name;
+    extendedMass = mass;
+    extendedTemperature = temperature;
+    extendedFriction = friction;
+    extendedRandomSeed = randomSeed;
+}
+
+int OneDimComForce::getNumThresholds() const {
+    return thresholds.size();
+}
+
+int OneDimComForce::addThreshold(double value) {
+    thresholds.push_back(value);
+    return thresholds.size()-1;
+}
+
+double OneDimComForce::getThreshold(int index) const {
+    ASSERT_VALID_INDEX(index, thresholds);
+    return thresholds[index];
+}
+
+void OneDimComForce::setThreshold(int index, double value) {
+    ASSERT_VALID_INDEX(index, thresholds);
+    thresholds[index] = value;
+}
+
+const string& OneDimComForce::getColvarFile() const {
+    return colvarFile;
+}
+
+int OneDimComForce::getColvarInterval() const {
+    return colvarInterval;
+}
+
+void OneDimComForce::setColvarFile(const string& filename, int interval) {
+    if (!filename.empty() && interval < 1) {
+        throw OpenMMException("The colvar interval must be at least 1.");
+    }
+    colvarFile = filename;
+    colvarInterval = (filename.empty() ? 0 : interval);
+}
+
 void OneDimComForce::validate() {
     if(group1.size() != weights1.size()) {
         throw OpenMMException("group1 and weights1 are not the same length");
@@ -93,8 +247,17 @@ void OneDimComForce::validate() {
         throw OpenMMException("group2 and weights2 are not the same length");
     }
 
+    validateWeights(weights1, weights2);
+    for (int i=0; i<parameterSets.size(); ++i) {
+        if (parameterSets[i].weights1.size() != group1.size() || parameterSets[i].weights2.size() != group2.size()) {
+            throw OpenMMException("The weights of a parameter set do not match the groups");
+        }
+    }
+}
+
+void OneDimComForce::validateWeights(const vector<float>& weights1, const vector<float>& weights2) const {
     float total = 0.0;
-    for(std::vector<float>::iterator it=weights1.begin(); it!=weights1.end(); ++it) {
+    for(std::vector<float>::const_iterator it=weights1.begin(); it!=weights1.end(); ++it) {
         if(*it < 0.0) {
             throw OpenMMException("weights1 contains value < 0.");
         }
@@ -108,7 +271,7 @@ void OneDimComForce::validate() {
     }
 
     total = 0.0;
-    for(std::vector<float>::iterator it=weights2.begin(); it!=weights2.end(); ++it) {
+    for(std::vector<float>::const_iterator it=weights2.begin(); it!=weights2.end(); ++it) {
         if(*it < 0.0) {
             throw OpenMMException("weights2 contains value < 0.");
         }
@@ -122,6 +285,88 @@ void OneDimComForce::validate() {
     }
 }
 
+void OneDimComForce::getCollectiveVariableGradient(vector<int>& particles, vector<double>& gradient) const {
+    // the displacement is the group 2 average minus the group 1 average
+    map<int, double> derivatives;
+    for (int i=0; i<group1.size(); ++i) {
+        derivatives[group1[i]] -= weights1[i];
+    }
+    for (int i=0; i<group2.size(); ++i) {
+        derivatives[group2[i]] += weights2[i];
+    }
+    particles.clear();
+    gradient.clear();
+    for (map<int, double>::const_iterator it=derivatives.begin(); it!=derivatives.end(); ++it) {
+        particles.push_back(it->first);
+        gradient.push_back(it->second);
+    }
+}
+
+int OneDimComForce::getNumParameterSets() const {
+    return parameterSets.size()+1;
+}
+
+int OneDimComForce::addParameterSet(float k, float r0, const vector<float>& weights1, const vector<float>& weights2) {
+    if (weights1.size() != group1.size() || weights2.size() != group2.size()) {
+        throw OpenMMException("The weights of a parameter set do not match the groups");
+    }
+    validateWeights(weights1, weights2);
+    parameterSets.push_back(ParameterSetInfo(k, r0, weights1, weights2));
+    return parameterSets.size();
+}
+
+void OneDimComForce::getParameterSet(int index, float& k, float& r0, vector<float>& weights1, vector<float>& weights2) const {
+    if (index < 0 || index > parameterSets.size()) {
+        throw OpenMMException("Index out of range");
+    }
+    if (index == 0) {
+        k = this->k;
+        r0 = this->r0;
+        weights1 = this->weights1;
+        weights2 = this->weights2;
+        return;
+    }
+    const ParameterSetInfo& set = parameterSets[index-1];
+    k = set.k;
+    r0 = set.r0;
+    weights1 = set.weights1;
+    weights2 = set.weights2;
+}
+
+void OneDimComForce::setParameterSet(int index, float k, float r0, const vector<float>& weights1, const vector<float>& weights2) {
+    if (index < 1 || index > parameterSets.size()) {
+        throw OpenMMException("Index out of range");
+    }
+    if (weights1.size() != group1.size() || weights2.size() != group2.size()) {
+        throw OpenMMException("The weights of a parameter set do not match the groups");
+    }
+    validateWeights(weights1, weights2);
+    parameterSets[index-1] = ParameterSetInfo(k, r0, weights1, weights2);
+}
+
+int OneDimComForce::getActiveParameterSet(Context& context) {
+    return dynamic_cast<OneDimComForceImpl&>(getImplInContext(context)).getActiveParameterSet();
+}
+
+void OneDimComForce::setActiveParameterSet(Context& context, int index) {
+    if (index < 0 || index > parameterSets.size()) {
+        throw OpenMMException("Index out of range");
+    }
+    dynamic_cast<OneDimComForceImpl&>(getImplInContext(context)).setActiveParameterSet(getContextImpl(context), index);
+}
+
+void OneDimComForce::publishParameters(Context& context, float k, float r0) {
+    dynamic_cast<OneDimComForceImpl&>(getImplInContext(context)).publishParameters(k, r0, vector<float>(), vector<float>());
+}
+
+void OneDimComForce::publishParameters(Context& context, float k, float r0, const vector<float>& weights1, const vector<float>& weights2) {
+    if (weights1.size() != group1.size() || weights2.size() != group2.size()) {
+        throw OpenMMException("The published weights do not match the groups");
+    }
+    validateWeights(weights1, weights2);
+    dynamic_cast<OneDimComForceImpl&>(getImplInContext(context)).publishParameters(k, r0, weights1, weights2);
+}
+
 ForceImpl* OneDimComForce::createImpl() const {
     return new OneDimComForceImpl(*this);
 }
@@ -130,3 +375,94 @@ void OneDimComForce::updateParametersInContext(Context& context) {
     validate();
     dynamic_cast<OneDimComForceImpl&>(getImplInContext(context)).updateParametersInContext(getContextImpl(context));
 }
+
+double OneDimComForce::getDisplacement(Context& context) {
+    return dynamic_cast<OneDimComForceImpl&>(getImplInContext(context)).getDisplacement(getContextImpl(context));
+}
+
+double OneDimComForce::getConstraintForce(Context& context) {
+    return dynamic_cast<OneDimComForceImpl&>(getImplInContext(context)).getConstraintForce(getContextImpl(context));
+}
+
+string OneDimComForce::getExecutionStrategy(Context& context) {
+    return dynamic_cast<OneDimComForceImpl&>(getImplInContext(context)).getExecutionStrategy(getContextImpl(context));
+}
+
+double OneDimComForce::getVariance(Context& context) {
+    return dynamic_cast<OneDimComForceImpl&>(getImplInContext(context)).getVariance(getContextImpl(context));
+}
+
+double OneDimComForce::getAccumulatedWork(Context& context) {
+    return dynamic_cast<OneDimComForceImpl&>(getImplInContext(context)).getAccumulatedWork(getContextImpl(context));
+}
+
+void OneDimComForce::resetAccumulatedWork(Context& context) {
+    dynamic_cast<OneDimComForceImpl&>(getImplInContext(context)).resetAccumulatedWork(getContextImpl(context));
+}
+
+bool OneDimComForce::getThresholdEvent(Context& context, int& threshold, long long& step, int& direction) {
+    return dynamic_cast<OneDimComForceImpl&>(getImplInContext(context)).getThresholdEvent(getContextImpl(context), threshold, step, direction);
+}
+
+void OneDimComForce::resetThresholdEvent(Context& context) {
+    dynamic_cast<OneDimComForceImpl&>(getImplInContext(context)).resetThresholdEvent(getContextImpl(context));
+}
+
+int OneDimComForce::stepUntilThreshold(Context& context, int steps, int checkInterval) {
+    if (checkInterval < 1) {
+        throw OpenMMException("The check interval must be at least 1");
+    }
+    OneDimComForceImpl& impl = dynamic_cast<OneDimComForceImpl&>(getImplInContext(context));
+    int threshold, direction;
+    long long step;
+    int taken = 0;
+    while (taken < steps && !impl.getThresholdEvent(getContextImpl(context), threshold, step, direction)) {
+        int block = min(checkInterval, steps-taken);
+        context.getIntegrator().step(block);
+        taken += block;
+    }
+    return taken;
+}
+
+vector<double> OneDimComForce::computeWindowEnergies(Context& context, const vector<double>& ks, const vector<double>& r0s) {
+    if (ks.size() != r0s.size()) {
+        throw OpenMMException("ks and r0s are not the same length");
+    }
+    double displacement = getDisplacement(context);
+    double varianceEnergy = 0.0;
+    if (varianceGroup != 0) {
+        double variance = getVariance(context);
+        varianceEnergy = 0.5 * varianceForceConst * (variance - variance0) * (variance - variance0);
+    }
+    vector<double> energies(ks.size());
+    for (int i=0; i<ks.size(); ++i) {
+        energies[i] = 0.5 * ks[i] * (displacement - r0s[i]) * (displacement - r0s[i]) + varianceEnergy;
+    }
+    return energies;
+}
+
+void OneDimComForce::prewarmKernels(Platform& platform, const map<string, string>& properties) {
+    // the kernels are only created when a force is first evaluated, so
+    // the Context has to compute something before they are all cached
+    OpenMM::System system;
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    vector<int> group1(1, 0), group2(1, 1);
+    vector<float> weights(1, 1.0);
+    system.addForce(new OneDimComForce(group1, group2, weights, weights, 0.0, 0.0));
+    OneDimComCombinationForce* combination = new OneDimComCombinationForce(0.0, 0.0);
+    combination->addGroup(group1, weights, 1.0);
+    system.addForce(combination);
+    system.addForce(new OneDimComRegionForce(group1, weights, group2, 0.0, 1.0, 0.0, 0.0));
+    OneDimComPairwiseForce* pairwise = new OneDimComPairwiseForce();
+    pairwise->addGroup(group1, weights);
+    pairwise->addGroup(group2, weights);
+    pairwise->addPair(0, 1, 0.0, 0.0);
+    system.addForce(pairwise);
+    VerletIntegrator integrator(0.001);
+    Context context(system, integrator, platform, properties);
+    vector<Vec3> positions(2, Vec3());
+    positions[1] = Vec3(1, 0, 0);
+    context.setPositions(positions);
+    context.getState(State::Energy | State::Forces);
+}
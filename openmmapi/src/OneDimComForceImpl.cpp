@@ -34,6 +34,7 @@
 #endif
 #include "internal/OneDimComForceImpl.h"
 #include "OneDimComKernels.h"
+#include "openmm/Integrator.h"
 #include "openmm/OpenMMException.h"
 #include "openmm/internal/ContextImpl.h"
 #include <cmath>
@@ -45,21 +46,395 @@ using namespace OneDimComPlugin;
 using namespace OpenMM;
 using namespace std;
 
-OneDimComForceImpl::OneDimComForceImpl(const OneDimComForce& owner) : owner(owner) {
+OneDimComForceImpl::OneDimComForceImpl(const OneDimComForce& owner) : owner(owner), hasKernel(false), forceConst(0.0), r0(0.0),
+        colvarWriter(NULL), lastColvarTime(-1.0), colvarContext(NULL), hasLastEvaluation(false), lastTime(0.0), lastParameterVersion(0),
+        parameterVersion(0), lastStrideStep(-1), activeParameterSet(0), hasPublishedParameters(false), publishedForceConst(0.0), publishedR0(0.0), publishSlot(0), readSlot(1), sharedSlot(2),
+        extendedSeed(0), lastExtendedStep(-2), hasExtendedDisplacement(false), extendedDisplacement(0.0) {
 }
 
 OneDimComForceImpl::~OneDimComForceImpl() {
+    if (colvarWriter != NULL) {
+        // the records still being copied belong in the file too
+        while (collectRecord(*colvarContext, true))
+            ;
+        delete colvarWriter;
+    }
 }
 
 void OneDimComForceImpl::initialize(ContextImpl& context) {
-    kernel = context.getPlatform().createKernel(CalcOneDimComForceKernel::Name(), context);
-    kernel.getAs<CalcOneDimComForceKernel>().initialize(context.getSystem(), owner);
+    if (owner.getUseConstraint() && owner.getUseAsCollectiveVariable())
+        throw OpenMMException("OneDimComForce cannot be both a constraint and a collective variable");
+    if (owner.getEvaluationStride() > 1 && (owner.getUseConstraint() || owner.getUseAsCollectiveVariable()))
+        throw OpenMMException("OneDimComForce can only use an evaluation stride as a restraint");
+    if (owner.getVarianceGroup() != 0 && (owner.getUseConstraint() || owner.getUseAsCollectiveVariable() || owner.getEvaluationStride() > 1))
+        throw OpenMMException("OneDimComForce can only restrain a variance as a restraint without an evaluation stride");
+    if (owner.getUseExtendedLagrangian()) {
+        if (owner.getUseConstraint() || owner.getUseAsCollectiveVariable())
+            throw OpenMMException("OneDimComForce can only use a dynamical r0 as a restraint");
+        if (owner.getR0Rate() != 0.0 || owner.getForceConstRate() != 0.0)
+            throw OpenMMException("OneDimComForce cannot use a dynamical r0 with a pulling schedule");
+        int seed = owner.getExtendedRandomSeed();
+        extendedSeed = (seed == 0 ? random_device()() : (unsigned int) seed);
+    }
+    recordParameterSets();
+    if (!owner.getColvarFile().empty()) {
+        colvarWriter = new OneDimComColvarWriter(owner.getColvarFile());
+        colvarContext = &context;
+    }
+}
+
+CalcOneDimComForceKernel& OneDimComForceImpl::ensureKernel(ContextImpl& context) {
+    // the kernel, with its uploads and compilation, is only created once
+    // the force is actually evaluated, so contexts that leave its force
+    // group out never pay for it
+    if (!hasKernel) {
+        kernel = context.getPlatform().createKernel(CalcOneDimComForceKernel::Name(), context);
+        kernel.getAs<CalcOneDimComForceKernel>().initialize(context.getSystem(), owner);
+        hasKernel = true;
+    }
+    return kernel.getAs<CalcOneDimComForceKernel>();
+}
+
+map<string, double> OneDimComForceImpl::getDefaultParameters() {
+    map<string, double> parameters;
+    if (owner.getUseExtendedLagrangian()) {
+        parameters[owner.getExtendedParameterName()] = owner.getR0();
+        parameters[owner.getExtendedParameterName()+"Velocity"] = 0.0;
+    }
+    return parameters;
+}
+
+void OneDimComForceImpl::updateContextState(ContextImpl& context) {
+    if (owner.getUseExtendedLagrangian())
+        integrateExtendedR0(context);
+    if (!owner.getUseConstraint())
+        return;
+    applyPublishedParameters(context);
+    ensureKernel(context).applyConstraint(context, context.getIntegrator().getStepSize());
+
+    // the kernel leaves the displacement it just set behind, so it
+    // counts as an evaluation of the new positions
+    recordEvaluation(context);
 }
 
 double OneDimComForceImpl::calcForcesAndEnergy(ContextImpl& context, bool includeForces, bool includeEnergy, int groups) {
-    if ((groups&(1<<owner.getForceGroup())) != 0)
-        return kernel.getAs<CalcOneDimComForceKernel>().execute(context, includeForces, includeEnergy);
-    return 0.0;
+    if ((groups&(1<<owner.getForceGroup())) == 0)
+        return 0.0;
+    applyPublishedParameters(context);
+    if (owner.getUseConstraint()) {
+        // the constraint replaces the restraint, so there is nothing to
+        // apply, but the colvar file still needs a current displacement
+        if (colvarWriter != NULL)
+            writeColvar(context, true);
+        return 0.0;
+    }
+    double energy;
+    if (owner.getUseExtendedLagrangian())
+        applyExtendedR0(context);
+    else if (!owner.getUseAsCollectiveVariable())
+        applySchedule(context);
+    if (owner.getUseAsCollectiveVariable()) {
+        bool reduce = (!owner.getUseEvaluationCache() || !matchesLastEvaluation(context));
+        if (reduce)
+            recordEvaluation(context);
+        else
+            ensureKernel(context).refreshDisplacement(context);
+        energy = ensureKernel(context).executeCollectiveVariable(context, reduce, includeForces, includeEnergy);
+    }
+    else if (owner.getEvaluationStride() > 1)
+        energy = executeStride(context, includeForces, includeEnergy);
+    else if (owner.getUseEvaluationCache() && matchesLastEvaluation(context)) {
+        ensureKernel(context).refreshDisplacement(context);
+        energy = ensureKernel(context).executeCached(context, includeForces, includeEnergy);
+    }
+    else {
+        recordEvaluation(context);
+        energy = ensureKernel(context).execute(context, includeForces, includeEnergy);
+    }
+    if (owner.getNumThresholds() > 0) {
+        long long step = (long long) floor(context.getTime()/context.getIntegrator().getStepSize()+0.5);
+        ensureKernel(context).checkThresholds(context, step);
+    }
+    if (owner.getUseExtendedLagrangian()) {
+        long long step = (long long) floor(context.getTime()/context.getIntegrator().getStepSize()+0.5);
+        PendingRecord record = {step, forceConst, r0, PendingRecord::Extended};
+        queueRecord(context, record, false);
+    }
+    if (colvarWriter != NULL)
+        writeColvar(context, false);
+    return energy;
+}
+
+double OneDimComForceImpl::executeStride(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    int stride = owner.getEvaluationStride();
+    long long step = (long long) floor(context.getTime()/context.getIntegrator().getStepSize()+0.5);
+
+    // evaluate on every stride'th step, and also whenever there is nothing
+    // sensible to hold, such as at the start or after the time was reset
+    bool evaluate = (step%stride == 0 || lastStrideStep < 0 || step < lastStrideStep);
+    if (evaluate) {
+        lastStrideStep = step;
+        recordEvaluation(context);
+    }
+    double forceScale;
+    if (!includeForces)
+        forceScale = 0.0;
+    else if (owner.getUseImpulse())
+        forceScale = (step%stride == 0 ? stride : 0.0);
+    else
+        forceScale = 1.0;
+    return ensureKernel(context).executeStride(context, evaluate, forceScale, includeEnergy);
+}
+
+void OneDimComForceImpl::writeColvar(ContextImpl& context, bool reduce) {
+    // only the first evaluation at each time is recorded, so that
+    // getState() calls between steps don't produce duplicates
+    double time = context.getTime();
+    if (time == lastColvarTime)
+        return;
+    lastColvarTime = time;
+    long long step = (long long) floor(time/context.getIntegrator().getStepSize()+0.5);
+    if (step%owner.getColvarInterval() != 0)
+        return;
+
+    // the kernel copies the displacement out behind the evaluation, and it
+    // is collected on a later step once the copy has finished, so the
+    // evaluation never waits for the device unless the kernel falls a whole
+    // ring of records behind
+    if (reduce && owner.getUseEvaluationCache() && matchesLastEvaluation(context)) {
+        ensureKernel(context).refreshDisplacement(context);
+        reduce = false;
+    }
+    if (reduce)
+        recordEvaluation(context);
+    PendingRecord record = {step, forceConst, r0, PendingRecord::Colvar};
+    queueRecord(context, record, reduce);
+    while (collectRecord(context, false))
+        ;
+}
+
+void OneDimComForceImpl::queueRecord(ContextImpl& context, const PendingRecord& record, bool reduce) {
+    if (pendingRecords.size() == CalcOneDimComForceKernel::MaxRecordedDisplacements)
+        collectRecord(context, true);
+    pendingRecords.push_back(record);
+    ensureKernel(context).recordDisplacement(context, reduce);
+}
+
+bool OneDimComForceImpl::collectRecord(ContextImpl& context, bool wait) {
+    double displacement, variance;
+    if (pendingRecords.empty() || !ensureKernel(context).getRecordedDisplacement(context, wait, displacement, variance))
+        return false;
+    const PendingRecord& record = pendingRecords.front();
+    if (record.kind != PendingRecord::Colvar) {
+        if (record.kind == PendingRecord::Extended) {
+            hasExtendedDisplacement = true;
+            extendedDisplacement = displacement;
+        }
+        pendingRecords.pop_front();
+        return true;
+    }
+    double energy;
+    if (owner.getUseConstraint())
+        energy = 0.0;
+    else if (owner.getUseAsCollectiveVariable())
+        energy = displacement;
+    else {
+        energy = 0.5*record.k*(displacement-record.r0)*(displacement-record.r0);
+        if (owner.getVarianceGroup() != 0) {
+            double varianceK = owner.getVarianceForceConst();
+            energy += 0.5*varianceK*(variance-owner.getVariance0())*(variance-owner.getVariance0());
+        }
+    }
+    colvarWriter->write(record.step, displacement, energy);
+    pendingRecords.pop_front();
+    return true;
+}
+
+double OneDimComForceImpl::getDisplacement(ContextImpl& context) {
+    if (owner.getUseEvaluationCache() && matchesLastEvaluation(context)) {
+        ensureKernel(context).refreshDisplacement(context);
+        return ensureKernel(context).getDisplacement(context);
+    }
+    recordEvaluation(context);
+    return ensureKernel(context).computeDisplacement(context);
+}
+
+double OneDimComForceImpl::getConstraintForce(ContextImpl& context) {
+    return ensureKernel(context).getConstraintForce(context);
+}
+
+string OneDimComForceImpl::getExecutionStrategy(ContextImpl& context) {
+    return ensureKernel(context).getExecutionStrategy(context);
+}
+
+void OneDimComForceImpl::setActiveParameterSet(ContextImpl& context, int index) {
+    if (index >= setForceConsts.size())
+        throw OpenMMException("setActiveParameterSet: the parameter set has not been copied to the Context");
+    ensureKernel(context).setActiveParameterSet(context, index);
+    activeParameterSet = index;
+    hasPublishedParameters = false;
+    parameterVersion++;
+    forceConst = setForceConsts[index];
+    r0 = setR0s[index];
+}
+
+void OneDimComForceImpl::applySchedule(ContextImpl& context) {
+    if (owner.getR0Rate() == 0.0 && owner.getForceConstRate() == 0.0)
+        return;
+    // a schedule runs from published values as well as from those of the set
+    double time = context.getTime();
+    double k = (hasPublishedParameters ? publishedForceConst : setForceConsts[activeParameterSet]) + owner.getForceConstRate()*time;
+    double r = (hasPublishedParameters ? publishedR0 : setR0s[activeParameterSet]) + owner.getR0Rate()*time;
+    if (k == forceConst && r == r0)
+        return;
+    ensureKernel(context).setScheduledParameters(context, k, r, true);
+    forceConst = k;
+    r0 = r;
+    parameterVersion++;
+}
+
+void OneDimComForceImpl::applyExtendedR0(ContextImpl& context) {
+    // the parameter is the authority, so values restored from a checkpoint
+    // or set by hand are picked up as well
+    double r = context.getParameter(owner.getExtendedParameterName());
+    if (r == r0)
+        return;
+    ensureKernel(context).setScheduledParameters(context, forceConst, r, false);
+    r0 = r;
+    parameterVersion++;
+}
+
+void OneDimComForceImpl::integrateExtendedR0(ContextImpl& context) {
+    // a step that doesn't follow the last one, as after loading a checkpoint,
+    // leaves nothing of the old trajectory to drive r0 with
+    long long step = (long long) floor(context.getTime()/context.getIntegrator().getStepSize()+0.5);
+    if (step != lastExtendedStep+1) {
+        hasExtendedDisplacement = false;
+        for (int i=0; i<pendingRecords.size(); ++i)
+            if (pendingRecords[i].kind == PendingRecord::Extended)
+                pendingRecords[i].kind = PendingRecord::Discarded;
+    }
+    lastExtendedStep = step;
+
+    // one Langevin step of r0 in the middle scheme, driven by the harmonic
+    // coupling to the displacement of the latest evaluation whose copy has
+    // finished.  That is normally the one of the previous step, but the host
+    // never waits for it, so when the device falls behind an older one is
+    // used instead.  Only the first step has to reduce the groups here.
+    while (collectRecord(context, false))
+        ;
+    double displacement = (hasExtendedDisplacement ? extendedDisplacement : getDisplacement(context));
+
+    // the noise depends only on the seed and the step, so a run continued
+    // from a checkpoint gets the same noise as one that never stopped
+    seed_seq sequence = {extendedSeed, (unsigned int) step, (unsigned int) (step>>32)};
+    extendedRandom.seed(sequence);
+    extendedGaussian.reset();
+
+    const double boltzmann = 0.00831446261815324; // kJ/mol/K
+    const string& name = owner.getExtendedParameterName();
+    double dt = context.getIntegrator().getStepSize();
+    double mass = owner.getExtendedMass();
+    double r = context.getParameter(name);
+    double v = context.getParameter(name+"Velocity");
+    v += dt*forceConst*(displacement-r)/mass;
+    r += 0.5*dt*v;
+    double scale = exp(-owner.getExtendedFriction()*dt);
+    double noise = sqrt(boltzmann*owner.getExtendedTemperature()*(1.0-scale*scale)/mass);
+    v = scale*v + noise*extendedGaussian(extendedRandom);
+    r += 0.5*dt*v;
+    context.setParameter(name, r);
+    context.setParameter(name+"Velocity", v);
+}
+
+double OneDimComForceImpl::getVariance(ContextImpl& context) {
+    if (!hasKernel)
+        return 0.0;
+    return ensureKernel(context).getVariance(context);
+}
+
+double OneDimComForceImpl::getAccumulatedWork(ContextImpl& context) {
+    if (!hasKernel)
+        return 0.0;
+    return ensureKernel(context).getWork(context);
+}
+
+void OneDimComForceImpl::resetAccumulatedWork(ContextImpl& context) {
+    if (!hasKernel)
+        return;
+    ensureKernel(context).resetWork(context);
+}
+
+void OneDimComForceImpl::publishParameters(double k, double r0, const vector<float>& weights1, const vector<float>& weights2) {
+    PublishedParameters& slot = publishedParameters[publishSlot];
+    slot.k = k;
+    slot.r0 = r0;
+    slot.weights1 = weights1;
+    slot.weights2 = weights2;
+    publishSlot = sharedSlot.exchange(publishSlot|FreshSlot) & ~FreshSlot;
+}
+
+void OneDimComForceImpl::applyPublishedParameters(ContextImpl& context) {
+    if ((sharedSlot.load() & FreshSlot) == 0)
+        return;
+    readSlot = sharedSlot.exchange(readSlot) & ~FreshSlot;
+    const PublishedParameters& published = publishedParameters[readSlot];
+    ensureKernel(context).setPublishedParameters(context, published.k, published.r0, published.weights1, published.weights2);
+    hasPublishedParameters = true;
+    publishedForceConst = published.k;
+    publishedR0 = published.r0;
+    forceConst = published.k;
+    r0 = published.r0;
+    parameterVersion++;
+}
+
+bool OneDimComForceImpl::getThresholdEvent(ContextImpl& context, int& threshold, long long& step, int& direction) {
+    if (!hasKernel)
+        return false;
+    return ensureKernel(context).getThresholdEvent(context, threshold, step, direction);
+}
+
+void OneDimComForceImpl::resetThresholdEvent(ContextImpl& context) {
+    if (!hasKernel)
+        return;
+    ensureKernel(context).resetThresholdEvent(context);
+}
+
+void OneDimComForceImpl::recordParameterSets() {
+    int numSets = owner.getNumParameterSets();
+    setForceConsts.resize(numSets);
+    setR0s.resize(numSets);
+    for (int i=0; i<numSets; ++i) {
+        float k, r;
+        vector<float> weights1, weights2;
+        owner.getParameterSet(i, k, r, weights1, weights2);
+        setForceConsts[i] = k;
+        setR0s[i] = r;
+    }
+    forceConst = setForceConsts[activeParameterSet];
+    r0 = setR0s[activeParameterSet];
+    hasPublishedParameters = false;
+}
+
+bool OneDimComForceImpl::matchesLastEvaluation(ContextImpl& context) {
+    if (!hasLastEvaluation || lastParameterVersion != parameterVersion || lastTime != context.getTime())
+        return false;
+    Vec3 box[3];
+    context.getPeriodicBoxVectors(box[0], box[1], box[2]);
+    for (int i=0; i<3; ++i) {
+        for (int j=0; j<3; ++j) {
+            if (box[i][j] != lastBoxVectors[i][j])
+                return false;
+        }
+    }
+    return true;
+}
+
+void OneDimComForceImpl::recordEvaluation(ContextImpl& context) {
+    hasLastEvaluation = true;
+    lastTime = context.getTime();
+    lastParameterVersion = parameterVersion;
+    context.getPeriodicBoxVectors(lastBoxVectors[0], lastBoxVectors[1], lastBoxVectors[2]);
 }
 
 std::vector<std::string> OneDimComForceImpl::getKernelNames() {
@@ -69,5 +444,8 @@ std::vector<std::string> OneDimComForceImpl::getKernelNames() {
 }
 
 void OneDimComForceImpl::updateParametersInContext(ContextImpl& context) {
-    kernel.getAs<CalcOneDimComForceKernel>().copyParametersToContext(context, owner);
+    parameterVersion++;
+    if (hasKernel)
+        kernel.getAs<CalcOneDimComForceKernel>().copyParametersToContext(context, owner);
+    recordParameterSets();
 }
@@ -0,0 +1,132 @@
+#include "OneDimComPairwiseForce.h"
+#include "internal/OneDimComPairwiseForceImpl.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <sstream>
+
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+/**
+ * Check a single group, so that a bad group can be rejected before it is stored.
+ */
+static void validateGroup(int index, const vector<int>& indices, const vector<float>& weights) {
+    stringstream name;
+    name << "group " << index;
+    if(indices.size() != weights.size()) {
+        throw OpenMMException(name.str() + " indices and weights are not the same length");
+    }
+
+    float total = 0.0;
+    for(vector<float>::const_iterator it=weights.begin(); it!=weights.end(); ++it) {
+        if(*it < 0.0) {
+            throw OpenMMException(name.str() + " weights contain value < 0.");
+        }
+        if(*it > 1.0) {
+            throw OpenMMException(name.str() + " weights contain value > 1.");
+        }
+        total += *it;
+    }
+    if(fabs(total - 1.0) > 1.0e-4) {
+        throw OpenMMException(name.str() + " weights do not sum to 1.0");
+    }
+}
+
+/**
+ * Check a single pair against the groups that exist.
+ */
+static void validatePair(int index, int group1, int group2, OneDimComPairwiseForce::PairType type, int numGroups) {
+    stringstream name;
+    name << "pair " << index;
+    if(group1 < 0 || group1 >= numGroups || group2 < 0 || group2 >= numGroups) {
+        throw OpenMMException(name.str() + " refers to a group that does not exist");
+    }
+    if(group1 == group2) {
+        throw OpenMMException(name.str() + " uses the same group twice");
+    }
+    if(type != OneDimComPairwiseForce::Harmonic && type != OneDimComPairwiseForce::LowerWall && type != OneDimComPairwiseForce::UpperWall) {
+        throw OpenMMException(name.str() + " has an unknown type");
+    }
+}
+
+OneDimComPairwiseForce::OneDimComPairwiseForce() {
+}
+
+int OneDimComPairwiseForce::getNumGroups() const {
+    return groups.size();
+}
+
+int OneDimComPairwiseForce::getNumPairs() const {
+    return pairs.size();
+}
+
+int OneDimComPairwiseForce::addGroup(const vector<int>& indices, const vector<float>& weights) {
+    validateGroup(groups.size(), indices, weights);
+    groups.push_back(GroupInfo(indices, weights));
+    return groups.size() - 1;
+}
+
+int OneDimComPairwiseForce::addPair(int group1, int group2, float k, float r0, PairType type) {
+    validatePair(pairs.size(), group1, group2, type, groups.size());
+    pairs.push_back(PairInfo(group1, group2, k, r0, type));
+    return pairs.size() - 1;
+}
+
+const vector<int>& OneDimComPairwiseForce::getGroupIndices(int index) const {
+    ASSERT_VALID_INDEX(index, groups);
+    return groups[index].indices;
+}
+
+const vector<float>& OneDimComPairwiseForce::getGroupWeights(int index) const {
+    ASSERT_VALID_INDEX(index, groups);
+    return groups[index].weights;
+}
+
+void OneDimComPairwiseForce::getPairParameters(int index, int& group1, int& group2, float& k, float& r0, PairType& type) const {
+    ASSERT_VALID_INDEX(index, pairs);
+    const PairInfo& pair = pairs[index];
+    group1 = pair.group1;
+    group2 = pair.group2;
+    k = pair.k;
+    r0 = pair.r0;
+    type = pair.type;
+}
+
+void OneDimComPairwiseForce::setGroupParameters(int index, const vector<int>& indices, const vector<float>& weights) {
+    ASSERT_VALID_INDEX(index, groups);
+    if(indices.size() != groups[index].indices.size()) {
+        throw OpenMMException("Size does not match when setting group indices.");
+    }
+    validateGroup(index, indices, weights);
+    groups[index] = GroupInfo(indices, weights);
+}
+
+void OneDimComPairwiseForce::setPairParameters(int index, int group1, int group2, float k, float r0, PairType type) {
+    ASSERT_VALID_INDEX(index, pairs);
+    validatePair(index, group1, group2, type, groups.size());
+    pairs[index] = PairInfo(group1, group2, k, r0, type);
+}
+
+void OneDimComPairwiseForce::validate() {
+    for (int i=0; i<groups.size(); ++i) {
+        validateGroup(i, groups[i].indices, groups[i].weights);
+    }
+    for (int i=0; i<pairs.size(); ++i) {
+        const PairInfo& pair = pairs[i];
+        validatePair(i, pair.group1, pair.group2, pair.type, groups.size());
+    }
+}
+
+ForceImpl* OneDimComPairwiseForce::createImpl() const {
+    return new OneDimComPairwiseForceImpl(*this);
+}
+
+void OneDimComPairwiseForce::updateParametersInContext(Context& context) {
+    validate();
+    dynamic_cast<OneDimComPairwiseForceImpl&>(getImplInContext(context)).updateParametersInContext(getContextImpl(context));
+}
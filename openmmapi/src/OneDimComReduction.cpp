@@ -0,0 +1,46 @@
+#include "internal/OneDimComReduction.h"
+
+using namespace OneDimComPlugin;
+using namespace std;
+
+OneDimComReduction::OneDimComReduction(const OneDimComForce& force) {
+    initialize(force, force.getGroup1Weights(), force.getGroup2Weights());
+}
+
+OneDimComReduction::OneDimComReduction(const OneDimComForce& force, int parameterSet) {
+    float k, r0;
+    vector<float> weights1, weights2;
+    force.getParameterSet(parameterSet, k, r0, weights1, weights2);
+    initialize(force, weights1, weights2);
+}
+
+void OneDimComReduction::initialize(const OneDimComForce& force, const vector<float>& weights1, const vector<float>& weights2) {
+    // concatenate the indices into a single vector
+    indices.reserve(force.getGroup1Indices().size() + force.getGroup2Indices().size());
+    indices.insert(indices.end(), force.getGroup1Indices().begin(), force.getGroup1Indices().end());
+    indices.insert(indices.end(), force.getGroup2Indices().begin(), force.getGroup2Indices().end());
+
+    // concatenate the weights, negating weights2
+    weights.reserve(indices.size());
+    weights.insert(weights.end(), weights1.begin(), weights1.end());
+    for (vector<float>::const_iterator it=weights2.begin(); it!=weights2.end(); ++it) {
+        weights.push_back(-*it);
+    }
+
+    int numGroup1 = force.getGroup1Indices().size();
+    varianceStart = (force.getVarianceGroup() == 2 ? numGroup1 : 0);
+    varianceEnd = (force.getVarianceGroup() == 0 ? 0 : force.getVarianceGroup() == 1 ? numGroup1 : indices.size());
+}
+
+OneDimComReduction::OneDimComReduction(const OneDimComCombinationForce& force) : varianceStart(0), varianceEnd(0) {
+    // fold each group's coefficient into its weights
+    for (int i=0; i<force.getNumGroups(); ++i) {
+        const vector<int>& groupIndices = force.getGroupIndices(i);
+        const vector<float>& groupWeights = force.getGroupWeights(i);
+        float coefficient = force.getGroupCoefficient(i);
+        indices.insert(indices.end(), groupIndices.begin(), groupIndices.end());
+        for (vector<float>::const_iterator it=groupWeights.begin(); it!=groupWeights.end(); ++it) {
+            weights.push_back(-coefficient * *it);
+        }
+    }
+}
@@ -0,0 +1,136 @@
+#include "OneDimComRegionForce.h"
+#include "internal/OneDimComRegionForceImpl.h"
+#include "openmm/OpenMMException.h"
+#include <vector>
+#include <math.h>
+
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+OneDimComRegionForce::OneDimComRegionForce(const vector<int>& group1, const vector<float>& weights1,
+        const vector<int>& candidates, float lower, float upper, float k, float r0) :
+        group1(group1), weights1(weights1), candidates(candidates), lower(lower), upper(upper),
+        switchWidth(0.1), skin(0.2), refreshInterval(10), k(k), r0(r0) {
+    validate();
+}
+
+const vector<int>& OneDimComRegionForce::getGroup1Indices() const {
+    return group1;
+}
+
+const vector<float>& OneDimComRegionForce::getGroup1Weights() const {
+    return weights1;
+}
+
+const vector<int>& OneDimComRegionForce::getCandidates() const {
+    return candidates;
+}
+
+float OneDimComRegionForce::getLower() const {
+    return lower;
+}
+
+float OneDimComRegionForce::getUpper() const {
+    return upper;
+}
+
+float OneDimComRegionForce::getSwitchWidth() const {
+    return switchWidth;
+}
+
+float OneDimComRegionForce::getSkin() const {
+    return skin;
+}
+
+int OneDimComRegionForce::getRefreshInterval() const {
+    return refreshInterval;
+}
+
+float OneDimComRegionForce::getForceConst() const {
+    return k;
+}
+
+float OneDimComRegionForce::getR0() const {
+    return r0;
+}
+
+void OneDimComRegionForce::setGroup1Weights(const vector<float>& weights) {
+    if(weights.size() != weights1.size()) {
+        throw OpenMMException("Size does not match when setting weights1.");
+    }
+    weights1 = weights;
+    validate();
+}
+
+void OneDimComRegionForce::setRegion(float new_lower, float new_upper) {
+    lower = new_lower;
+    upper = new_upper;
+    validate();
+}
+
+void OneDimComRegionForce::setSwitchWidth(float width) {
+    switchWidth = width;
+    validate();
+}
+
+void OneDimComRegionForce::setSkin(float new_skin) {
+    skin = new_skin;
+    validate();
+}
+
+void OneDimComRegionForce::setRefreshInterval(int interval) {
+    refreshInterval = interval;
+    validate();
+}
+
+void OneDimComRegionForce::setForceConst(float new_k) {
+    k = new_k;
+}
+
+void OneDimComRegionForce::setR0(float new_r0) {
+    r0 = new_r0;
+}
+
+void OneDimComRegionForce::validate() {
+    if(group1.size() != weights1.size()) {
+        throw OpenMMException("group1 and weights1 are not the same length");
+    }
+
+    float total = 0.0;
+    for(vector<float>::iterator it=weights1.begin(); it!=weights1.end(); ++it) {
+        if(*it < 0.0) {
+            throw OpenMMException("weights1 contains value < 0.");
+        }
+        if(*it > 1.0) {
+            throw OpenMMException("weights1 contains value > 1.");
+        }
+        total += *it;
+    }
+    if(fabs(total - 1.0) > 1.0e-4) {
+        throw OpenMMException("weights1 does not sum to 1.0");
+    }
+
+    if(upper < lower) {
+        throw OpenMMException("The upper face of the region is below the lower face.");
+    }
+    if(switchWidth <= 0.0) {
+        throw OpenMMException("The switching width must be greater than 0.");
+    }
+    if(skin < 0.0) {
+        throw OpenMMException("The skin must not be negative.");
+    }
+    if(refreshInterval < 1) {
+        throw OpenMMException("The refresh interval must be at least 1.");
+    }
+}
+
+ForceImpl* OneDimComRegionForce::createImpl() const {
+    return new OneDimComRegionForceImpl(*this);
+}
+
+void OneDimComRegionForce::updateParametersInContext(Context& context) {
+    validate();
+    dynamic_cast<OneDimComRegionForceImpl&>(getImplInContext(context)).updateParametersInContext(getContextImpl(context));
+}
@@ -0,0 +1,111 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "internal/OneDimComRegionForceImpl.h"
+#include "OneDimComKernels.h"
+#include "openmm/Integrator.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/internal/ContextImpl.h"
+#include <cmath>
+#include <map>
+#include <set>
+#include <sstream>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+OneDimComRegionForceImpl::OneDimComRegionForceImpl(const OneDimComRegionForce& owner) : owner(owner), hasKernel(false),
+        needsRefresh(true), lastRefreshStep(0) {
+}
+
+OneDimComRegionForceImpl::~OneDimComRegionForceImpl() {
+}
+
+void OneDimComRegionForceImpl::initialize(ContextImpl& context) {
+    const System& system = context.getSystem();
+    const vector<int>& group1 = owner.getGroup1Indices();
+    const vector<int>& candidates = owner.getCandidates();
+    for (vector<int>::const_iterator it=group1.begin(); it!=group1.end(); ++it) {
+        if (*it < 0 || *it >= system.getNumParticles()) {
+            stringstream msg;
+            msg << "OneDimComRegionForce: Illegal particle index in group1: " << *it;
+            throw OpenMMException(msg.str());
+        }
+    }
+    for (vector<int>::const_iterator it=candidates.begin(); it!=candidates.end(); ++it) {
+        if (*it < 0 || *it >= system.getNumParticles()) {
+            stringstream msg;
+            msg << "OneDimComRegionForce: Illegal candidate particle index: " << *it;
+            throw OpenMMException(msg.str());
+        }
+    }
+}
+
+CalcOneDimComRegionForceKernel& OneDimComRegionForceImpl::ensureKernel(ContextImpl& context) {
+    // as for OneDimComForce, the kernel is only created on first use
+    if (!hasKernel) {
+        kernel = context.getPlatform().createKernel(CalcOneDimComRegionForceKernel::Name(), context);
+        kernel.getAs<CalcOneDimComRegionForceKernel>().initialize(context.getSystem(), owner);
+        hasKernel = true;
+    }
+    return kernel.getAs<CalcOneDimComRegionForceKernel>();
+}
+
+double OneDimComRegionForceImpl::calcForcesAndEnergy(ContextImpl& context, bool includeForces, bool includeEnergy, int groups) {
+    if ((groups&(1<<owner.getForceGroup())) == 0)
+        return 0.0;
+
+    // rebuild the active list when it is due, or when time has gone
+    // backwards and the positions can't be trusted to be close to the
+    // ones it was built from.  In between the kernel still rebuilds it
+    // itself once a candidate has moved too far.
+    long long step = (long long) floor(context.getTime()/context.getIntegrator().getStepSize()+0.5);
+    bool force = (needsRefresh || step < lastRefreshStep || step-lastRefreshStep >= owner.getRefreshInterval());
+    ensureKernel(context).refreshRegion(context, force);
+    if (force) {
+        lastRefreshStep = step;
+        needsRefresh = false;
+    }
+    return ensureKernel(context).execute(context, includeForces, includeEnergy);
+}
+
+std::vector<std::string> OneDimComRegionForceImpl::getKernelNames() {
+    std::vector<std::string> names;
+    names.push_back(CalcOneDimComRegionForceKernel::Name());
+    return names;
+}
+
+void OneDimComRegionForceImpl::updateParametersInContext(ContextImpl& context) {
+    if (hasKernel)
+        kernel.getAs<CalcOneDimComRegionForceKernel>().copyParametersToContext(context, owner);
+    needsRefresh = true;
+}
@@ -0,0 +1,156 @@
+#include "OneDimComWindowScheduler.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/internal/ThreadPool.h"
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <string>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+class OneDimComWindowScheduler::StepTask : public ThreadPool::Task {
+public:
+    StepTask(vector<Context*>& contexts, int steps) : contexts(contexts), steps(steps), nextContext(0) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        // windows can take very different amounts of time, so rather than
+        // splitting them up front each thread takes the next one left
+        while (true) {
+            int index = nextContext++;
+            if (index >= (int) contexts.size())
+                break;
+            try {
+                contexts[index]->getIntegrator().step(steps);
+            }
+            catch (const exception& e) {
+                lock_guard<mutex> lock(errorMutex);
+                if (error.empty())
+                    error = e.what();
+            }
+        }
+    }
+    vector<Context*>& contexts;
+    int steps;
+    atomic<int> nextContext;
+    mutex errorMutex;
+    string error;
+};
+
+OneDimComWindowScheduler::OneDimComWindowScheduler(const System& system, OneDimComForce& force, Platform& platform, int numThreads) :
+        system(system), force(force), platform(platform), exchangeOffset(0) {
+    if (numThreads < 0)
+        throw OpenMMException("The number of threads must not be negative.");
+    threads = new ThreadPool(numThreads);
+}
+
+OneDimComWindowScheduler::~OneDimComWindowScheduler() {
+    for (int i=0; i<contexts.size(); ++i)
+        delete contexts[i];
+    for (int i=0; i<integrators.size(); ++i)
+        delete integrators[i];
+    delete threads;
+}
+
+int OneDimComWindowScheduler::addWindow(Integrator* integrator, double k, double r0) {
+    integrators.push_back(integrator);
+    ks.push_back(k);
+    r0s.push_back(r0);
+    windowContext.push_back(contexts.size());
+
+    // every window is a parameter set of the force, so an exchange only has
+    // to switch sets, and each Context holds all the sets that existed when
+    // it was created.  The sets stay in the caller's force, as documented in
+    // the header, since the Contexts are built from the caller's System.
+    windowSet.push_back(force.addParameterSet(k, r0, force.getGroup1Weights(), force.getGroup2Weights()));
+    contexts.push_back(new Context(system, *integrator, platform));
+    contextSets.push_back(force.getNumParameterSets());
+    setWindowParameters(ks.size()-1);
+    return ks.size()-1;
+}
+
+int OneDimComWindowScheduler::getNumWindows() const {
+    return ks.size();
+}
+
+int OneDimComWindowScheduler::getNumThreads() const {
+    return threads->getNumThreads();
+}
+
+double OneDimComWindowScheduler::getForceConst(int window) const {
+    ASSERT_VALID_INDEX(window, ks);
+    return ks[window];
+}
+
+double OneDimComWindowScheduler::getR0(int window) const {
+    ASSERT_VALID_INDEX(window, r0s);
+    return r0s[window];
+}
+
+Context& OneDimComWindowScheduler::getContext(int window) {
+    ASSERT_VALID_INDEX(window, windowContext);
+    return *contexts[windowContext[window]];
+}
+
+void OneDimComWindowScheduler::step(int steps) {
+    StepTask task(contexts, steps);
+    threads->execute(task);
+    threads->waitForThreads();
+    if (!task.error.empty())
+        throw OpenMMException(task.error);
+}
+
+vector<double> OneDimComWindowScheduler::getDisplacements() {
+    vector<double> displacements(getNumWindows());
+    for (int i=0; i<displacements.size(); ++i)
+        displacements[i] = force.getDisplacement(getContext(i));
+    return displacements;
+}
+
+int OneDimComWindowScheduler::attemptExchanges(double temperature) {
+    const double boltzmann = 0.00831446261815324; // kJ/mol/K
+    double beta = 1.0/(boltzmann*temperature);
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    int accepted = 0;
+    for (int i=exchangeOffset; i+1<getNumWindows(); i+=2) {
+        int j = i+1;
+
+        // the energy of each Context in both windows, including the variance
+        // restraint and anything else the force adds
+        vector<double> pairKs(2), pairR0s(2);
+        pairKs[0] = ks[i];
+        pairKs[1] = ks[j];
+        pairR0s[0] = r0s[i];
+        pairR0s[1] = r0s[j];
+        vector<double> energiesI = force.computeWindowEnergies(getContext(i), pairKs, pairR0s);
+        vector<double> energiesJ = force.computeWindowEnergies(getContext(j), pairKs, pairR0s);
+        double current = energiesI[0] + energiesJ[1];
+        double swapped = energiesI[1] + energiesJ[0];
+        double delta = beta*(swapped-current);
+        if (delta <= 0.0 || uniform(random) < exp(-delta)) {
+            swap(windowContext[i], windowContext[j]);
+            setWindowParameters(i);
+            setWindowParameters(j);
+            accepted++;
+        }
+    }
+    exchangeOffset = 1-exchangeOffset;
+    return accepted;
+}
+
+void OneDimComWindowScheduler::setRandomNumberSeed(int seed) {
+    random.seed(seed);
+}
+
+void OneDimComWindowScheduler::setWindowParameters(int window) {
+    // a Context created before the window was added needs the newer sets
+    // copied over, but only the first time
+    int context = windowContext[window];
+    if (contextSets[context] <= windowSet[window]) {
+        force.updateParametersInContext(*contexts[context]);
+        contextSets[context] = force.getNumParameterSets();
+    }
+    force.setActiveParameterSet(*contexts[context], windowSet[window]);
+}
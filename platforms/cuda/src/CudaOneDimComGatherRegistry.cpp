@@ -0,0 +1,232 @@
+#include "CudaOneDimComGatherRegistry.h"
+#include "CudaOneDimComKernelSources.h"
+#include "CudaOneDimComModuleCache.h"
+#include "openmm/OpenMMException.h"
+#include <algorithm>
+#include <mutex>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+namespace {
+
+map<CudaContext*, CudaOneDimComGatherRegistry*> registries;
+mutex registriesLock;
+
+}
+
+/**
+ * This gathers the groups at the start of each force evaluation.  It is owned by
+ * the context, and in turn owns the registry.
+ */
+class CudaOneDimComGatherRegistry::GatherPreComputation : public CudaContext::ForcePreComputation {
+public:
+    GatherPreComputation(CudaOneDimComGatherRegistry* registry) : registry(registry) {
+    }
+    ~GatherPreComputation() {
+        delete registry;
+    }
+    void computeForceAndEnergy(bool includeForces, bool includeEnergy, int groups) {
+        registry->gather(groups);
+    }
+private:
+    CudaOneDimComGatherRegistry* registry;
+};
+
+/**
+ * This marks the sums as stale once the force evaluation is over, since the
+ * positions may change before the next one.
+ */
+class CudaOneDimComGatherRegistry::GatherPostComputation : public CudaContext::ForcePostComputation {
+public:
+    GatherPostComputation(CudaOneDimComGatherRegistry* registry) : registry(registry) {
+    }
+    double computeForceAndEnergy(bool includeForces, bool includeEnergy, int groups) {
+        registry->hasSums = false;
+        return 0.0;
+    }
+private:
+    CudaOneDimComGatherRegistry* registry;
+};
+
+CudaOneDimComGatherRegistry& CudaOneDimComGatherRegistry::getRegistry(CudaContext& cu) {
+    lock_guard<mutex> guard(registriesLock);
+    map<CudaContext*, CudaOneDimComGatherRegistry*>::iterator existing = registries.find(&cu);
+    if (existing != registries.end())
+        return *existing->second;
+    CudaOneDimComGatherRegistry* registry = new CudaOneDimComGatherRegistry(cu);
+    cu.addPreComputation(new GatherPreComputation(registry));
+    cu.addPostComputation(new GatherPostComputation(registry));
+    registries[&cu] = registry;
+    return *registry;
+}
+
+CudaOneDimComGatherRegistry::CudaOneDimComGatherRegistry(CudaContext& cu) : cu(cu), needsRebuild(false), hasSums(false),
+        numGroups(0), forceGroups(0), module(NULL), groupStarts(NULL), atoms(NULL), weights(NULL), sums(NULL) {
+}
+
+CudaOneDimComGatherRegistry::~CudaOneDimComGatherRegistry() {
+    {
+        // a new context could later be created at the same address
+        lock_guard<mutex> guard(registriesLock);
+        registries.erase(&cu);
+    }
+    if (module != NULL)
+        CudaOneDimComModuleCache::releaseModule(cu, module);
+    if (groupStarts != NULL)
+        delete groupStarts;
+    if (atoms != NULL)
+        delete atoms;
+    if (weights != NULL)
+        delete weights;
+    if (sums != NULL)
+        delete sums;
+}
+
+int CudaOneDimComGatherRegistry::addForce(const vector<int>& group1, const vector<float>& weights1,
+        const vector<int>& group2, const vector<float>& weights2, int forceGroup) {
+    int handle;
+    if (freeHandles.empty()) {
+        registrations.push_back(Registration());
+        handle = registrations.size()-1;
+    }
+    else {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    }
+    updateForce(handle, group1, weights1, group2, weights2, forceGroup);
+    return handle;
+}
+
+void CudaOneDimComGatherRegistry::updateForce(int handle, const vector<int>& group1, const vector<float>& weights1,
+        const vector<int>& group2, const vector<float>& weights2, int forceGroup) {
+    Registration& registration = registrations[handle];
+    registration.group1 = Group(group1, weights1);
+    registration.group2 = Group(group2, weights2);
+    registration.forceGroup = forceGroup;
+    registration.active = true;
+    registration.sum1 = registration.sum2 = -1;
+    needsRebuild = true;
+    hasSums = false;
+}
+
+void CudaOneDimComGatherRegistry::removeForce(int handle) {
+    Registration& registration = registrations[handle];
+    registration.active = false;
+    registration.group1 = Group();
+    registration.group2 = Group();
+    registration.sum1 = registration.sum2 = -1;
+    freeHandles.push_back(handle);
+    needsRebuild = true;
+    hasSums = false;
+}
+
+void CudaOneDimComGatherRegistry::rebuild() {
+    needsRebuild = false;
+
+    // number the distinct groups and see whether any is used twice
+    map<Group, int> slots;
+    vector<const Group*> groups;
+    bool shared = false;
+    for (int i=0; i<registrations.size(); ++i) {
+        Registration& registration = registrations[i];
+        if (!registration.active)
+            continue;
+        const Group* groupsOfForce[] = {&registration.group1, &registration.group2};
+        int* forceSums[] = {&registration.sum1, &registration.sum2};
+        for (int j=0; j<2; ++j) {
+            map<Group, int>::iterator slot = slots.find(*groupsOfForce[j]);
+            if (slot == slots.end()) {
+                slot = slots.insert(make_pair(*groupsOfForce[j], (int) groups.size())).first;
+                groups.push_back(groupsOfForce[j]);
+            }
+            else
+                shared = true;
+            *forceSums[j] = slot->second;
+        }
+    }
+
+    // with nothing in common there is no traffic to save, so leave every
+    // force to its own (calibrated) reduction
+    numGroups = (shared ? groups.size() : 0);
+    forceGroups = 0;
+    for (int i=0; i<registrations.size(); ++i) {
+        if (!shared)
+            registrations[i].sum1 = registrations[i].sum2 = -1;
+        else if (registrations[i].active)
+            forceGroups |= 1<<registrations[i].forceGroup;
+    }
+    if (numGroups == 0)
+        return;
+
+    vector<int> h_groupStarts(1, 0);
+    vector<int> h_atoms;
+    vector<float> h_weights;
+    for (int i=0; i<groups.size(); ++i) {
+        h_atoms.insert(h_atoms.end(), groups[i]->first.begin(), groups[i]->first.end());
+        h_weights.insert(h_weights.end(), groups[i]->second.begin(), groups[i]->second.end());
+        h_groupStarts.push_back(h_atoms.size());
+    }
+    cu.setAsCurrent();
+    if (module == NULL) {
+        map<string, string> replacements;
+        map<string, string> defines;
+        module = CudaOneDimComModuleCache::getModule(cu, cu.replaceStrings(CudaOneDimComKernelSources::vectorOps + CudaOneDimComKernelSources::gatherOneDimComGroups, replacements), defines);
+        gatherKernel = cu.getKernel(module, "gatherOneDimComGroups");
+        combineKernel = cu.getKernel(module, "combineOneDimComGroupSums");
+    }
+    if (groupStarts != NULL)
+        delete groupStarts;
+    if (atoms != NULL)
+        delete atoms;
+    if (weights != NULL)
+        delete weights;
+    if (sums != NULL)
+        delete sums;
+    groupStarts = NULL;
+    atoms = NULL;
+    weights = NULL;
+    sums = NULL;
+    groupStarts = CudaArray::create<int>(cu, h_groupStarts.size(), "groupStarts");
+    atoms = CudaArray::create<int>(cu, max((int) h_atoms.size(), 1), "gatherAtoms");
+    weights = CudaArray::create<float>(cu, max((int) h_weights.size(), 1), "gatherWeights");
+    sums = CudaArray::create<float>(cu, numGroups, "groupSums");
+    groupStarts->upload(h_groupStarts);
+    if (!h_atoms.empty()) {
+        atoms->upload(h_atoms);
+        weights->upload(h_weights);
+    }
+}
+
+void CudaOneDimComGatherRegistry::gather(int groups) {
+    hasSums = false;
+    if (needsRebuild)
+        rebuild();
+    if (numGroups == 0 || (groups&forceGroups) == 0)
+        return;
+    void* args[] = {
+        &cu.getPosq().getDevicePointer(),
+        &numGroups,
+        &groupStarts->getDevicePointer(),
+        &atoms->getDevicePointer(),
+        &weights->getDevicePointer(),
+        &sums->getDevicePointer() };
+    cu.executeKernel(gatherKernel, args, numGroups*256, 256, 256 * sizeof(float));
+    hasSums = true;
+}
+
+bool CudaOneDimComGatherRegistry::computeDisplacement(int handle, CudaArray& displacement) {
+    const Registration& registration = registrations[handle];
+    if (!hasSums || registration.sum1 < 0)
+        return false;
+    int sum1 = registration.sum1;
+    int sum2 = registration.sum2;
+    void* args[] = {
+        &sums->getDevicePointer(),
+        &sum1,
+        &sum2,
+        &displacement.getDevicePointer() };
+    cu.executeKernel(combineKernel, args, 1, 1);
+    return true;
+}
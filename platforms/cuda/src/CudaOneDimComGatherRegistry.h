@@ -0,0 +1,99 @@
+#ifndef CUDA_ONEDIMCOM_GATHER_REGISTRY_H_
+#define CUDA_ONEDIMCOM_GATHER_REGISTRY_H_
+
+#include "openmm/cuda/CudaArray.h"
+#include "openmm/cuda/CudaContext.h"
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace OneDimComPlugin {
+
+/**
+ * This class lets the OneDimComForces in a CudaContext share the work of reducing
+ * their groups.  Each force registers its two groups, and groups with identical
+ * atoms and weights are only stored once.  If any group is used by more than one
+ * force, every unique group is reduced in a single kernel at the start of each
+ * force evaluation, and the forces take their displacements from those sums
+ * instead of reading the positions again.  Otherwise nothing is done and the
+ * forces reduce their groups themselves.
+ *
+ * Only whole groups are shared.  Groups that merely overlap, or that have the same
+ * atoms with different weights, are reduced separately, and each reads the atoms
+ * they have in common for itself.
+ *
+ * Handles of removed forces are reused by later calls to addForce(), so a context
+ * that keeps creating and destroying forces doesn't grow the registry.
+ *
+ * There is one registry per CudaContext.  It is owned by the context and destroyed
+ * along with it.
+ */
+class CudaOneDimComGatherRegistry {
+public:
+    /**
+     * Get the registry for a context, creating it if necessary.
+     */
+    static CudaOneDimComGatherRegistry& getRegistry(OpenMM::CudaContext& cu);
+    /**
+     * Register the groups of a force.
+     *
+     * @param group1       the indices of the group 1 atoms
+     * @param weights1     the weights of the group 1 atoms
+     * @param group2       the indices of the group 2 atoms
+     * @param weights2     the weights of the group 2 atoms
+     * @param forceGroup   the force group the force belongs to
+     * @return a handle to pass to the other methods
+     */
+    int addForce(const std::vector<int>& group1, const std::vector<float>& weights1,
+            const std::vector<int>& group2, const std::vector<float>& weights2, int forceGroup);
+    /**
+     * Change the groups of a registered force.
+     */
+    void updateForce(int handle, const std::vector<int>& group1, const std::vector<float>& weights1,
+            const std::vector<int>& group2, const std::vector<float>& weights2, int forceGroup);
+    /**
+     * Unregister a force.
+     */
+    void removeForce(int handle);
+    /**
+     * Write the displacement of a force to a buffer from the shared sums.  This
+     * only works during a force evaluation that gathered the groups.
+     *
+     * @param handle         the handle returned by addForce()
+     * @param displacement   the buffer to write the displacement to
+     * @return true if the displacement was written, false if the force must reduce
+     *         its groups itself
+     */
+    bool computeDisplacement(int handle, OpenMM::CudaArray& displacement);
+private:
+    class GatherPreComputation;
+    class GatherPostComputation;
+    typedef std::pair<std::vector<int>, std::vector<float> > Group;
+    struct Registration {
+        Group group1, group2;
+        int forceGroup;
+        bool active;
+        // the positions of the groups in the sums, or -1 when not gathered
+        int sum1, sum2;
+    };
+    CudaOneDimComGatherRegistry(OpenMM::CudaContext& cu);
+    ~CudaOneDimComGatherRegistry();
+    void rebuild();
+    void gather(int groups);
+    OpenMM::CudaContext& cu;
+    std::vector<Registration> registrations;
+    // the handles of removed forces, which addForce() hands out again
+    std::vector<int> freeHandles;
+    bool needsRebuild, hasSums;
+    int numGroups, forceGroups;
+    CUmodule module;
+    CUfunction gatherKernel, combineKernel;
+    OpenMM::CudaArray* groupStarts;
+    OpenMM::CudaArray* atoms;
+    OpenMM::CudaArray* weights;
+    OpenMM::CudaArray* sums;
+};
+
+} // namespace OneDimComPlugin
+
+#endif /*CUDA_ONEDIMCOM_GATHER_REGISTRY_H_*/
@@ -48,6 +48,9 @@ extern "C" OPENMM_EXPORT void registerKernelFactories() {
         Platform& platform = Platform::getPlatformByName("CUDA");
         CudaOneDimComKernelFactory* factory = new CudaOneDimComKernelFactory();
         platform.registerKernelFactory(CalcOneDimComForceKernel::Name(), factory);
+        platform.registerKernelFactory(CalcOneDimComCombinationForceKernel::Name(), factory);
+        platform.registerKernelFactory(CalcOneDimComRegionForceKernel::Name(), factory);
+        platform.registerKernelFactory(CalcOneDimComPairwiseForceKernel::Name(), factory);
     }
     catch (std::exception ex) {
         // Ignore
@@ -68,5 +71,11 @@ KernelImpl* CudaOneDimComKernelFactory::createKernelImpl(std::string name, const
     CudaContext& cu = *static_cast<CudaPlatform::PlatformData*>(context.getPlatformData())->contexts[0];
     if (name == CalcOneDimComForceKernel::Name())
         return new CudaCalcOneDimComForceKernel(name, platform, cu, context.getSystem());
+    if (name == CalcOneDimComCombinationForceKernel::Name())
+        return new CudaCalcOneDimComCombinationForceKernel(name, platform, cu, context.getSystem());
+    if (name == CalcOneDimComRegionForceKernel::Name())
+        return new CudaCalcOneDimComRegionForceKernel(name, platform, cu, context.getSystem());
+    if (name == CalcOneDimComPairwiseForceKernel::Name())
+        return new CudaCalcOneDimComPairwiseForceKernel(name, platform, cu, context.getSystem());
     throw OpenMMException((std::string("Tried to create kernel with illegal kernel name '")+name+"'").c_str());
 }
@@ -1,16 +1,50 @@
 #include "CudaOneDimComKernels.h"
+#include "CudaOneDimComGatherRegistry.h"
 #include "CudaOneDimComKernelSources.h"
+#include "CudaOneDimComModuleCache.h"
+#include "internal/OneDimComReduction.h"
 #include "openmm/internal/ContextImpl.h"
 #include "openmm/cuda/CudaBondedUtilities.h"
 #include "openmm/cuda/CudaForceInfo.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <utility>
 
 using namespace OneDimComPlugin;
 using namespace OpenMM;
 using namespace std;
 
+namespace {
+
+// list the distinct atoms of indices, and the position of each entry among them
+void combineConstraintAtoms(const vector<int>& indices, vector<int>& atoms, vector<int>& slots) {
+    map<int, int> atomSlots;
+    atoms.clear();
+    slots.resize(indices.size());
+    for (int i=0; i<indices.size(); ++i) {
+        map<int, int>::iterator slot = atomSlots.find(indices[i]);
+        if (slot == atomSlots.end()) {
+            slot = atomSlots.insert(make_pair(indices[i], (int) atoms.size())).first;
+            atoms.push_back(indices[i]);
+        }
+        slots[i] = slot->second;
+    }
+}
+
+// the reduction strategy chosen for each device and size class, where the
+// size class is the number of bits needed to hold the number of atoms
+map<pair<int, int>, pair<int, int> > strategies;
+mutex strategiesLock;
+
+}
+
 CudaCalcOneDimComForceKernel::CudaCalcOneDimComForceKernel(std::string name, const OpenMM::Platform& platform, OpenMM::CudaContext& cu, const OpenMM::System& system) :
-            CalcOneDimComForceKernel(name, platform), hasInitializedKernel(false), cu(cu), system(system), indices(NULL), weights(NULL), h_indices(0), h_weights(0),
-            forceConst(0.0), r0(0.0)
+            CalcOneDimComForceKernel(name, platform), hasInitializedKernel(false), cu(cu), system(system), module(NULL), indices(NULL), weights(NULL), publishedWeights(NULL), displacement(NULL), currentDisplacement(NULL), constraintForce(NULL), numConstraintAtoms(0), constraintAtoms(NULL), constraintWeights(NULL), publishedConstraintWeights(NULL), activeConstraintWeights(0), work(NULL), numThresholds(0), thresholds(NULL), thresholdEvent(NULL), lastDisplacement(NULL), varianceStart(0), varianceEnd(0), varianceForceConst(0.0), variance0(0.0), moments(NULL), checksums(NULL), partialChecksums(NULL), hasChecksum(false), recordBuffer(NULL), firstRecord(0), numRecords(0), partialSums(NULL), numBlocks(1), numThreads(1024), h_indices(0), h_weights(0),
+            forceConst(0.0), r0(0.0), activeSet(0), activeWeights(0), gatherRegistry(NULL), gatherHandle(-1),
+            hasWorkParameters(false), workForceConst(0.0), workR0(0.0)
 {
     if (cu.getUseDoublePrecision()) {
         cout << "***\n";
@@ -22,6 +56,10 @@ CudaCalcOneDimComForceKernel::CudaCalcOneDimComForceKernel(std::string name, con
 
 CudaCalcOneDimComForceKernel::~CudaCalcOneDimComForceKernel() {
     cu.setAsCurrent();
+    if (gatherHandle >= 0)
+        gatherRegistry->removeForce(gatherHandle);
+    if (module != NULL)
+        CudaOneDimComModuleCache::releaseModule(cu, module);
     if (indices != NULL) {
         delete indices;
         indices = NULL;
@@ -30,54 +68,835 @@ CudaCalcOneDimComForceKernel::~CudaCalcOneDimComForceKernel() {
         delete weights;
         indices = NULL;
     }
+    if (publishedWeights != NULL) {
+        delete publishedWeights;
+        publishedWeights = NULL;
+    }
+    if (displacement != NULL) {
+        delete displacement;
+        displacement = NULL;
+    }
+    if (currentDisplacement != NULL) {
+        delete currentDisplacement;
+        currentDisplacement = NULL;
+    }
+    if (constraintForce != NULL) {
+        delete constraintForce;
+        constraintForce = NULL;
+    }
+    if (constraintAtoms != NULL) {
+        delete constraintAtoms;
+        constraintAtoms = NULL;
+    }
+    if (constraintWeights != NULL) {
+        delete constraintWeights;
+        constraintWeights = NULL;
+    }
+    if (publishedConstraintWeights != NULL) {
+        delete publishedConstraintWeights;
+        publishedConstraintWeights = NULL;
+    }
+    if (partialSums != NULL) {
+        delete partialSums;
+        partialSums = NULL;
+    }
+    if (work != NULL) {
+        delete work;
+        work = NULL;
+    }
+    if (thresholds != NULL) {
+        delete thresholds;
+        thresholds = NULL;
+    }
+    if (thresholdEvent != NULL) {
+        delete thresholdEvent;
+        thresholdEvent = NULL;
+    }
+    if (lastDisplacement != NULL) {
+        delete lastDisplacement;
+        lastDisplacement = NULL;
+    }
+    if (moments != NULL) {
+        delete moments;
+        moments = NULL;
+    }
+    if (checksums != NULL) {
+        delete checksums;
+        checksums = NULL;
+    }
+    if (partialChecksums != NULL) {
+        delete partialChecksums;
+        partialChecksums = NULL;
+    }
+    if (recordBuffer != NULL) {
+        for (int i=0; i<recordEvents.size(); ++i)
+            cuEventDestroy(recordEvents[i]);
+        cuMemFreeHost(recordBuffer);
+        recordBuffer = NULL;
+    }
 }
 
 void CudaCalcOneDimComForceKernel::setupIndicesAndWeights(const OneDimComForce& force) {
-    // concatenate the indices into a single vector
-    h_indices.clear();
-    h_indices.reserve(force.getGroup1Indices().size() + force.getGroup2Indices().size());
-    h_indices.insert(h_indices.end(), force.getGroup1Indices().begin(), force.getGroup1Indices().end());
-    h_indices.insert(h_indices.end(), force.getGroup2Indices().begin(), force.getGroup2Indices().end());
+    OneDimComReduction reduction(force);
+    h_indices = reduction.getIndices();
+
+    // every parameter set is kept on the device, one after another, so
+    // switching between them only has to move a pointer
+    int numSets = force.getNumParameterSets();
+    h_weights.resize(numSets*h_indices.size());
+    h_forceConsts.resize(numSets);
+    h_r0s.resize(numSets);
+    for (int i=0; i<numSets; ++i) {
+        OneDimComReduction setReduction(force, i);
+        copy(setReduction.getWeights().begin(), setReduction.getWeights().end(), h_weights.begin()+i*h_indices.size());
+        vector<float> weights1, weights2;
+        force.getParameterSet(i, h_forceConsts[i], h_r0s[i], weights1, weights2);
+    }
+    if (activeSet >= numSets)
+        activeSet = 0;
 
+    // the constraint moves each atom once, so an atom in both groups gets
+    // its combined weight rather than two entries that would race
+    vector<int> slots;
+    combineConstraintAtoms(h_indices, h_constraintAtoms, slots);
+    numConstraintAtoms = h_constraintAtoms.size();
+    h_constraintWeights.assign(numSets*numConstraintAtoms, 0.0f);
+    for (int i=0; i<numSets; ++i)
+        for (int j=0; j<h_indices.size(); ++j)
+            h_constraintWeights[i*numConstraintAtoms+slots[j]] += h_weights[i*h_indices.size()+j];
+}
+
+void CudaCalcOneDimComForceKernel::registerGroups(const OneDimComForce& force) {
+    // only a force with a single parameter set has fixed weights that
+    // other forces could share
+    bool share = (force.getNumParameterSets() == 1);
+    if (!share) {
+        if (gatherHandle >= 0)
+            gatherRegistry->removeForce(gatherHandle);
+        gatherHandle = -1;
+        return;
+    }
+    if (gatherRegistry == NULL)
+        gatherRegistry = &CudaOneDimComGatherRegistry::getRegistry(cu);
+    if (gatherHandle < 0)
+        gatherHandle = gatherRegistry->addForce(force.getGroup1Indices(), force.getGroup1Weights(),
+                force.getGroup2Indices(), force.getGroup2Weights(), force.getForceGroup());
+    else
+        gatherRegistry->updateForce(gatherHandle, force.getGroup1Indices(), force.getGroup1Weights(),
+                force.getGroup2Indices(), force.getGroup2Weights(), force.getForceGroup());
+}
 
-    // concatenate the weights, negating weights2
-    h_weights.clear();
-    h_weights.reserve(force.getGroup1Weights().size() + force.getGroup2Weights().size());
-    vector<float> w2_copy(force.getGroup2Weights().size());
-    copy(force.getGroup2Weights().begin(), force.getGroup2Weights().end(), w2_copy.begin());
-    for(vector<float>::iterator it=w2_copy.begin(); it!=w2_copy.end(); ++it) {
-        *it = -*it;
+void CudaCalcOneDimComForceKernel::setupThresholds(const OneDimComForce& force) {
+    numThresholds = force.getNumThresholds();
+    if (numThresholds == 0)
+        return;
+    vector<float> h_thresholds(numThresholds);
+    for (int i=0; i<numThresholds; ++i)
+        h_thresholds[i] = (float) force.getThreshold(i);
+    if (thresholds != NULL && thresholds->getSize() != numThresholds) {
+        delete thresholds;
+        thresholds = NULL;
     }
-    h_weights.insert(h_weights.end(), force.getGroup1Weights().begin(), force.getGroup1Weights().end());
-    h_weights.insert(h_weights.end(), w2_copy.begin(), w2_copy.end());
+    if (thresholds == NULL)
+        thresholds = CudaArray::create<float>(cu, numThresholds, "thresholds");
+    thresholds->upload(h_thresholds);
+}
+
+void CudaCalcOneDimComForceKernel::setupVariance(const OneDimComForce& force) {
+    int numGroup1 = force.getGroup1Indices().size();
+    varianceStart = (force.getVarianceGroup() == 2 ? numGroup1 : 0);
+    varianceEnd = (force.getVarianceGroup() == 0 ? 0 : force.getVarianceGroup() == 1 ? numGroup1 : numAtoms);
+    varianceForceConst = (float) force.getVarianceForceConst();
+    variance0 = (float) force.getVariance0();
+}
+
+void CudaCalcOneDimComForceKernel::setActiveParameterSet(ContextImpl& context, int index) {
+    activeSet = index;
+    forceConst = h_forceConsts[index];
+    r0 = h_r0s[index];
+    if (weights != NULL)
+        activeWeights = weights->getDevicePointer() + index*numAtoms*sizeof(float);
+    if (constraintWeights != NULL)
+        activeConstraintWeights = constraintWeights->getDevicePointer() + index*numConstraintAtoms*sizeof(float);
 }
 
 void CudaCalcOneDimComForceKernel::initialize(const System& system, const OneDimComForce& force) {
     cu.setAsCurrent();
 
+    setupIndicesAndWeights(force);
+    forceConst = h_forceConsts[0];
+    r0 = h_r0s[0];
+
+    numAtoms = force.getGroup1Indices().size() + force.getGroup2Indices().size();
+    if (numAtoms == 0)
+        return;
+
+    indices = CudaArray::create<int>(cu, numAtoms, "indices");
+    weights = CudaArray::create<float>(cu, h_weights.size(), "weights");
+    displacement = CudaArray::create<float>(cu, 1, "displacement");
+    currentDisplacement = CudaArray::create<float>(cu, 1, "currentDisplacement");
+    constraintForce = CudaArray::create<float>(cu, 1, "constraintForce");
+
+    indices->upload(h_indices);
+    weights->upload(h_weights);
+    activeWeights = weights->getDevicePointer();
+    constraintAtoms = CudaArray::create<int>(cu, numConstraintAtoms, "constraintAtoms");
+    constraintWeights = CudaArray::create<float>(cu, h_constraintWeights.size(), "constraintWeights");
+    constraintAtoms->upload(h_constraintAtoms);
+    constraintWeights->upload(h_constraintWeights);
+    activeConstraintWeights = constraintWeights->getDevicePointer();
+    float zero = 0.0f;
+    constraintForce->upload(&zero);
+    work = CudaArray::create<double>(cu, 1, "work");
+    double zeroWork = 0.0;
+    work->upload(&zeroWork);
+    thresholdEvent = CudaArray::create<long long>(cu, 5, "thresholdEvent");
+    lastDisplacement = CudaArray::create<float>(cu, 1, "lastDisplacement");
+    vector<long long> noEvent(5, 0);
+    thresholdEvent->upload(noEvent);
+    setupThresholds(force);
+    moments = CudaArray::create<float>(cu, 3, "moments");
+    vector<float> noMoments(3, 0.0f);
+    moments->upload(noMoments);
+    setupVariance(force);
+    checksums = CudaArray::create<unsigned long long>(cu, 2, "checksums");
+
+    // the source doesn't depend on the number of atoms, so leave it out of the
+    // defines to let every system share the same compiled module
+    map<string, string> replacements;
+    map<string, string> defines;
+    module = CudaOneDimComModuleCache::getModule(cu, cu.replaceStrings(CudaOneDimComKernelSources::vectorOps + CudaOneDimComKernelSources::computeOneDimComForce, replacements), defines);
+    computeForceKernel = cu.getKernel(module, "computeOneDimComForce");
+    computeForceOnlyKernel = cu.getKernel(module, "computeOneDimComForceOnly");
+    computeEnergyKernel = cu.getKernel(module, "computeOneDimComEnergy");
+    applyCachedForceKernel = cu.getKernel(module, "applyCachedOneDimComForce");
+    applyCachedForceOnlyKernel = cu.getKernel(module, "applyCachedOneDimComForceOnly");
+    applyCachedEnergyKernel = cu.getKernel(module, "applyCachedOneDimComEnergy");
+    computeDisplacementKernel = cu.getKernel(module, "computeOneDimComDisplacement");
+    applyConstraintKernel = cu.getKernel(module, "applyOneDimComConstraint");
+    partialDisplacementKernel = cu.getKernel(module, "reduceOneDimComPartialDisplacement");
+    finishDisplacementKernel = cu.getKernel(module, "finishOneDimComDisplacement");
+    applyCollectiveVariableKernel = cu.getKernel(module, "applyOneDimComCollectiveVariable");
+    applyStrideKernel = cu.getKernel(module, "applyOneDimComStrideForce");
+    accumulateWorkKernel = cu.getKernel(module, "accumulateOneDimComWork");
+    checkThresholdsKernel = cu.getKernel(module, "checkOneDimComThresholds");
+    computeMomentsKernel = cu.getKernel(module, "computeOneDimComMoments");
+    applyMomentForceKernel = cu.getKernel(module, "applyOneDimComMomentForce");
+    refreshDisplacementKernel = cu.getKernel(module, "refreshOneDimComDisplacement");
+    partialSums = CudaArray::create<float>(cu, max(cu.getNumThreadBlocks(), 1), "partialSums");
+    partialChecksums = CudaArray::create<unsigned long long>(cu, max(cu.getNumThreadBlocks(), 1), "partialChecksums");
+    chooseStrategy();
+    registerGroups(force);
+}
+
+void CudaCalcOneDimComForceKernel::chooseStrategy() {
+    int sizeClass = 0;
+    while ((1<<sizeClass) < numAtoms)
+        sizeClass++;
+    pair<int, int> key = make_pair(cu.getDeviceIndex(), sizeClass);
+    {
+        lock_guard<mutex> guard(strategiesLock);
+        map<pair<int, int>, pair<int, int> >::iterator cached = strategies.find(key);
+        if (cached != strategies.end()) {
+            numBlocks = cached->second.first;
+            numThreads = cached->second.second;
+            return;
+        }
+    }
+
+    // small groups are best served by a single block of the right size,
+    // while large ones need to be spread over the whole device
+    vector<pair<int, int> > candidates;
+    candidates.push_back(make_pair(1, 64));
+    candidates.push_back(make_pair(1, 256));
+    candidates.push_back(make_pair(1, 1024));
+    int maxBlocks = min(cu.getNumThreadBlocks(), (numAtoms+255)/256);
+    if (maxBlocks > 1)
+        candidates.push_back(make_pair(maxBlocks, 256));
+    if (maxBlocks/4 > 1)
+        candidates.push_back(make_pair(maxBlocks/4, 256));
+
+    // time the reduction alone, since that is all the strategy affects
+    double bestTime = 0.0;
+    pair<int, int> best = candidates[0];
+    for (int i=0; i<candidates.size(); ++i) {
+        numBlocks = candidates[i].first;
+        numThreads = candidates[i].second;
+        reduceDisplacement(displacement);
+        cuCtxSynchronize();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int j=0; j<10; ++j)
+            reduceDisplacement(displacement);
+        cuCtxSynchronize();
+        double time = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+        if (i == 0 || time < bestTime) {
+            bestTime = time;
+            best = candidates[i];
+        }
+    }
+    numBlocks = best.first;
+    numThreads = best.second;
+    lock_guard<mutex> guard(strategiesLock);
+    strategies[key] = best;
+}
+
+void CudaCalcOneDimComForceKernel::reduceDisplacement(CudaArray* target) {
+    // during a force evaluation the groups may already have been gathered
+    // along with those of other forces, which leaves no checksum behind
+    if (gatherHandle >= 0 && gatherRegistry->computeDisplacement(gatherHandle, *target)) {
+        if (target == displacement)
+            hasChecksum = false;
+        return;
+    }
+
+    // only the displacement that is kept has its checksum kept with it
+    CUdeviceptr checksum = checksums->getDevicePointer() + (target == displacement ? 0 : sizeof(unsigned long long));
+    if (target == displacement)
+        hasChecksum = true;
+    if (numBlocks == 1) {
+        void* args[] = {
+            &cu.getPosq().getDevicePointer(),
+            &numAtoms,
+            &indices->getDevicePointer(),
+            &activeWeights,
+            &target->getDevicePointer(),
+            &checksum };
+        cu.executeKernel(computeDisplacementKernel, args, numThreads, numThreads, numThreads * sizeof(float));
+        return;
+    }
+    void* partialArgs[] = {
+        &cu.getPosq().getDevicePointer(),
+        &numAtoms,
+        &indices->getDevicePointer(),
+        &activeWeights,
+        &partialSums->getDevicePointer(),
+        &partialChecksums->getDevicePointer() };
+    cu.executeKernel(partialDisplacementKernel, partialArgs, numBlocks*numThreads, numThreads, numThreads * sizeof(float));
+    void* finishArgs[] = {
+        &numBlocks,
+        &partialSums->getDevicePointer(),
+        &partialChecksums->getDevicePointer(),
+        &target->getDevicePointer(),
+        &checksum };
+    cu.executeKernel(finishDisplacementKernel, finishArgs, 256, 256, 256 * sizeof(float));
+}
+
+void CudaCalcOneDimComForceKernel::refreshDisplacement(ContextImpl& context) {
+    if (numAtoms == 0)
+        return;
+    cu.setAsCurrent();
+    if (!hasChecksum) {
+        if (varianceEnd > varianceStart)
+            computeMoments();
+        else
+            reduceDisplacement(displacement);
+        return;
+    }
+
+    // the comparison and, if it fails, the new reduction both happen on the
+    // device, so nothing here waits for it
+    void* args[] = {
+        &cu.getPosq().getDevicePointer(),
+        &numAtoms,
+        &varianceStart,
+        &varianceEnd,
+        &indices->getDevicePointer(),
+        &activeWeights,
+        &displacement->getDevicePointer(),
+        &moments->getDevicePointer(),
+        &checksums->getDevicePointer() };
+    cu.executeKernel(refreshDisplacementKernel, args, numThreads, numThreads, 3 * numThreads * sizeof(float));
+}
+
+string CudaCalcOneDimComForceKernel::getExecutionStrategy(ContextImpl& context) {
+    stringstream strategy;
+    strategy << "blocks=" << numBlocks << " threads=" << numThreads;
+    return strategy.str();
+}
+
+double CudaCalcOneDimComForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    // a variance restraint needs the moments of its group as well, which
+    // come from the same single block pass as the displacement
+    if (varianceEnd > varianceStart) {
+        computeMoments();
+        applyMomentForce(includeForces, includeEnergy);
+        return 0.0;
+    }
+
+    // a single block does the whole job in one kernel, while more than
+    // one, or taking the displacement from the shared sums, has to apply
+    // the forces separately.  With neither forces nor energy wanted only
+    // the displacement is kept, for the colvar file and the thresholds.
+    if (gatherHandle >= 0 && gatherRegistry->computeDisplacement(gatherHandle, *displacement)) {
+        hasChecksum = false;
+        executeCached(context, includeForces, includeEnergy);
+    }
+    else if (numBlocks == 1 && (includeForces || includeEnergy)) {
+        void* args[] = {
+            &cu.getPosq().getDevicePointer(),
+            &numAtoms,
+            &forceConst,
+            &r0,
+            &indices->getDevicePointer(),
+            &activeWeights,
+            &cu.getForce().getDevicePointer(),
+            &cu.getEnergyBuffer().getDevicePointer(),
+            &displacement->getDevicePointer(),
+            &checksums->getDevicePointer() };
+        CUfunction kernel = (!includeEnergy ? computeForceOnlyKernel : !includeForces ? computeEnergyKernel : computeForceKernel);
+        cu.executeKernel(kernel, args, numThreads, numThreads, numThreads * sizeof(float));
+        hasChecksum = true;
+        accumulateWork();
+    }
+    else {
+        reduceDisplacement(displacement);
+        executeCached(context, includeForces, includeEnergy);
+    }
+    return 0.0;
+}
+
+void CudaCalcOneDimComForceKernel::accumulateWork() {
+    // only launched when the parameters changed since the last evaluation,
+    // which is every step during a pull and never otherwise
+    if (hasWorkParameters && (forceConst != workForceConst || r0 != workR0)) {
+        void* args[] = {
+            &forceConst,
+            &r0,
+            &workForceConst,
+            &workR0,
+            &displacement->getDevicePointer(),
+            &work->getDevicePointer() };
+        cu.executeKernel(accumulateWorkKernel, args, 1, 1);
+    }
+    hasWorkParameters = true;
+    workForceConst = forceConst;
+    workR0 = r0;
+}
+
+void CudaCalcOneDimComForceKernel::setScheduledParameters(ContextImpl& context, double k, double r0, bool doesWork) {
+    // a change that does no work moves the parameters work is measured from
+    // along with it, so only other changes since the last evaluation count
+    float newForceConst = (float) k;
+    float newR0 = (float) r0;
+    if (!doesWork && hasWorkParameters) {
+        workForceConst = (workForceConst == forceConst ? newForceConst : workForceConst+newForceConst-forceConst);
+        workR0 = (workR0 == this->r0 ? newR0 : workR0+newR0-this->r0);
+    }
+    forceConst = newForceConst;
+    this->r0 = newR0;
+}
+
+void CudaCalcOneDimComForceKernel::setPublishedParameters(ContextImpl& context, double k, double r0,
+        const vector<float>& weights1, const vector<float>& weights2) {
+    forceConst = (float) k;
+    this->r0 = (float) r0;
+    if (weights1.empty() || numAtoms == 0)
+        return;
+
+    // lay the weights out the same way OneDimComReduction does
+    vector<float> h_published(numAtoms);
+    for (int i=0; i<weights1.size(); ++i)
+        h_published[i] = weights1[i];
+    for (int i=0; i<weights2.size(); ++i)
+        h_published[weights1.size()+i] = -weights2[i];
+    cu.setAsCurrent();
+    if (publishedWeights == NULL)
+        publishedWeights = CudaArray::create<float>(cu, numAtoms, "publishedWeights");
+    publishedWeights->upload(h_published);
+    activeWeights = publishedWeights->getDevicePointer();
+    vector<int> atoms, slots;
+    combineConstraintAtoms(h_indices, atoms, slots);
+    vector<float> h_publishedConstraint(numConstraintAtoms, 0.0f);
+    for (int i=0; i<numAtoms; ++i)
+        h_publishedConstraint[slots[i]] += h_published[i];
+    if (publishedConstraintWeights == NULL)
+        publishedConstraintWeights = CudaArray::create<float>(cu, numConstraintAtoms, "publishedConstraintWeights");
+    publishedConstraintWeights->upload(h_publishedConstraint);
+    activeConstraintWeights = publishedConstraintWeights->getDevicePointer();
+
+    // the shared sums were gathered with the old weights, so this force
+    // reduces its own groups from now on
+    if (gatherHandle >= 0) {
+        gatherRegistry->removeForce(gatherHandle);
+        gatherHandle = -1;
+    }
+}
+
+double CudaCalcOneDimComForceKernel::getWork(ContextImpl& context) {
+    if (numAtoms == 0)
+        return 0.0;
+    cu.setAsCurrent();
+    double h_work;
+    work->download(&h_work);
+    return h_work;
+}
+
+void CudaCalcOneDimComForceKernel::resetWork(ContextImpl& context) {
+    if (numAtoms == 0)
+        return;
+    cu.setAsCurrent();
+    double zero = 0.0;
+    work->upload(&zero);
+}
+
+void CudaCalcOneDimComForceKernel::checkThresholds(ContextImpl& context, long long step) {
+    if (numAtoms == 0 || numThresholds == 0)
+        return;
+    void* args[] = {
+        &numThresholds,
+        &thresholds->getDevicePointer(),
+        &step,
+        &displacement->getDevicePointer(),
+        &lastDisplacement->getDevicePointer(),
+        &thresholdEvent->getDevicePointer() };
+    cu.executeKernel(checkThresholdsKernel, args, 1, 1);
+}
+
+bool CudaCalcOneDimComForceKernel::getThresholdEvent(ContextImpl& context, int& threshold, long long& step, int& direction) {
+    if (numAtoms == 0)
+        return false;
+    cu.setAsCurrent();
+    vector<long long> event;
+    thresholdEvent->download(event);
+    if (event[0] == 0)
+        return false;
+    threshold = (int) event[1];
+    step = event[2];
+    direction = (int) event[3];
+    return true;
+}
+
+void CudaCalcOneDimComForceKernel::resetThresholdEvent(ContextImpl& context) {
+    if (numAtoms == 0)
+        return;
+    cu.setAsCurrent();
+    vector<long long> noEvent(5, 0);
+    thresholdEvent->upload(noEvent);
+}
+
+void CudaCalcOneDimComForceKernel::computeMoments() {
+    void* args[] = {
+        &cu.getPosq().getDevicePointer(),
+        &numAtoms,
+        &varianceStart,
+        &varianceEnd,
+        &indices->getDevicePointer(),
+        &activeWeights,
+        &displacement->getDevicePointer(),
+        &moments->getDevicePointer(),
+        &checksums->getDevicePointer() };
+    cu.executeKernel(computeMomentsKernel, args, numThreads, numThreads, 3 * numThreads * sizeof(float));
+    hasChecksum = true;
+}
+
+void CudaCalcOneDimComForceKernel::applyMomentForce(bool includeForces, bool includeEnergy) {
+    int forceFlag = (includeForces ? 1 : 0);
+    int energyFlag = (includeEnergy ? 1 : 0);
+    void* args[] = {
+        &cu.getPosq().getDevicePointer(),
+        &numAtoms,
+        &forceConst,
+        &r0,
+        &varianceStart,
+        &varianceEnd,
+        &varianceForceConst,
+        &variance0,
+        &forceFlag,
+        &energyFlag,
+        &indices->getDevicePointer(),
+        &activeWeights,
+        &cu.getForce().getDevicePointer(),
+        &cu.getEnergyBuffer().getDevicePointer(),
+        &displacement->getDevicePointer(),
+        &moments->getDevicePointer() };
+    cu.executeKernel(applyMomentForceKernel, args, (includeForces ? numAtoms : 1));
+    accumulateWork();
+}
+
+double CudaCalcOneDimComForceKernel::getVariance(ContextImpl& context) {
+    if (numAtoms == 0 || varianceEnd <= varianceStart)
+        return 0.0;
+    cu.setAsCurrent();
+    vector<float> h_moments;
+    moments->download(h_moments);
+    return h_moments[2];
+}
+
+void CudaCalcOneDimComForceKernel::recordDisplacement(ContextImpl& context, bool reduce) {
+    cu.setAsCurrent();
+    if (recordBuffer == NULL) {
+        if (cuMemHostAlloc((void**) &recordBuffer, 2*MaxRecordedDisplacements*sizeof(float), 0) != CUDA_SUCCESS)
+            throw OpenMMException("Unable to allocate the buffer for recorded displacements");
+        recordEvents.resize(MaxRecordedDisplacements);
+        for (int i=0; i<MaxRecordedDisplacements; ++i)
+            cuEventCreate(&recordEvents[i], CU_EVENT_DISABLE_TIMING);
+    }
+    if (numRecords == MaxRecordedDisplacements)
+        throw OpenMMException("Too many recorded displacements are waiting to be collected");
+
+    // the copies are queued behind the reduction on the same stream, so
+    // nothing here waits for the device
+    int slot = (firstRecord+numRecords)%MaxRecordedDisplacements;
+    float* target = recordBuffer+2*slot;
+    bool hasVariance = (varianceEnd > varianceStart);
+    if (numAtoms == 0)
+        target[0] = 0.0f;
+    else {
+        if (reduce) {
+            if (hasVariance)
+                computeMoments();
+            else
+                reduceDisplacement(displacement);
+        }
+        cuMemcpyDtoHAsync(target, displacement->getDevicePointer(), sizeof(float), cu.getCurrentStream());
+    }
+    if (numAtoms != 0 && hasVariance)
+        cuMemcpyDtoHAsync(target+1, moments->getDevicePointer()+2*sizeof(float), sizeof(float), cu.getCurrentStream());
+    else
+        target[1] = 0.0f;
+    cuEventRecord(recordEvents[slot], cu.getCurrentStream());
+    numRecords++;
+}
+
+bool CudaCalcOneDimComForceKernel::getRecordedDisplacement(ContextImpl& context, bool wait, double& recordedDisplacement, double& recordedVariance) {
+    if (numRecords == 0)
+        return false;
+    cu.setAsCurrent();
+    if (wait)
+        cuEventSynchronize(recordEvents[firstRecord]);
+    else if (cuEventQuery(recordEvents[firstRecord]) != CUDA_SUCCESS)
+        return false;
+    recordedDisplacement = recordBuffer[2*firstRecord];
+    recordedVariance = recordBuffer[2*firstRecord+1];
+    firstRecord = (firstRecord+1)%MaxRecordedDisplacements;
+    numRecords--;
+    return true;
+}
+
+double CudaCalcOneDimComForceKernel::executeCached(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    if (varianceEnd > varianceStart) {
+        applyMomentForce(includeForces, includeEnergy);
+        return 0.0;
+    }
+    if (includeForces || includeEnergy) {
+        void* args[] = {
+            &numAtoms,
+            &forceConst,
+            &r0,
+            &indices->getDevicePointer(),
+            &activeWeights,
+            &cu.getForce().getDevicePointer(),
+            &cu.getEnergyBuffer().getDevicePointer(),
+            &displacement->getDevicePointer() };
+        if (!includeForces)
+            cu.executeKernel(applyCachedEnergyKernel, args, 1, 1);
+        else
+            cu.executeKernel(includeEnergy ? applyCachedForceKernel : applyCachedForceOnlyKernel, args, numAtoms);
+    }
+    accumulateWork();
+    return 0.0;
+}
+
+double CudaCalcOneDimComForceKernel::executeCollectiveVariable(ContextImpl& context, bool reduce, bool includeForces, bool includeEnergy) {
+    // the displacement is still kept when neither is wanted, for the
+    // colvar file and the thresholds
+    if (reduce)
+        reduceDisplacement(displacement);
+    if (!includeForces && !includeEnergy)
+        return 0.0;
+    int forceFlag = (includeForces ? 1 : 0);
+    int energyFlag = (includeEnergy ? 1 : 0);
+    void* args[] = {
+        &numAtoms,
+        &forceFlag,
+        &energyFlag,
+        &indices->getDevicePointer(),
+        &activeWeights,
+        &cu.getForce().getDevicePointer(),
+        &cu.getEnergyBuffer().getDevicePointer(),
+        &displacement->getDevicePointer() };
+    cu.executeKernel(applyCollectiveVariableKernel, args, (includeForces ? numAtoms : 1));
+    return 0.0;
+}
+
+double CudaCalcOneDimComForceKernel::executeStride(ContextImpl& context, bool reduce, double forceScale, bool includeEnergy) {
+    // between evaluations the energy needs a reduction of its own, which
+    // must not disturb the displacement the forces are held at
+    CudaArray* energyDisplacement = displacement;
+    if (reduce) {
+        reduceDisplacement(displacement);
+        accumulateWork();
+    }
+    else if (includeEnergy) {
+        reduceDisplacement(currentDisplacement);
+        energyDisplacement = currentDisplacement;
+    }
+    if (forceScale == 0.0 && !includeEnergy)
+        return 0.0;
+    float scale = (float) forceScale;
+    int energyFlag = (includeEnergy ? 1 : 0);
+    void* args[] = {
+        &numAtoms,
+        &forceConst,
+        &r0,
+        &scale,
+        &energyFlag,
+        &indices->getDevicePointer(),
+        &activeWeights,
+        &cu.getForce().getDevicePointer(),
+        &cu.getEnergyBuffer().getDevicePointer(),
+        &displacement->getDevicePointer(),
+        &energyDisplacement->getDevicePointer() };
+    cu.executeKernel(applyStrideKernel, args, numAtoms);
+    return 0.0;
+}
+
+double CudaCalcOneDimComForceKernel::getDisplacement(ContextImpl& context) {
+    cu.setAsCurrent();
+    float h_displacement;
+    displacement->download(&h_displacement);
+    return h_displacement;
+}
+
+double CudaCalcOneDimComForceKernel::computeDisplacement(ContextImpl& context) {
+    cu.setAsCurrent();
+    if (varianceEnd > varianceStart)
+        computeMoments();
+    else
+        reduceDisplacement(displacement);
+    return getDisplacement(context);
+}
+
+void CudaCalcOneDimComForceKernel::applyConstraint(ContextImpl& context, double stepSize) {
+    if (numAtoms == 0)
+        return;
+    cu.setAsCurrent();
+    float stepSizeFloat = (float) stepSize;
+    CUdeviceptr posqCorrection = (cu.getUseMixedPrecision() ? cu.getPosqCorrection().getDevicePointer() : 0);
+
+    // the checksum the kernel takes is of the positions before they are
+    // projected, so it goes in the spare slot and the displacement of r0 it
+    // leaves is checked against the projected positions before being reused
+    CUdeviceptr checksum = checksums->getDevicePointer() + sizeof(unsigned long long);
+    void* args[] = {
+        &cu.getPosq().getDevicePointer(),
+        &posqCorrection,
+        &cu.getVelm().getDevicePointer(),
+        &numConstraintAtoms,
+        &r0,
+        &stepSizeFloat,
+        &constraintAtoms->getDevicePointer(),
+        &activeConstraintWeights,
+        &displacement->getDevicePointer(),
+        &constraintForce->getDevicePointer(),
+        &checksum };
+    cu.executeKernel(applyConstraintKernel, args, 1024, 1024, 1024 * sizeof(float));
+    hasChecksum = false;
+}
+
+double CudaCalcOneDimComForceKernel::getConstraintForce(ContextImpl& context) {
+    if (numAtoms == 0)
+        return 0.0;
+    cu.setAsCurrent();
+    float h_constraintForce;
+    constraintForce->download(&h_constraintForce);
+    return h_constraintForce;
+}
+
+void CudaCalcOneDimComForceKernel::copyParametersToContext(ContextImpl& context, const OneDimComForce& force) {
+    cu.setAsCurrent();
+    setupIndicesAndWeights(force);
+    if (numAtoms == 0)
+        return;
+
+    // sets may have been added since the last time
+    if (weights->getSize() != h_weights.size()) {
+        delete weights;
+        weights = NULL;
+        weights = CudaArray::create<float>(cu, h_weights.size(), "weights");
+    }
+    if (constraintWeights->getSize() != h_constraintWeights.size()) {
+        delete constraintWeights;
+        constraintWeights = NULL;
+        constraintWeights = CudaArray::create<float>(cu, h_constraintWeights.size(), "constraintWeights");
+    }
+    if (constraintAtoms->getSize() != numConstraintAtoms) {
+        delete constraintAtoms;
+        constraintAtoms = NULL;
+        constraintAtoms = CudaArray::create<int>(cu, numConstraintAtoms, "constraintAtoms");
+    }
+    if (publishedConstraintWeights != NULL && publishedConstraintWeights->getSize() != numConstraintAtoms) {
+        delete publishedConstraintWeights;
+        publishedConstraintWeights = NULL;
+    }
+    indices->upload(h_indices);
+    weights->upload(h_weights);
+    constraintAtoms->upload(h_constraintAtoms);
+    constraintWeights->upload(h_constraintWeights);
+    setActiveParameterSet(context, activeSet);
+    registerGroups(force);
+    setupThresholds(force);
+    setupVariance(force);
+
+    cu.invalidateMolecules();
+}
+
+CudaCalcOneDimComCombinationForceKernel::CudaCalcOneDimComCombinationForceKernel(std::string name, const OpenMM::Platform& platform, OpenMM::CudaContext& cu, const OpenMM::System& system) :
+            CalcOneDimComCombinationForceKernel(name, platform), module(NULL), numAtoms(0), forceConst(0.0), r0(0.0), indices(NULL),
+            weights(NULL), displacement(NULL), cu(cu), system(system)
+{
+    if (cu.getUseDoublePrecision()) {
+        throw OpenMMException("OneDimComCombinationForce does not support double precision");
+    }
+}
+
+CudaCalcOneDimComCombinationForceKernel::~CudaCalcOneDimComCombinationForceKernel() {
+    cu.setAsCurrent();
+    if (module != NULL)
+        CudaOneDimComModuleCache::releaseModule(cu, module);
+    if (indices != NULL)
+        delete indices;
+    if (weights != NULL)
+        delete weights;
+    if (displacement != NULL)
+        delete displacement;
+}
+
+void CudaCalcOneDimComCombinationForceKernel::setupIndicesAndWeights(const OneDimComCombinationForce& force) {
+    OneDimComReduction reduction(force);
+    h_indices = reduction.getIndices();
+    h_weights = reduction.getWeights();
+}
+
+void CudaCalcOneDimComCombinationForceKernel::initialize(const System& system, const OneDimComCombinationForce& force) {
+    cu.setAsCurrent();
+
     setupIndicesAndWeights(force);
     forceConst = force.getForceConst();
     r0 = force.getR0();
 
-    numAtoms = force.getGroup1Indices().size() + force.getGroup2Indices().size();
+    numAtoms = h_indices.size();
     if (numAtoms == 0)
         return;
 
     indices = CudaArray::create<int>(cu, numAtoms, "indices");
     weights = CudaArray::create<float>(cu, numAtoms, "weights");
+    displacement = CudaArray::create<float>(cu, 1, "displacement");
 
     indices->upload(h_indices);
     weights->upload(h_weights);
 
+    // the combination is just another signed weighted sum, so it reuses the
+    // OneDimComForce kernel, and module, unchanged
     map<string, string> replacements;
     map<string, string> defines;
-    defines["NUM_ATOMS"] = cu.intToString(cu.getNumAtoms());
-    defines["PADDED_NUM_ATOMS"] = cu.intToString(cu.getPaddedNumAtoms());
-    CUmodule module = cu.createModule(cu.replaceStrings(CudaOneDimComKernelSources::vectorOps + CudaOneDimComKernelSources::computeOneDimComForce, replacements), defines);
+    module = CudaOneDimComModuleCache::getModule(cu, cu.replaceStrings(CudaOneDimComKernelSources::vectorOps + CudaOneDimComKernelSources::computeOneDimComForce, replacements), defines);
     computeForceKernel = cu.getKernel(module, "computeOneDimComForce");
 }
 
-double CudaCalcOneDimComForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+double CudaCalcOneDimComCombinationForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    if (numAtoms == 0)
+        return 0.0;
     void* args[] = {
         &cu.getPosq().getDevicePointer(),
         &numAtoms,
@@ -86,24 +905,317 @@ double CudaCalcOneDimComForceKernel::execute(ContextImpl& context, bool includeF
         &indices->getDevicePointer(),
         &weights->getDevicePointer(),
         &cu.getForce().getDevicePointer(),
-        &cu.getEnergyBuffer().getDevicePointer() };
-
-    // we run with a fixed thread count and block size to ensure
-    // that we always run this kernel as a single thread block.
-    // All devices of compute capability 2.0 or higher support
-    // 1024 threads in a single thread block
+        &cu.getEnergyBuffer().getDevicePointer(),
+        &displacement->getDevicePointer() };
     cu.executeKernel(computeForceKernel, args, 1024, 1024, 1024 * sizeof(float));
     return 0.0;
 }
 
-void CudaCalcOneDimComForceKernel::copyParametersToContext(ContextImpl& context, const OneDimComForce& force) {
+void CudaCalcOneDimComCombinationForceKernel::copyParametersToContext(ContextImpl& context, const OneDimComCombinationForce& force) {
     cu.setAsCurrent();
     setupIndicesAndWeights(force);
+    if (h_indices.size() != numAtoms)
+        throw OpenMMException("updateParametersInContext: The number of atoms in the groups has changed");
     forceConst = force.getForceConst();
     r0 = force.getR0();
 
+    if (numAtoms == 0)
+        return;
     indices->upload(h_indices);
     weights->upload(h_weights);
 
     cu.invalidateMolecules();
 }
+
+CudaCalcOneDimComRegionForceKernel::CudaCalcOneDimComRegionForceKernel(std::string name, const OpenMM::Platform& platform, OpenMM::CudaContext& cu, const OpenMM::System& system) :
+            CalcOneDimComRegionForceKernel(name, platform), cu(cu), system(system), module(NULL), numGroup1(0), numCandidates(0),
+            lower(0.0), upper(0.0), switchWidth(0.0), skin(0.0), forceConst(0.0), r0(0.0), fadeMass(0.0), group1Indices(NULL), group1Weights(NULL),
+            candidates(NULL), candidateMasses(NULL), activeCandidates(NULL), activeCount(NULL), refreshPositions(NULL)
+{
+    if (cu.getUseDoublePrecision()) {
+        throw OpenMMException("OneDimComRegionForce does not support double precision");
+    }
+}
+
+CudaCalcOneDimComRegionForceKernel::~CudaCalcOneDimComRegionForceKernel() {
+    cu.setAsCurrent();
+    if (module != NULL)
+        CudaOneDimComModuleCache::releaseModule(cu, module);
+    if (group1Indices != NULL)
+        delete group1Indices;
+    if (group1Weights != NULL)
+        delete group1Weights;
+    if (candidates != NULL)
+        delete candidates;
+    if (candidateMasses != NULL)
+        delete candidateMasses;
+    if (activeCandidates != NULL)
+        delete activeCandidates;
+    if (activeCount != NULL)
+        delete activeCount;
+    if (refreshPositions != NULL)
+        delete refreshPositions;
+}
+
+void CudaCalcOneDimComRegionForceKernel::setParameters(const OneDimComRegionForce& force) {
+    lower = force.getLower();
+    upper = force.getUpper();
+    switchWidth = force.getSwitchWidth();
+    skin = force.getSkin();
+    forceConst = force.getForceConst();
+    r0 = force.getR0();
+}
+
+void CudaCalcOneDimComRegionForceKernel::initialize(const System& system, const OneDimComRegionForce& force) {
+    cu.setAsCurrent();
+    setParameters(force);
+
+    numGroup1 = force.getGroup1Indices().size();
+    numCandidates = force.getCandidates().size();
+    if (numGroup1 == 0 || numCandidates == 0)
+        return;
+
+    group1Indices = CudaArray::create<int>(cu, numGroup1, "group1Indices");
+    group1Weights = CudaArray::create<float>(cu, numGroup1, "group1Weights");
+    candidates = CudaArray::create<int>(cu, numCandidates, "candidates");
+    candidateMasses = CudaArray::create<float>(cu, numCandidates, "candidateMasses");
+    activeCandidates = CudaArray::create<int>(cu, numCandidates, "activeCandidates");
+    activeCount = CudaArray::create<int>(cu, 1, "activeCount");
+    refreshPositions = CudaArray::create<float>(cu, numCandidates, "refreshPositions");
+
+    vector<float> h_masses(numCandidates);
+    for (int i=0; i<numCandidates; ++i) {
+        h_masses[i] = system.getParticleMass(force.getCandidates()[i]);
+        if (h_masses[i] > 0.0f && (fadeMass == 0.0f || h_masses[i] < fadeMass))
+            fadeMass = h_masses[i];
+    }
+    group1Indices->upload(force.getGroup1Indices());
+    group1Weights->upload(force.getGroup1Weights());
+    candidates->upload(force.getCandidates());
+    candidateMasses->upload(h_masses);
+    int zero = 0;
+    activeCount->upload(&zero);
+
+    map<string, string> replacements;
+    map<string, string> defines;
+    module = CudaOneDimComModuleCache::getModule(cu, cu.replaceStrings(CudaOneDimComKernelSources::vectorOps + CudaOneDimComKernelSources::computeOneDimComRegionForce, replacements), defines);
+    refreshKernel = cu.getKernel(module, "refreshOneDimComRegion");
+    computeForceKernel = cu.getKernel(module, "computeOneDimComRegionForce");
+}
+
+void CudaCalcOneDimComRegionForceKernel::refreshRegion(ContextImpl& context, bool force) {
+    if (numGroup1 == 0 || numCandidates == 0)
+        return;
+
+    // the list and the decision whether to rebuild it both stay on the
+    // device, so there is no need to wait for either
+    float lowerCutoff = lower - switchWidth - skin;
+    float upperCutoff = upper + switchWidth + skin;
+    float maxDisplacement = 0.5f*skin;
+    int forceRefresh = (force ? 1 : 0);
+    void* args[] = {
+        &cu.getPosq().getDevicePointer(),
+        &numCandidates,
+        &candidates->getDevicePointer(),
+        &lowerCutoff,
+        &upperCutoff,
+        &maxDisplacement,
+        &forceRefresh,
+        &refreshPositions->getDevicePointer(),
+        &activeCandidates->getDevicePointer(),
+        &activeCount->getDevicePointer() };
+    cu.executeKernel(refreshKernel, args, 1024, 1024);
+}
+
+double CudaCalcOneDimComRegionForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    if (numGroup1 == 0 || numCandidates == 0)
+        return 0.0;
+    void* args[] = {
+        &cu.getPosq().getDevicePointer(),
+        &numGroup1,
+        &group1Indices->getDevicePointer(),
+        &group1Weights->getDevicePointer(),
+        &candidates->getDevicePointer(),
+        &candidateMasses->getDevicePointer(),
+        &activeCandidates->getDevicePointer(),
+        &activeCount->getDevicePointer(),
+        &lower,
+        &upper,
+        &switchWidth,
+        &fadeMass,
+        &forceConst,
+        &r0,
+        &cu.getForce().getDevicePointer(),
+        &cu.getEnergyBuffer().getDevicePointer() };
+    cu.executeKernel(computeForceKernel, args, 1024, 1024, 3 * 1024 * sizeof(float));
+    return 0.0;
+}
+
+void CudaCalcOneDimComRegionForceKernel::copyParametersToContext(ContextImpl& context, const OneDimComRegionForce& force) {
+    cu.setAsCurrent();
+    if (force.getGroup1Indices().size() != numGroup1 || force.getCandidates().size() != numCandidates)
+        throw OpenMMException("updateParametersInContext: The number of atoms in the groups has changed");
+    setParameters(force);
+    if (numGroup1 == 0 || numCandidates == 0)
+        return;
+    group1Weights->upload(force.getGroup1Weights());
+}
+
+CudaCalcOneDimComPairwiseForceKernel::CudaCalcOneDimComPairwiseForceKernel(std::string name, const OpenMM::Platform& platform, OpenMM::CudaContext& cu, const OpenMM::System& system) :
+            CalcOneDimComPairwiseForceKernel(name, platform), cu(cu), system(system), module(NULL), numGroups(0), numPairs(0), numAtoms(0),
+            groupStarts(NULL), atoms(NULL), weights(NULL), atomGroups(NULL), centers(NULL), centerForces(NULL),
+            pairGroup1(NULL), pairGroup2(NULL), pairForceConst(NULL), pairR0(NULL), pairTypes(NULL)
+{
+    if (cu.getUseDoublePrecision()) {
+        throw OpenMMException("OneDimComPairwiseForce does not support double precision");
+    }
+}
+
+CudaCalcOneDimComPairwiseForceKernel::~CudaCalcOneDimComPairwiseForceKernel() {
+    cu.setAsCurrent();
+    if (module != NULL)
+        CudaOneDimComModuleCache::releaseModule(cu, module);
+    CudaArray* arrays[] = {groupStarts, atoms, weights, atomGroups, centers, centerForces, pairGroup1, pairGroup2, pairForceConst, pairR0, pairTypes};
+    for (int i=0; i<11; ++i)
+        if (arrays[i] != NULL)
+            delete arrays[i];
+}
+
+void CudaCalcOneDimComPairwiseForceKernel::uploadGroups(const OneDimComPairwiseForce& force) {
+    vector<int> h_groupStarts(1, 0);
+    vector<int> h_atoms;
+    vector<float> h_weights;
+    vector<int> h_atomGroups;
+    for (int i=0; i<numGroups; ++i) {
+        h_atoms.insert(h_atoms.end(), force.getGroupIndices(i).begin(), force.getGroupIndices(i).end());
+        h_weights.insert(h_weights.end(), force.getGroupWeights(i).begin(), force.getGroupWeights(i).end());
+        h_atomGroups.resize(h_atoms.size(), i);
+        h_groupStarts.push_back(h_atoms.size());
+    }
+    groupStarts->upload(h_groupStarts);
+    atoms->upload(h_atoms);
+    weights->upload(h_weights);
+    atomGroups->upload(h_atomGroups);
+}
+
+void CudaCalcOneDimComPairwiseForceKernel::uploadPairs(const OneDimComPairwiseForce& force) {
+    // pairs may be added after the context is created, so the arrays grow as needed
+    if (force.getNumPairs() != numPairs) {
+        CudaArray** arrays[] = {&pairGroup1, &pairGroup2, &pairForceConst, &pairR0, &pairTypes};
+        for (int i=0; i<5; ++i) {
+            if (*arrays[i] != NULL)
+                delete *arrays[i];
+            *arrays[i] = NULL;
+        }
+        numPairs = force.getNumPairs();
+        if (numPairs == 0)
+            return;
+        pairGroup1 = CudaArray::create<int>(cu, numPairs, "pairGroup1");
+        pairGroup2 = CudaArray::create<int>(cu, numPairs, "pairGroup2");
+        pairForceConst = CudaArray::create<float>(cu, numPairs, "pairForceConst");
+        pairR0 = CudaArray::create<float>(cu, numPairs, "pairR0");
+        pairTypes = CudaArray::create<int>(cu, numPairs, "pairTypes");
+    }
+    if (numPairs == 0)
+        return;
+    vector<int> h_group1(numPairs), h_group2(numPairs), h_types(numPairs);
+    vector<float> h_forceConst(numPairs), h_r0(numPairs);
+    for (int i=0; i<numPairs; ++i) {
+        OneDimComPairwiseForce::PairType type;
+        force.getPairParameters(i, h_group1[i], h_group2[i], h_forceConst[i], h_r0[i], type);
+        h_types[i] = type;
+    }
+    pairGroup1->upload(h_group1);
+    pairGroup2->upload(h_group2);
+    pairForceConst->upload(h_forceConst);
+    pairR0->upload(h_r0);
+    pairTypes->upload(h_types);
+}
+
+void CudaCalcOneDimComPairwiseForceKernel::initialize(const System& system, const OneDimComPairwiseForce& force) {
+    cu.setAsCurrent();
+
+    numGroups = force.getNumGroups();
+    h_groupSizes.resize(numGroups);
+    for (int i=0; i<numGroups; ++i) {
+        h_groupSizes[i] = force.getGroupIndices(i).size();
+        numAtoms += h_groupSizes[i];
+    }
+    uploadPairs(force);
+    if (numAtoms == 0)
+        return;
+
+    groupStarts = CudaArray::create<int>(cu, numGroups+1, "groupStarts");
+    atoms = CudaArray::create<int>(cu, numAtoms, "atoms");
+    weights = CudaArray::create<float>(cu, numAtoms, "weights");
+    atomGroups = CudaArray::create<int>(cu, numAtoms, "atomGroups");
+    centers = CudaArray::create<float>(cu, numGroups, "centers");
+    centerForces = CudaArray::create<float>(cu, numGroups, "centerForces");
+    uploadGroups(force);
+
+    // the groups are reduced by the same kernel CudaOneDimComGatherRegistry uses
+    // for OneDimComForce, so every group is read once whatever the number of pairs
+    map<string, string> replacements;
+    map<string, string> defines;
+    module = CudaOneDimComModuleCache::getModule(cu, cu.replaceStrings(CudaOneDimComKernelSources::vectorOps + CudaOneDimComKernelSources::gatherOneDimComGroups
+            + CudaOneDimComKernelSources::computeOneDimComPairwiseForce, replacements), defines);
+    gatherKernel = cu.getKernel(module, "gatherOneDimComGroups");
+    pairKernel = cu.getKernel(module, "computeOneDimComPairForces");
+    applyKernel = cu.getKernel(module, "applyOneDimComPairwiseForce");
+}
+
+double CudaCalcOneDimComPairwiseForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    if (numAtoms == 0 || numPairs == 0 || (!includeForces && !includeEnergy))
+        return 0.0;
+    int forceFlag = (includeForces ? 1 : 0);
+    int energyFlag = (includeEnergy ? 1 : 0);
+    void* gatherArgs[] = {
+        &cu.getPosq().getDevicePointer(),
+        &numGroups,
+        &groupStarts->getDevicePointer(),
+        &atoms->getDevicePointer(),
+        &weights->getDevicePointer(),
+        &centers->getDevicePointer() };
+    cu.executeKernel(gatherKernel, gatherArgs, numGroups*256, 256, 256 * sizeof(float));
+    void* pairArgs[] = {
+        &centers->getDevicePointer(),
+        &numGroups,
+        &numPairs,
+        &forceFlag,
+        &energyFlag,
+        &pairGroup1->getDevicePointer(),
+        &pairGroup2->getDevicePointer(),
+        &pairForceConst->getDevicePointer(),
+        &pairR0->getDevicePointer(),
+        &pairTypes->getDevicePointer(),
+        &centerForces->getDevicePointer(),
+        &cu.getEnergyBuffer().getDevicePointer() };
+    cu.executeKernel(pairKernel, pairArgs, 1024, 1024, 1024 * sizeof(float));
+    if (includeForces) {
+        void* applyArgs[] = {
+            &numAtoms,
+            &atoms->getDevicePointer(),
+            &weights->getDevicePointer(),
+            &atomGroups->getDevicePointer(),
+            &centerForces->getDevicePointer(),
+            &cu.getForce().getDevicePointer() };
+        cu.executeKernel(applyKernel, applyArgs, numAtoms);
+    }
+    return 0.0;
+}
+
+void CudaCalcOneDimComPairwiseForceKernel::copyParametersToContext(ContextImpl& context, const OneDimComPairwiseForce& force) {
+    cu.setAsCurrent();
+    if (force.getNumGroups() != numGroups)
+        throw OpenMMException("updateParametersInContext: The number of groups has changed");
+    for (int i=0; i<numGroups; ++i)
+        if (force.getGroupIndices(i).size() != h_groupSizes[i])
+            throw OpenMMException("updateParametersInContext: The number of atoms in the groups has changed");
+    uploadPairs(force);
+
+    if (numAtoms == 0)
+        return;
+    uploadGroups(force);
+
+    cu.invalidateMolecules();
+}
@@ -7,6 +7,8 @@
 
 namespace OneDimComPlugin {
 
+class CudaOneDimComGatherRegistry;
+
 /**
  * This kernel is invoked by OneDimComForce to calculate the forces acting on the system and the energy of the system.
  */
@@ -31,6 +33,160 @@ public:
      * @return the potential energy due to the force
      */
     double execute(OpenMM::ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Execute the kernel reusing the displacement kept by the most recent evaluation.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double executeCached(OpenMM::ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Execute the kernel with the displacement itself as the energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param reduce         true if the displacement should be computed from the current positions
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double executeCollectiveVariable(OpenMM::ContextImpl& context, bool reduce, bool includeForces, bool includeEnergy);
+    /**
+     * Execute the kernel for a force that is only evaluated every few steps.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param reduce         true if the displacement should be computed from the current positions and kept
+     * @param forceScale     the factor to multiply the forces by, or 0 to apply none
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double executeStride(OpenMM::ContextImpl& context, bool reduce, double forceScale, bool includeEnergy);
+    /**
+     * Get the displacement computed by the most recent call to execute().
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    double getDisplacement(OpenMM::ContextImpl& context);
+    /**
+     * Compute the displacement for the current positions without applying any forces or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @return the displacement
+     */
+    double computeDisplacement(OpenMM::ContextImpl& context);
+    /**
+     * Make sure the kept displacement belongs to the current positions, computing it
+     * again only if the checksum of the group coordinates has changed.
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    void refreshDisplacement(OpenMM::ContextImpl& context);
+    /**
+     * Project the group atoms so the displacement is exactly r0.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param stepSize       the size of the step that produced the current positions
+     */
+    void applyConstraint(OpenMM::ContextImpl& context, double stepSize);
+    /**
+     * Get the constraint force from the most recent call to applyConstraint().
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    double getConstraintForce(OpenMM::ContextImpl& context);
+    /**
+     * Get a description of the strategy chosen for reducing the groups.
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    std::string getExecutionStrategy(OpenMM::ContextImpl& context);
+    /**
+     * Switch to another parameter set.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param index          the index of the set to use
+     */
+    void setActiveParameterSet(OpenMM::ContextImpl& context, int index);
+    /**
+     * Override the force constant and r0 of the active set.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param k              the force constant to use
+     * @param r0             the equilibrium displacement to use
+     * @param doesWork       true if the change should be counted as work
+     */
+    void setScheduledParameters(OpenMM::ContextImpl& context, double k, double r0, bool doesWork);
+    /**
+     * Override the parameters of the active set with published ones, leaving the set
+     * itself unchanged.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param k              the force constant to use
+     * @param r0             the equilibrium displacement to use
+     * @param weights1       the weights of the group 1 atoms, or an empty vector to keep them
+     * @param weights2       the weights of the group 2 atoms, or an empty vector to keep them
+     */
+    void setPublishedParameters(OpenMM::ContextImpl& context, double k, double r0,
+            const std::vector<float>& weights1, const std::vector<float>& weights2);
+    /**
+     * Get the work accumulated from changes in the parameters.
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    double getWork(OpenMM::ContextImpl& context);
+    /**
+     * Get the variance of the restrained group from the last evaluation.
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    double getVariance(OpenMM::ContextImpl& context);
+    /**
+     * Start copying the displacement and variance of the last evaluation to the host.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param reduce         true if the displacement should first be computed from the current positions
+     */
+    void recordDisplacement(OpenMM::ContextImpl& context, bool reduce);
+    /**
+     * Collect the oldest displacement and variance started by recordDisplacement().
+     *
+     * @param context        the context in which to execute this kernel
+     * @param wait           true to wait for the copy to finish
+     * @param displacement   on exit, the recorded displacement
+     * @param variance       on exit, the recorded variance
+     * @return true if a displacement was collected
+     */
+    bool getRecordedDisplacement(OpenMM::ContextImpl& context, bool wait, double& displacement, double& variance);
+    /**
+     * Set the accumulated work to 0.
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    void resetWork(OpenMM::ContextImpl& context);
+    /**
+     * Record the first threshold crossed since the last evaluation.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param step           the step of the last evaluation
+     */
+    void checkThresholds(OpenMM::ContextImpl& context, long long step);
+    /**
+     * Get the recorded threshold crossing.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param threshold      on exit, the index of the threshold that was crossed
+     * @param step           on exit, the step it was crossed on
+     * @param direction      on exit, the direction it was crossed in
+     * @return true if a crossing was recorded
+     */
+    bool getThresholdEvent(OpenMM::ContextImpl& context, int& threshold, long long& step, int& direction);
+    /**
+     * Clear the recorded crossing.
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    void resetThresholdEvent(OpenMM::ContextImpl& context);
     /**
      * Copy changed parameters over to a context.
      *
@@ -39,20 +195,271 @@ public:
      */
     void copyParametersToContext(OpenMM::ContextImpl& context, const OneDimComForce& force);
 private:
+    CUmodule module;
+    // the kernels that apply the restraint come in variants that compute
+    // both forces and energy, the forces only, and the energy only
     CUfunction computeForceKernel;
+    CUfunction computeForceOnlyKernel;
+    CUfunction computeEnergyKernel;
+    CUfunction applyCachedForceKernel;
+    CUfunction applyCachedForceOnlyKernel;
+    CUfunction applyCachedEnergyKernel;
+    CUfunction computeDisplacementKernel;
+    CUfunction applyConstraintKernel;
+    CUfunction partialDisplacementKernel;
+    CUfunction finishDisplacementKernel;
+    CUfunction applyCollectiveVariableKernel;
+    CUfunction applyStrideKernel;
+    CUfunction accumulateWorkKernel;
+    CUfunction checkThresholdsKernel;
+    CUfunction computeMomentsKernel;
+    CUfunction applyMomentForceKernel;
+    CUfunction refreshDisplacementKernel;
     void setupIndicesAndWeights(const OneDimComForce& force);
+    void setupThresholds(const OneDimComForce& force);
+    void setupVariance(const OneDimComForce& force);
+    void computeMoments();
+    void applyMomentForce(bool includeForces, bool includeEnergy);
+    void chooseStrategy();
+    void reduceDisplacement(OpenMM::CudaArray* target);
+    void registerGroups(const OneDimComForce& force);
+    void accumulateWork();
     int numAtoms;
     float forceConst;
     float r0;
     std::vector<int> h_indices;
     OpenMM::CudaArray* indices;
+    // the weights of every parameter set, and the active set's part of them
     std::vector<float> h_weights;
     OpenMM::CudaArray* weights;
+    CUdeviceptr activeWeights;
+    // published weights, which activeWeights points to until the set is
+    // switched or the parameters are copied again
+    OpenMM::CudaArray* publishedWeights;
+    std::vector<float> h_forceConsts, h_r0s;
+    int activeSet;
+    OpenMM::CudaArray* displacement;
+    // the displacement of the current positions when it differs from the
+    // one forces are computed from
+    OpenMM::CudaArray* currentDisplacement;
+    OpenMM::CudaArray* constraintForce;
+    // the distinct atoms the constraint moves, with the combined weights of
+    // an atom in both groups for every parameter set, the published ones,
+    // and the active ones
+    int numConstraintAtoms;
+    std::vector<int> h_constraintAtoms;
+    std::vector<float> h_constraintWeights;
+    OpenMM::CudaArray* constraintAtoms;
+    OpenMM::CudaArray* constraintWeights;
+    OpenMM::CudaArray* publishedConstraintWeights;
+    CUdeviceptr activeConstraintWeights;
+    // the work done by changing the parameters, and the parameters of the
+    // previous evaluation it is measured from
+    OpenMM::CudaArray* work;
+    bool hasWorkParameters;
+    float workForceConst, workR0;
+    // the thresholds, the first crossing of one (whether there was one, the
+    // threshold, step and direction, then whether lastDisplacement is set,
+    // all as long long so the step isn't truncated),
+    // and the displacement of the previous evaluation
+    int numThresholds;
+    OpenMM::CudaArray* thresholds;
+    OpenMM::CudaArray* thresholdEvent;
+    OpenMM::CudaArray* lastDisplacement;
+    // the range of indices whose variance is restrained, which is empty when
+    // there is no variance restraint, and the origin, mean and variance of
+    // the last evaluation
+    int varianceStart, varianceEnd;
+    float varianceForceConst, variance0;
+    OpenMM::CudaArray* moments;
+    // the checksum of the group coordinates the kept displacement was computed
+    // from, and a spare slot for reductions that aren't kept, with whether the
+    // first one is valid and the partial checksums of a multi-block reduction
+    OpenMM::CudaArray* checksums;
+    OpenMM::CudaArray* partialChecksums;
+    bool hasChecksum;
+    // a ring of pinned host slots that recorded displacements and variances
+    // are copied into, with an event marking the end of each copy, and the
+    // oldest slot and number of slots waiting to be collected
+    float* recordBuffer;
+    std::vector<CUevent> recordEvents;
+    int firstRecord, numRecords;
+    OpenMM::CudaArray* partialSums;
+    // the reduction runs as numBlocks blocks of numThreads threads
+    int numBlocks, numThreads;
+    // the registry this force shares its groups through, if it has a handle
+    CudaOneDimComGatherRegistry* gatherRegistry;
+    int gatherHandle;
     bool hasInitializedKernel;
     OpenMM::CudaContext& cu;
     const OpenMM::System& system;
 };
 
+/**
+ * This kernel is invoked by OneDimComCombinationForce to calculate the forces acting on the system and the energy of the system.
+ */
+class CudaCalcOneDimComCombinationForceKernel : public CalcOneDimComCombinationForceKernel {
+public:
+    CudaCalcOneDimComCombinationForceKernel(std::string name, const OpenMM::Platform& platform, OpenMM::CudaContext& cu, const OpenMM::System& system);
+
+    ~CudaCalcOneDimComCombinationForceKernel();
+    /**
+     * Initialize the kernel.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param force      the OneDimComCombinationForce this kernel will be used for
+     */
+    void initialize(const OpenMM::System& system, const OneDimComCombinationForce& force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(OpenMM::ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the OneDimComCombinationForce to copy the parameters from
+     */
+    void copyParametersToContext(OpenMM::ContextImpl& context, const OneDimComCombinationForce& force);
+private:
+    CUmodule module;
+    CUfunction computeForceKernel;
+    void setupIndicesAndWeights(const OneDimComCombinationForce& force);
+    int numAtoms;
+    float forceConst;
+    float r0;
+    std::vector<int> h_indices;
+    OpenMM::CudaArray* indices;
+    std::vector<float> h_weights;
+    OpenMM::CudaArray* weights;
+    OpenMM::CudaArray* displacement;
+    OpenMM::CudaContext& cu;
+    const OpenMM::System& system;
+};
+
+/**
+ * This kernel is invoked by OneDimComRegionForce to calculate the forces acting on the system and the energy of the system.
+ */
+class CudaCalcOneDimComRegionForceKernel : public CalcOneDimComRegionForceKernel {
+public:
+    CudaCalcOneDimComRegionForceKernel(std::string name, const OpenMM::Platform& platform, OpenMM::CudaContext& cu, const OpenMM::System& system);
+
+    ~CudaCalcOneDimComRegionForceKernel();
+    /**
+     * Initialize the kernel.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param force      the OneDimComRegionForce this kernel will be used for
+     */
+    void initialize(const OpenMM::System& system, const OneDimComRegionForce& force);
+    /**
+     * Rebuild the list of candidate atoms close enough to the region to be evaluated,
+     * if asked to or if any candidate has moved further than half the skin since the
+     * list was last built.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param force          true if the list must be rebuilt regardless of how far the candidates have moved
+     */
+    void refreshRegion(OpenMM::ContextImpl& context, bool force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(OpenMM::ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the OneDimComRegionForce to copy the parameters from
+     */
+    void copyParametersToContext(OpenMM::ContextImpl& context, const OneDimComRegionForce& force);
+private:
+    void setParameters(const OneDimComRegionForce& force);
+    OpenMM::CudaContext& cu;
+    const OpenMM::System& system;
+    CUmodule module;
+    CUfunction refreshKernel;
+    CUfunction computeForceKernel;
+    int numGroup1;
+    int numCandidates;
+    float lower, upper, switchWidth, skin;
+    float forceConst;
+    float r0;
+    // the switched mass below which the restraint is faded out, which is
+    // that of the lightest candidate
+    float fadeMass;
+    OpenMM::CudaArray* group1Indices;
+    OpenMM::CudaArray* group1Weights;
+    OpenMM::CudaArray* candidates;
+    OpenMM::CudaArray* candidateMasses;
+    OpenMM::CudaArray* activeCandidates;
+    OpenMM::CudaArray* activeCount;
+    // the position of each candidate when the active list was last built
+    OpenMM::CudaArray* refreshPositions;
+};
+
+/**
+ * This kernel is invoked by OneDimComPairwiseForce to calculate the forces acting on the system and the energy of the system.
+ */
+class CudaCalcOneDimComPairwiseForceKernel : public CalcOneDimComPairwiseForceKernel {
+public:
+    CudaCalcOneDimComPairwiseForceKernel(std::string name, const OpenMM::Platform& platform, OpenMM::CudaContext& cu, const OpenMM::System& system);
+
+    ~CudaCalcOneDimComPairwiseForceKernel();
+    /**
+     * Initialize the kernel.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param force      the OneDimComPairwiseForce this kernel will be used for
+     */
+    void initialize(const OpenMM::System& system, const OneDimComPairwiseForce& force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(OpenMM::ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the OneDimComPairwiseForce to copy the parameters from
+     */
+    void copyParametersToContext(OpenMM::ContextImpl& context, const OneDimComPairwiseForce& force);
+private:
+    void uploadGroups(const OneDimComPairwiseForce& force);
+    void uploadPairs(const OneDimComPairwiseForce& force);
+    OpenMM::CudaContext& cu;
+    const OpenMM::System& system;
+    CUmodule module;
+    CUfunction gatherKernel, pairKernel, applyKernel;
+    int numGroups, numPairs, numAtoms;
+    std::vector<int> h_groupSizes;
+    OpenMM::CudaArray* groupStarts;
+    OpenMM::CudaArray* atoms;
+    OpenMM::CudaArray* weights;
+    OpenMM::CudaArray* atomGroups;
+    OpenMM::CudaArray* centers;
+    OpenMM::CudaArray* centerForces;
+    OpenMM::CudaArray* pairGroup1;
+    OpenMM::CudaArray* pairGroup2;
+    OpenMM::CudaArray* pairForceConst;
+    OpenMM::CudaArray* pairR0;
+    OpenMM::CudaArray* pairTypes;
+};
+
 } // namespace OneDimComPlugin
 
 #endif /*CUDA_EXAMPLE_KERNELS_H_*/
@@ -0,0 +1,49 @@
+#include "CudaOneDimComModuleCache.h"
+#include <mutex>
+#include <utility>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+namespace {
+
+struct CachedModule {
+    CUmodule module;
+    int references;
+};
+
+// keyed by the context and the source followed by the defines
+map<pair<CudaContext*, string>, CachedModule> modules;
+mutex modulesLock;
+
+}
+
+CUmodule CudaOneDimComModuleCache::getModule(CudaContext& cu, const string& source, const map<string, string>& defines) {
+    string key = source;
+    for (map<string, string>::const_iterator it=defines.begin(); it!=defines.end(); ++it)
+        key += "\n#define "+it->first+" "+it->second;
+    lock_guard<mutex> guard(modulesLock);
+    map<pair<CudaContext*, string>, CachedModule>::iterator cached = modules.find(make_pair(&cu, key));
+    if (cached == modules.end()) {
+        CachedModule entry;
+        entry.module = cu.createModule(source, defines);
+        entry.references = 0;
+        cached = modules.insert(make_pair(make_pair(&cu, key), entry)).first;
+    }
+    cached->second.references++;
+    return cached->second.module;
+}
+
+void CudaOneDimComModuleCache::releaseModule(CudaContext& cu, CUmodule module) {
+    // entries must not outlive the context, since a new one could
+    // later be created at the same address
+    lock_guard<mutex> guard(modulesLock);
+    for (map<pair<CudaContext*, string>, CachedModule>::iterator it=modules.begin(); it!=modules.end(); ++it) {
+        if (it->first.first == &cu && it->second.module == module) {
+            if (--it->second.references == 0)
+                modules.erase(it);
+            return;
+        }
+    }
+}
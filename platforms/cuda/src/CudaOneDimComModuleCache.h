@@ -0,0 +1,39 @@
+#ifndef CUDA_ONEDIMCOM_MODULE_CACHE_H_
+#define CUDA_ONEDIMCOM_MODULE_CACHE_H_
+
+#include "openmm/cuda/CudaContext.h"
+#include <map>
+#include <string>
+
+namespace OneDimComPlugin {
+
+/**
+ * This class shares compiled modules between all of the kernels that use them in a
+ * CudaContext, so each distinct combination of source and defines is only compiled
+ * once per context no matter how many forces use it.  Compiled modules are also
+ * cached on disk across processes by the CudaContext itself (see the
+ * CudaTempDirectory platform property), keyed by a hash of the source and compiler
+ * options, so the defines passed here must only contain values the source actually
+ * uses.  Anything else, like the number of atoms, needlessly splits that cache.
+ */
+class CudaOneDimComModuleCache {
+public:
+    /**
+     * Get a module, compiling it if no other kernel in the context has done so.
+     * Every call must be matched by a call to releaseModule().
+     *
+     * @param cu       the context to compile the module for
+     * @param source   the source code of the module
+     * @param defines  preprocessor definitions to compile it with
+     */
+    static CUmodule getModule(OpenMM::CudaContext& cu, const std::string& source, const std::map<std::string, std::string>& defines);
+    /**
+     * Release a module obtained from getModule().  The module itself stays loaded
+     * until the context is destroyed.
+     */
+    static void releaseModule(OpenMM::CudaContext& cu, CUmodule module);
+};
+
+} // namespace OneDimComPlugin
+
+#endif /*CUDA_ONEDIMCOM_MODULE_CACHE_H_*/
@@ -1,21 +1,44 @@
-extern "C" __global__ void computeOneDimComForce(const real4* __restrict__ posq, int nAtoms, float k, float r0,
+/**
+ * Fold the x coordinate of one entry of the groups into a checksum of the group
+ * coordinates.  The checksum is a sum modulo 2^64, so it doesn't depend on the
+ * order the entries are added in, and each entry is scaled by its own odd factor
+ * so that exchanging two coordinates changes it.
+ */
+inline __device__ unsigned long long checksumOneDimComPosition(float x, int index) {
+    return (unsigned long long) __float_as_uint(x) * (unsigned long long) (2*index+1);
+}
+
+/**
+ * Reduce the signed, weighted positions of the group atoms to the displacement,
+ * and write the checksum of the coordinates it came from to checksumBuffer[0].
+ * This must be called by every thread of a single thread block, and accumulator
+ * must hold one float per thread.
+ */
+inline __device__ float reduceOneDimComDisplacement(const real4* __restrict__ posq, int nAtoms,
                                       const int* __restrict__ indices, const float* __restrict__ weights,
-                                      unsigned long long* __restrict__ forceBuffer, real* __restrict__ energyBuffer) {
-    extern __shared__ float accumulator[];
+                                      float* accumulator, unsigned long long* __restrict__ checksumBuffer) {
+    __shared__ unsigned long long checksum;
 
     // our index
-    // this kernel is only run with a single thread block
+    // this is only run with a single thread block
     int threadIndex = threadIdx.x;
 
     // zero out the accumulator
     accumulator[threadIndex] = 0.0;
+    if (threadIndex == 0)
+        checksum = 0;
+    __syncthreads();
 
     // each thread adds it's values to the accumulator
+    unsigned long long threadChecksum = 0;
     for (int index=threadIndex; index<nAtoms; index+=blockDim.x) {
         // we subtract so that the sign is positive when group2 is to the
         // right of group 1
-        accumulator[threadIndex] -= posq[indices[index]].x * weights[index];
+        float x = posq[indices[index]].x;
+        accumulator[threadIndex] -= x * weights[index];
+        threadChecksum += checksumOneDimComPosition(x, index);
     }
+    atomicAdd(&checksum, threadChecksum);
     __syncthreads();
 
     // now do a parallel reduction to get the weighted displacement
@@ -25,17 +48,471 @@ extern "C" __global__ void computeOneDimComForce(const real4* __restrict__ posq,
         }
         __syncthreads();
     }
+    if (threadIndex == 0)
+        checksumBuffer[0] = checksum;
+    return accumulator[0];
+}
 
-    // compute the energy on thread zero
+/**
+ * Compute the displacement and apply the restraint in a single thread block.  The
+ * flags are known at compile time, so the force-only and energy-only variants
+ * below carry no trace of the work they skip.
+ */
+template <bool includeForces, bool includeEnergy>
+inline __device__ void computeOneDimComForceVariant(const real4* __restrict__ posq, int nAtoms, float k, float r0,
+                                      const int* __restrict__ indices, const float* __restrict__ weights,
+                                      unsigned long long* __restrict__ forceBuffer, real* __restrict__ energyBuffer,
+                                      float* __restrict__ displacementBuffer, unsigned long long* __restrict__ checksumBuffer,
+                                      float* accumulator) {
+    int threadIndex = threadIdx.x;
+    float displacement = reduceOneDimComDisplacement(posq, nAtoms, indices, weights, accumulator, checksumBuffer);
+
+    // compute the energy on thread zero and keep the displacement
+    // around so that later evaluations can reuse it
     if (threadIndex == 0) {
-        energyBuffer[0] += 0.5 * k * (accumulator[0] - r0) * (accumulator[0] - r0);
+        if (includeEnergy)
+            energyBuffer[0] += 0.5 * k * (displacement - r0) * (displacement - r0);
+        displacementBuffer[0] = displacement;
     }
-    __syncthreads();
 
     // compute the forces and store in the buffer
-    float factor = k * (accumulator[0] - r0);
+    if (includeForces) {
+        float factor = k * (displacement - r0);
+        for (int index=threadIndex; index<nAtoms; index+=blockDim.x) {
+            float force = factor * weights[index];
+            atomicAdd(&forceBuffer[indices[index]], static_cast<unsigned long long>((long long)(force*0x100000000)));
+        }
+    }
+}
+
+extern "C" __global__ void computeOneDimComForce(const real4* __restrict__ posq, int nAtoms, float k, float r0,
+                                      const int* __restrict__ indices, const float* __restrict__ weights,
+                                      unsigned long long* __restrict__ forceBuffer, real* __restrict__ energyBuffer,
+                                      float* __restrict__ displacementBuffer, unsigned long long* __restrict__ checksumBuffer) {
+    extern __shared__ float accumulator[];
+    computeOneDimComForceVariant<true, true>(posq, nAtoms, k, r0, indices, weights, forceBuffer, energyBuffer, displacementBuffer, checksumBuffer, accumulator);
+}
+
+extern "C" __global__ void computeOneDimComForceOnly(const real4* __restrict__ posq, int nAtoms, float k, float r0,
+                                      const int* __restrict__ indices, const float* __restrict__ weights,
+                                      unsigned long long* __restrict__ forceBuffer, real* __restrict__ energyBuffer,
+                                      float* __restrict__ displacementBuffer, unsigned long long* __restrict__ checksumBuffer) {
+    extern __shared__ float accumulator[];
+    computeOneDimComForceVariant<true, false>(posq, nAtoms, k, r0, indices, weights, forceBuffer, energyBuffer, displacementBuffer, checksumBuffer, accumulator);
+}
+
+extern "C" __global__ void computeOneDimComEnergy(const real4* __restrict__ posq, int nAtoms, float k, float r0,
+                                      const int* __restrict__ indices, const float* __restrict__ weights,
+                                      unsigned long long* __restrict__ forceBuffer, real* __restrict__ energyBuffer,
+                                      float* __restrict__ displacementBuffer, unsigned long long* __restrict__ checksumBuffer) {
+    extern __shared__ float accumulator[];
+    computeOneDimComForceVariant<false, true>(posq, nAtoms, k, r0, indices, weights, forceBuffer, energyBuffer, displacementBuffer, checksumBuffer, accumulator);
+}
+
+extern "C" __global__ void computeOneDimComDisplacement(const real4* __restrict__ posq, int nAtoms,
+                                      const int* __restrict__ indices, const float* __restrict__ weights,
+                                      float* __restrict__ displacementBuffer, unsigned long long* __restrict__ checksumBuffer) {
+    extern __shared__ float accumulator[];
+    float displacement = reduceOneDimComDisplacement(posq, nAtoms, indices, weights, accumulator, checksumBuffer);
+    if (threadIdx.x == 0) {
+        displacementBuffer[0] = displacement;
+    }
+}
+
+extern "C" __global__ void applyCachedOneDimComForce(int nAtoms, float k, float r0,
+                                      const int* __restrict__ indices, const float* __restrict__ weights,
+                                      unsigned long long* __restrict__ forceBuffer, real* __restrict__ energyBuffer,
+                                      const float* __restrict__ displacementBuffer) {
+    // the displacement is already known, so there is no reduction and
+    // this kernel can be spread over as many blocks as we like
+    float displacement = displacementBuffer[0];
+    if (blockIdx.x == 0 && threadIdx.x == 0) {
+        energyBuffer[0] += 0.5 * k * (displacement - r0) * (displacement - r0);
+    }
+
+    float factor = k * (displacement - r0);
+    for (int index=blockIdx.x*blockDim.x+threadIdx.x; index<nAtoms; index+=blockDim.x*gridDim.x) {
+        float force = factor * weights[index];
+        atomicAdd(&forceBuffer[indices[index]], static_cast<unsigned long long>((long long)(force*0x100000000)));
+    }
+}
+
+extern "C" __global__ void applyCachedOneDimComForceOnly(int nAtoms, float k, float r0,
+                                      const int* __restrict__ indices, const float* __restrict__ weights,
+                                      unsigned long long* __restrict__ forceBuffer, real* __restrict__ energyBuffer,
+                                      const float* __restrict__ displacementBuffer) {
+    float factor = k * (displacementBuffer[0] - r0);
+    for (int index=blockIdx.x*blockDim.x+threadIdx.x; index<nAtoms; index+=blockDim.x*gridDim.x) {
+        float force = factor * weights[index];
+        atomicAdd(&forceBuffer[indices[index]], static_cast<unsigned long long>((long long)(force*0x100000000)));
+    }
+}
+
+/**
+ * The energy alone needs nothing but the displacement, so this is run as a
+ * single thread.
+ */
+extern "C" __global__ void applyCachedOneDimComEnergy(int nAtoms, float k, float r0,
+                                      const int* __restrict__ indices, const float* __restrict__ weights,
+                                      unsigned long long* __restrict__ forceBuffer, real* __restrict__ energyBuffer,
+                                      const float* __restrict__ displacementBuffer) {
+    if (blockIdx.x == 0 && threadIdx.x == 0) {
+        float displacement = displacementBuffer[0];
+        energyBuffer[0] += 0.5 * k * (displacement - r0) * (displacement - r0);
+    }
+}
+
+extern "C" __global__ void applyOneDimComCollectiveVariable(int nAtoms, int includeForces, int includeEnergy,
+                                      const int* __restrict__ indices, const float* __restrict__ weights,
+                                      unsigned long long* __restrict__ forceBuffer, real* __restrict__ energyBuffer,
+                                      const float* __restrict__ displacementBuffer) {
+    // the displacement is the energy, and since it is linear in the
+    // positions the force on each atom is just its signed weight
+    if (includeEnergy && blockIdx.x == 0 && threadIdx.x == 0) {
+        energyBuffer[0] += displacementBuffer[0];
+    }
+    if (!includeForces) {
+        return;
+    }
+    for (int index=blockIdx.x*blockDim.x+threadIdx.x; index<nAtoms; index+=blockDim.x*gridDim.x) {
+        atomicAdd(&forceBuffer[indices[index]], static_cast<unsigned long long>((long long)(weights[index]*0x100000000)));
+    }
+}
+
+extern "C" __global__ void applyOneDimComStrideForce(int nAtoms, float k, float r0, float forceScale, int includeEnergy,
+                                      const int* __restrict__ indices, const float* __restrict__ weights,
+                                      unsigned long long* __restrict__ forceBuffer, real* __restrict__ energyBuffer,
+                                      const float* __restrict__ forceDisplacementBuffer, const float* __restrict__ energyDisplacementBuffer) {
+    // the forces come from the displacement of the last evaluation, while
+    // the energy always belongs to the current positions
+    if (includeEnergy && blockIdx.x == 0 && threadIdx.x == 0) {
+        float displacement = energyDisplacementBuffer[0];
+        energyBuffer[0] += 0.5 * k * (displacement - r0) * (displacement - r0);
+    }
+    if (forceScale == 0.0f)
+        return;
+    float factor = forceScale * k * (forceDisplacementBuffer[0] - r0);
+    for (int index=blockIdx.x*blockDim.x+threadIdx.x; index<nAtoms; index+=blockDim.x*gridDim.x) {
+        float force = factor * weights[index];
+        atomicAdd(&forceBuffer[indices[index]], static_cast<unsigned long long>((long long)(force*0x100000000)));
+    }
+}
+
+extern "C" __global__ void applyOneDimComConstraint(real4* __restrict__ posq, real4* __restrict__ posqCorrection,
+                                      mixed4* __restrict__ velm, int nAtoms, float r0, float stepSize,
+                                      const int* __restrict__ indices, const float* __restrict__ weights,
+                                      float* __restrict__ displacementBuffer, float* __restrict__ constraintForceBuffer,
+                                      unsigned long long* __restrict__ checksumBuffer) {
+    // this is only run with a single thread block, over the distinct atoms of
+    // the groups with their combined weights, so no two threads move the same
+    // atom and the inverse mass sum gets the square of each atom's full weight
+    extern __shared__ float accumulator[];
+    int threadIndex = threadIdx.x;
+
+    // the displacement is linear in the positions, so a single step along
+    // the mass weighted gradient puts it exactly at r0
+    float displacement = reduceOneDimComDisplacement(posq, nAtoms, indices, weights, accumulator, checksumBuffer);
+    accumulator[threadIndex] = 0.0;
     for (int index=threadIndex; index<nAtoms; index+=blockDim.x) {
+        accumulator[threadIndex] += weights[index] * weights[index] * velm[indices[index]].w;
+    }
+    __syncthreads();
+    for (unsigned int stride=blockDim.x/2; stride>0; stride>>=1) {
+        if (threadIndex < stride) {
+            accumulator[threadIndex] += accumulator[threadIndex + stride];
+        }
+        __syncthreads();
+    }
+    float inverseMassSum = accumulator[0];
+    __syncthreads();
+    if (inverseMassSum == 0.0f)
+        return;
+    float lambda = (displacement - r0) / inverseMassSum;
+
+    // move the atoms.  Their velocities need no matching change, since the
+    // projection below removes every velocity along the same direction.
+    for (int index=threadIndex; index<nAtoms; index+=blockDim.x) {
+        int atom = indices[index];
+        mixed delta = lambda * weights[index] * velm[atom].w;
+#ifdef USE_MIXED_PRECISION
+        real4 pos1 = posq[atom];
+        real4 pos2 = posqCorrection[atom];
+        mixed x = (mixed) pos1.x + (mixed) pos2.x + delta;
+        pos1.x = (real) x;
+        pos2.x = (real) (x - (mixed) pos1.x);
+        posq[atom] = pos1;
+        posqCorrection[atom] = pos2;
+#else
+        posq[atom].x += delta;
+#endif
+    }
+    __syncthreads();
+
+    // remove the velocity along the displacement
+    accumulator[threadIndex] = 0.0;
+    for (int index=threadIndex; index<nAtoms; index+=blockDim.x) {
+        accumulator[threadIndex] -= velm[indices[index]].x * weights[index];
+    }
+    __syncthreads();
+    for (unsigned int stride=blockDim.x/2; stride>0; stride>>=1) {
+        if (threadIndex < stride) {
+            accumulator[threadIndex] += accumulator[threadIndex + stride];
+        }
+        __syncthreads();
+    }
+    float mu = accumulator[0] / inverseMassSum;
+    for (int index=threadIndex; index<nAtoms; index+=blockDim.x) {
+        int atom = indices[index];
+        velm[atom].x += mu * weights[index] * velm[atom].w;
+    }
+
+    // the generalized force the constraint exerted along the displacement
+    // over the step that just finished
+    if (threadIndex == 0) {
+        displacementBuffer[0] = r0;
+        constraintForceBuffer[0] = -lambda / (stepSize * stepSize);
+    }
+}
+
+/**
+ * The first pass of the multi-block reduction used for large groups.  Each block
+ * reduces a strided share of the atoms to one partial sum, along with the partial
+ * checksum of their coordinates.
+ */
+extern "C" __global__ void reduceOneDimComPartialDisplacement(const real4* __restrict__ posq, int nAtoms,
+                                      const int* __restrict__ indices, const float* __restrict__ weights,
+                                      float* __restrict__ partialSums, unsigned long long* __restrict__ partialChecksums) {
+    extern __shared__ float accumulator[];
+    __shared__ unsigned long long checksum;
+    int threadIndex = threadIdx.x;
+    accumulator[threadIndex] = 0.0;
+    if (threadIndex == 0)
+        checksum = 0;
+    __syncthreads();
+    unsigned long long threadChecksum = 0;
+    for (int index=blockIdx.x*blockDim.x+threadIndex; index<nAtoms; index+=blockDim.x*gridDim.x) {
+        float x = posq[indices[index]].x;
+        accumulator[threadIndex] -= x * weights[index];
+        threadChecksum += checksumOneDimComPosition(x, index);
+    }
+    atomicAdd(&checksum, threadChecksum);
+    __syncthreads();
+    for (unsigned int stride=blockDim.x/2; stride>0; stride>>=1) {
+        if (threadIndex < stride) {
+            accumulator[threadIndex] += accumulator[threadIndex + stride];
+        }
+        __syncthreads();
+    }
+    if (threadIndex == 0) {
+        partialSums[blockIdx.x] = accumulator[0];
+        partialChecksums[blockIdx.x] = checksum;
+    }
+}
+
+/**
+ * The second pass of the multi-block reduction, which is run as a single block.
+ */
+extern "C" __global__ void finishOneDimComDisplacement(int nPartialSums, const float* __restrict__ partialSums,
+                                      const unsigned long long* __restrict__ partialChecksums,
+                                      float* __restrict__ displacementBuffer, unsigned long long* __restrict__ checksumBuffer) {
+    extern __shared__ float accumulator[];
+    __shared__ unsigned long long checksum;
+    int threadIndex = threadIdx.x;
+    accumulator[threadIndex] = 0.0;
+    if (threadIndex == 0)
+        checksum = 0;
+    __syncthreads();
+    unsigned long long threadChecksum = 0;
+    for (int index=threadIndex; index<nPartialSums; index+=blockDim.x) {
+        accumulator[threadIndex] += partialSums[index];
+        threadChecksum += partialChecksums[index];
+    }
+    atomicAdd(&checksum, threadChecksum);
+    __syncthreads();
+    for (unsigned int stride=blockDim.x/2; stride>0; stride>>=1) {
+        if (threadIndex < stride) {
+            accumulator[threadIndex] += accumulator[threadIndex + stride];
+        }
+        __syncthreads();
+    }
+    if (threadIndex == 0) {
+        displacementBuffer[0] = accumulator[0];
+        checksumBuffer[0] = checksum;
+    }
+}
+
+/**
+ * Add the work done by changing the parameters from (prevK, prevR0) to (k, r0) at
+ * the current displacement.  This is run as a single thread.
+ */
+extern "C" __global__ void accumulateOneDimComWork(float k, float r0, float prevK, float prevR0,
+                                      const float* __restrict__ displacementBuffer, double* __restrict__ workBuffer) {
+    if (blockIdx.x*blockDim.x+threadIdx.x == 0) {
+        double displacement = displacementBuffer[0];
+        double current = displacement - r0;
+        double previous = displacement - prevR0;
+        workBuffer[0] += 0.5 * k * current * current - 0.5 * prevK * previous * previous;
+    }
+}
+
+/**
+ * Record the first threshold that lies between the displacement of the previous
+ * evaluation and this one.  The event holds whether there was a crossing, the
+ * threshold, step and direction, and whether lastDisplacement has been set.  This
+ * is run as a single thread.
+ */
+extern "C" __global__ void checkOneDimComThresholds(int nThresholds, const float* __restrict__ thresholds, long long step,
+                                      const float* __restrict__ displacementBuffer, float* __restrict__ lastDisplacement,
+                                      long long* __restrict__ event) {
+    if (blockIdx.x*blockDim.x+threadIdx.x != 0)
+        return;
+    float current = displacementBuffer[0];
+    if (event[4] != 0 && event[0] == 0) {
+        // of the thresholds crossed, the one nearest the previous displacement
+        // is the one the trajectory passed first
+        float previous = lastDisplacement[0];
+        float nearest = 0.0f;
+        for (int i=0; i<nThresholds; ++i) {
+            float distance = fabsf(thresholds[i]-previous);
+            if ((previous < thresholds[i]) != (current < thresholds[i]) && (event[0] == 0 || distance < nearest)) {
+                event[0] = 1;
+                event[1] = i;
+                event[2] = step;
+                event[3] = (current > previous ? 1 : -1);
+                nearest = distance;
+            }
+        }
+    }
+    event[4] = 1;
+    lastDisplacement[0] = current;
+}
+
+/**
+ * Compute the displacement together with the first and second moments of the
+ * atoms in [varianceStart, varianceEnd), in one pass, and the checksum of the
+ * coordinates they came from.  The moments are taken relative to the first atom
+ * of the range so that their difference keeps its precision.  This must be called
+ * by every thread of a single thread block, and accumulator must hold three floats
+ * per thread.  momentBuffer receives the origin, the mean relative to it, and the
+ * variance.
+ */
+inline __device__ void reduceOneDimComMoments(const real4* __restrict__ posq, int nAtoms, int varianceStart, int varianceEnd,
+                                      const int* __restrict__ indices, const float* __restrict__ weights,
+                                      float* __restrict__ displacementBuffer, float* __restrict__ momentBuffer,
+                                      unsigned long long* __restrict__ checksumBuffer, float* accumulator) {
+    __shared__ unsigned long long checksum;
+    float* firstMoment = accumulator + blockDim.x;
+    float* secondMoment = accumulator + 2*blockDim.x;
+    int threadIndex = threadIdx.x;
+    float origin = posq[indices[varianceStart]].x;
+    accumulator[threadIndex] = 0.0;
+    firstMoment[threadIndex] = 0.0;
+    secondMoment[threadIndex] = 0.0;
+    if (threadIndex == 0)
+        checksum = 0;
+    __syncthreads();
+    unsigned long long threadChecksum = 0;
+    for (int index=threadIndex; index<nAtoms; index+=blockDim.x) {
+        float x = posq[indices[index]].x;
+        accumulator[threadIndex] -= x * weights[index];
+        threadChecksum += checksumOneDimComPosition(x, index);
+        if (index >= varianceStart && index < varianceEnd) {
+            float w = fabsf(weights[index]);
+            firstMoment[threadIndex] += w * (x - origin);
+            secondMoment[threadIndex] += w * (x - origin) * (x - origin);
+        }
+    }
+    atomicAdd(&checksum, threadChecksum);
+    __syncthreads();
+    for (unsigned int stride=blockDim.x/2; stride>0; stride>>=1) {
+        if (threadIndex < stride) {
+            accumulator[threadIndex] += accumulator[threadIndex + stride];
+            firstMoment[threadIndex] += firstMoment[threadIndex + stride];
+            secondMoment[threadIndex] += secondMoment[threadIndex + stride];
+        }
+        __syncthreads();
+    }
+    if (threadIndex == 0) {
+        displacementBuffer[0] = accumulator[0];
+        momentBuffer[0] = origin;
+        momentBuffer[1] = firstMoment[0];
+        momentBuffer[2] = secondMoment[0] - firstMoment[0] * firstMoment[0];
+        checksumBuffer[0] = checksum;
+    }
+}
+
+/**
+ * Compute the displacement and moments as described for reduceOneDimComMoments().
+ * This is run as a single thread block, with three floats of shared memory per
+ * thread.
+ */
+extern "C" __global__ void computeOneDimComMoments(const real4* __restrict__ posq, int nAtoms, int varianceStart, int varianceEnd,
+                                      const int* __restrict__ indices, const float* __restrict__ weights,
+                                      float* __restrict__ displacementBuffer, float* __restrict__ momentBuffer,
+                                      unsigned long long* __restrict__ checksumBuffer) {
+    extern __shared__ float accumulator[];
+    reduceOneDimComMoments(posq, nAtoms, varianceStart, varianceEnd, indices, weights, displacementBuffer, momentBuffer, checksumBuffer, accumulator);
+}
+
+/**
+ * Keep the displacement, and the moments when a variance is restrained, if the
+ * group coordinates still have the checksum they were computed from, and compute
+ * them again otherwise.  When nothing has changed only the indices and coordinates
+ * are read.  This is run as a single thread block, with three floats of shared
+ * memory per thread.
+ */
+extern "C" __global__ void refreshOneDimComDisplacement(const real4* __restrict__ posq, int nAtoms, int varianceStart, int varianceEnd,
+                                      const int* __restrict__ indices, const float* __restrict__ weights,
+                                      float* __restrict__ displacementBuffer, float* __restrict__ momentBuffer,
+                                      unsigned long long* __restrict__ checksumBuffer) {
+    extern __shared__ float accumulator[];
+    __shared__ unsigned long long checksum;
+    int threadIndex = threadIdx.x;
+    if (threadIndex == 0)
+        checksum = 0;
+    __syncthreads();
+    unsigned long long threadChecksum = 0;
+    for (int index=threadIndex; index<nAtoms; index+=blockDim.x)
+        threadChecksum += checksumOneDimComPosition(posq[indices[index]].x, index);
+    atomicAdd(&checksum, threadChecksum);
+    __syncthreads();
+    if (checksum == checksumBuffer[0])
+        return;
+    if (varianceEnd > varianceStart)
+        reduceOneDimComMoments(posq, nAtoms, varianceStart, varianceEnd, indices, weights, displacementBuffer, momentBuffer, checksumBuffer, accumulator);
+    else {
+        float displacement = reduceOneDimComDisplacement(posq, nAtoms, indices, weights, accumulator, checksumBuffer);
+        if (threadIndex == 0)
+            displacementBuffer[0] = displacement;
+    }
+}
+
+/**
+ * Apply the displacement restraint along with the variance restraint, from the
+ * displacement and moments left by computeOneDimComMoments.
+ */
+extern "C" __global__ void applyOneDimComMomentForce(const real4* __restrict__ posq, int nAtoms, float k, float r0,
+                                      int varianceStart, int varianceEnd, float varianceK, float variance0,
+                                      int includeForces, int includeEnergy,
+                                      const int* __restrict__ indices, const float* __restrict__ weights,
+                                      unsigned long long* __restrict__ forceBuffer, real* __restrict__ energyBuffer,
+                                      const float* __restrict__ displacementBuffer, const float* __restrict__ momentBuffer) {
+    float displacement = displacementBuffer[0];
+    float origin = momentBuffer[0];
+    float mean = momentBuffer[1];
+    float variance = momentBuffer[2];
+    if (includeEnergy && blockIdx.x == 0 && threadIdx.x == 0) {
+        energyBuffer[0] += 0.5 * k * (displacement - r0) * (displacement - r0)
+                + 0.5 * varianceK * (variance - variance0) * (variance - variance0);
+    }
+    if (!includeForces)
+        return;
+    float factor = k * (displacement - r0);
+    float varianceFactor = -2.0f * varianceK * (variance - variance0);
+    for (int index=blockIdx.x*blockDim.x+threadIdx.x; index<nAtoms; index+=blockDim.x*gridDim.x) {
         float force = factor * weights[index];
+        if (index >= varianceStart && index < varianceEnd)
+            force += varianceFactor * fabsf(weights[index]) * (posq[indices[index]].x - origin - mean);
         atomicAdd(&forceBuffer[indices[index]], static_cast<unsigned long long>((long long)(force*0x100000000)));
     }
 }
@@ -0,0 +1,65 @@
+/**
+ * Add up the restraints on the pairs, given the centers of the groups from
+ * gatherOneDimComGroups().  This leaves the force on the center of each group in
+ * centerForces.  It is only run with a single thread block, and accumulator must
+ * hold one float per thread.  The center forces are only accumulated when
+ * includeForces is set, and the energy only when includeEnergy is.
+ */
+extern "C" __global__ void computeOneDimComPairForces(const float* __restrict__ centers, int numGroups, int numPairs,
+                                      int includeForces, int includeEnergy,
+                                      const int* __restrict__ pairGroup1, const int* __restrict__ pairGroup2,
+                                      const float* __restrict__ pairForceConst, const float* __restrict__ pairR0,
+                                      const int* __restrict__ pairTypes, float* __restrict__ centerForces,
+                                      real* __restrict__ energyBuffer) {
+    extern __shared__ float accumulator[];
+    int threadIndex = threadIdx.x;
+    for (int group=threadIndex; group<numGroups; group+=blockDim.x) {
+        centerForces[group] = 0.0f;
+    }
+    __syncthreads();
+
+    // the types match OneDimComPairwiseForce::PairType
+    accumulator[threadIndex] = 0.0f;
+    for (int pair=threadIndex; pair<numPairs; pair+=blockDim.x) {
+        int group1 = pairGroup1[pair];
+        int group2 = pairGroup2[pair];
+        float k = pairForceConst[pair];
+        float delta = centers[group2] - centers[group1] - pairR0[pair];
+        if ((pairTypes[pair] == 1 && delta > 0.0f) || (pairTypes[pair] == 2 && delta < 0.0f)) {
+            continue;
+        }
+        accumulator[threadIndex] += 0.5f * k * delta * delta;
+        if (includeForces) {
+            atomicAdd(&centerForces[group1], k * delta);
+            atomicAdd(&centerForces[group2], -k * delta);
+        }
+    }
+    if (!includeEnergy) {
+        return;
+    }
+    __syncthreads();
+
+    for (unsigned int stride=blockDim.x/2; stride>0; stride>>=1) {
+        if (threadIndex < stride) {
+            accumulator[threadIndex] += accumulator[threadIndex + stride];
+        }
+        __syncthreads();
+    }
+    if (threadIndex == 0) {
+        energyBuffer[0] += accumulator[0];
+    }
+}
+
+/**
+ * Spread the force on the center of each group over its atoms.
+ */
+extern "C" __global__ void applyOneDimComPairwiseForce(int numAtoms, const int* __restrict__ atoms,
+                                      const float* __restrict__ weights, const int* __restrict__ atomGroups,
+                                      const float* __restrict__ centerForces, unsigned long long* __restrict__ forceBuffer) {
+    for (int index=blockIdx.x*blockDim.x+threadIdx.x; index<numAtoms; index+=blockDim.x*gridDim.x) {
+        float force = centerForces[atomGroups[index]] * weights[index];
+        if (force != 0.0f) {
+            atomicAdd(&forceBuffer[atoms[index]], static_cast<unsigned long long>((long long)(force*0x100000000)));
+        }
+    }
+}
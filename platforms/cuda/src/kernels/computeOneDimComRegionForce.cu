@@ -0,0 +1,159 @@
+/**
+ * Collect the candidates within the padded region into the active list, if forced
+ * to or if any candidate has moved further than maxDisplacement since the list was
+ * last built.  This is only run with a single thread block, and the order of the
+ * list is arbitrary.
+ */
+extern "C" __global__ void refreshOneDimComRegion(const real4* __restrict__ posq, int nCandidates,
+                                      const int* __restrict__ candidates, float lowerCutoff, float upperCutoff,
+                                      float maxDisplacement, int force, float* __restrict__ refreshPositions,
+                                      int* __restrict__ activeCandidates, int* __restrict__ activeCount) {
+    __shared__ int count;
+    __shared__ int moved;
+    if (threadIdx.x == 0) {
+        count = 0;
+        moved = force;
+    }
+    __syncthreads();
+
+    for (int index=threadIdx.x; index<nCandidates; index+=blockDim.x) {
+        if (fabsf(posq[candidates[index]].x - refreshPositions[index]) > maxDisplacement) {
+            moved = 1;
+        }
+    }
+    __syncthreads();
+    if (!moved) {
+        return;
+    }
+
+    for (int index=threadIdx.x; index<nCandidates; index+=blockDim.x) {
+        float x = posq[candidates[index]].x;
+        refreshPositions[index] = x;
+        if (x >= lowerCutoff && x <= upperCutoff) {
+            activeCandidates[atomicAdd(&count, 1)] = index;
+        }
+    }
+    __syncthreads();
+
+    if (threadIdx.x == 0) {
+        activeCount[0] = count;
+    }
+}
+
+/**
+ * The weight of an atom in the region, which is 1 inside the slab and falls
+ * smoothly to 0 over width outside each face.
+ */
+inline __device__ float switchOneDimComRegion(float x, float lower, float upper, float width, float* dsdx) {
+    float t;
+    float sign;
+    if (x < lower) {
+        t = (x - (lower - width)) / width;
+        sign = 1.0f;
+    }
+    else if (x > upper) {
+        t = ((upper + width) - x) / width;
+        sign = -1.0f;
+    }
+    else {
+        *dsdx = 0.0f;
+        return 1.0f;
+    }
+    if (t <= 0.0f) {
+        *dsdx = 0.0f;
+        return 0.0f;
+    }
+    *dsdx = sign * 6.0f * t * (1.0f - t) / width;
+    return t * t * (3.0f - 2.0f * t);
+}
+
+/**
+ * The factor the restraint is scaled by for a region of a given switched mass,
+ * which falls smoothly to 0 with the mass so an emptying region lets go gently.
+ */
+inline __device__ float fadeOneDimComRegion(float mass, float fadeMass, float* dfdm) {
+    if (mass >= fadeMass) {
+        *dfdm = 0.0f;
+        return 1.0f;
+    }
+    float t = mass / fadeMass;
+    *dfdm = 6.0f * t * (1.0f - t) / fadeMass;
+    return t * t * (3.0f - 2.0f * t);
+}
+
+extern "C" __global__ void computeOneDimComRegionForce(const real4* __restrict__ posq, int nGroup1,
+                                      const int* __restrict__ group1Indices, const float* __restrict__ group1Weights,
+                                      const int* __restrict__ candidates, const float* __restrict__ candidateMasses,
+                                      const int* __restrict__ activeCandidates, const int* __restrict__ activeCount,
+                                      float lower, float upper, float width, float fadeMass, float k, float r0,
+                                      unsigned long long* __restrict__ forceBuffer, real* __restrict__ energyBuffer) {
+    // this is only run with a single thread block, and the accumulator holds
+    // the group 1 center, the mass weighted sum of the region positions and
+    // the total switched mass of the region, one after the other
+    extern __shared__ float accumulator[];
+    float* center1 = accumulator;
+    float* regionSum = accumulator + blockDim.x;
+    float* regionMass = accumulator + 2 * blockDim.x;
+    int threadIndex = threadIdx.x;
+    int nActive = activeCount[0];
+
+    center1[threadIndex] = 0.0;
+    regionSum[threadIndex] = 0.0;
+    regionMass[threadIndex] = 0.0;
+    for (int index=threadIndex; index<nGroup1; index+=blockDim.x) {
+        center1[threadIndex] += posq[group1Indices[index]].x * group1Weights[index];
+    }
+    for (int index=threadIndex; index<nActive; index+=blockDim.x) {
+        int candidate = activeCandidates[index];
+        float x = posq[candidates[candidate]].x;
+        float dsdx;
+        float weight = switchOneDimComRegion(x, lower, upper, width, &dsdx) * candidateMasses[candidate];
+        regionSum[threadIndex] += weight * x;
+        regionMass[threadIndex] += weight;
+    }
+    __syncthreads();
+
+    for (unsigned int stride=blockDim.x/2; stride>0; stride>>=1) {
+        if (threadIndex < stride) {
+            center1[threadIndex] += center1[threadIndex + stride];
+            regionSum[threadIndex] += regionSum[threadIndex + stride];
+            regionMass[threadIndex] += regionMass[threadIndex + stride];
+        }
+        __syncthreads();
+    }
+
+    // an empty region has no center, so it contributes nothing, and the
+    // restraint fades out before that so the energy stays continuous
+    float mass = regionMass[0];
+    if (mass == 0.0f) {
+        return;
+    }
+    float dfdm;
+    float fade = fadeOneDimComRegion(mass, fadeMass, &dfdm);
+    float center = regionSum[0] / mass;
+    float displacement = center - center1[0];
+    float energy = 0.5f * k * (displacement - r0) * (displacement - r0);
+    if (threadIndex == 0) {
+        energyBuffer[0] += fade * energy;
+    }
+
+    float factor = fade * k * (displacement - r0);
+    for (int index=threadIndex; index<nGroup1; index+=blockDim.x) {
+        float force = factor * group1Weights[index];
+        atomicAdd(&forceBuffer[group1Indices[index]], static_cast<unsigned long long>((long long)(force*0x100000000)));
+    }
+
+    // the switch makes the weights depend on position, which adds a term
+    // proportional to the distance from the center, and another through
+    // the mass the fade depends on
+    for (int index=threadIndex; index<nActive; index+=blockDim.x) {
+        int candidate = activeCandidates[index];
+        int atom = candidates[candidate];
+        float x = posq[atom].x;
+        float dsdx;
+        float s = switchOneDimComRegion(x, lower, upper, width, &dsdx);
+        float force = -factor * candidateMasses[candidate] * (s + dsdx * (x - center)) / mass
+                - energy * dfdm * candidateMasses[candidate] * dsdx;
+        atomicAdd(&forceBuffer[atom], static_cast<unsigned long long>((long long)(force*0x100000000)));
+    }
+}
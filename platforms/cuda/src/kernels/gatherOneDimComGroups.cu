@@ -0,0 +1,38 @@
+/**
+ * Reduce every distinct group registered with a CudaOneDimComGatherRegistry to its
+ * weighted sum of x coordinates.  Each thread block handles one group at a time,
+ * and accumulator must hold one float per thread.
+ */
+extern "C" __global__ void gatherOneDimComGroups(const real4* __restrict__ posq, int numGroups,
+                                      const int* __restrict__ groupStarts, const int* __restrict__ atoms,
+                                      const float* __restrict__ weights, float* __restrict__ groupSums) {
+    extern __shared__ float accumulator[];
+    int threadIndex = threadIdx.x;
+    for (int group=blockIdx.x; group<numGroups; group+=gridDim.x) {
+        accumulator[threadIndex] = 0.0;
+        for (int index=groupStarts[group]+threadIndex; index<groupStarts[group+1]; index+=blockDim.x) {
+            accumulator[threadIndex] += posq[atoms[index]].x * weights[index];
+        }
+        __syncthreads();
+        for (unsigned int stride=blockDim.x/2; stride>0; stride>>=1) {
+            if (threadIndex < stride) {
+                accumulator[threadIndex] += accumulator[threadIndex + stride];
+            }
+            __syncthreads();
+        }
+        if (threadIndex == 0) {
+            groupSums[group] = accumulator[0];
+        }
+        __syncthreads();
+    }
+}
+
+/**
+ * Turn the sums of a force's two groups into its displacement.
+ */
+extern "C" __global__ void combineOneDimComGroupSums(const float* __restrict__ groupSums, int group1, int group2,
+                                      float* __restrict__ displacementBuffer) {
+    if (blockIdx.x == 0 && threadIdx.x == 0) {
+        displacementBuffer[0] = groupSums[group2] - groupSums[group1];
+    }
+}
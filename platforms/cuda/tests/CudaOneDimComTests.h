@@ -0,0 +1,23 @@
+#ifndef CUDA_ONEDIMCOM_TESTS_H_
+#define CUDA_ONEDIMCOM_TESTS_H_
+
+/**
+ * The platform the shared tests in the top level tests directory run on.  The
+ * first argument of a test program, if there is one, is the precision to use.
+ */
+
+#include "openmm/Platform.h"
+#include "openmm/internal/windowsExport.h"
+#include <string>
+
+extern "C" OPENMM_EXPORT void registerOneDimComCudaKernelFactories();
+
+const std::string platformName = "CUDA";
+
+void initializeTests(int argc, char* argv[]) {
+    registerOneDimComCudaKernelFactories();
+    if (argc > 1)
+        OpenMM::Platform::getPlatformByName("CUDA").setPropertyDefaultValue("CudaPrecision", std::string(argv[1]));
+}
+
+#endif /*CUDA_ONEDIMCOM_TESTS_H_*/
@@ -0,0 +1,156 @@
+#include "OneDimComCombinationForce.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/Context.h"
+#include "openmm/Platform.h"
+#include "openmm/System.h"
+#include "openmm/VerletIntegrator.h"
+#include "openmm/OpenMMException.h"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+extern "C" OPENMM_EXPORT void registerOneDimComCudaKernelFactories();
+
+OneDimComCombinationForce* createLeafletForce() {
+    // a peptide (atom 0) relative to the average of two leaflets
+    // (atoms 1 and 2, atoms 3 and 4), with atom 5 left out
+    // in order to catch stupid indexing errors
+    OneDimComCombinationForce* force = new OneDimComCombinationForce(2.0, -1.0);
+
+    vector<int> peptide;
+    vector<float> peptideWeights;
+    peptide.push_back(0);
+    peptideWeights.push_back(1.0);
+    force->addGroup(peptide, peptideWeights, 1.0);
+
+    vector<int> leaflet1;
+    vector<float> leaflet1Weights;
+    leaflet1.push_back(1);
+    leaflet1.push_back(2);
+    leaflet1Weights.push_back(0.25);
+    leaflet1Weights.push_back(0.75);
+    force->addGroup(leaflet1, leaflet1Weights, -0.5);
+
+    vector<int> leaflet2;
+    vector<float> leaflet2Weights;
+    leaflet2.push_back(3);
+    leaflet2.push_back(4);
+    leaflet2Weights.push_back(0.5);
+    leaflet2Weights.push_back(0.5);
+    force->addGroup(leaflet2, leaflet2Weights, -0.5);
+    return force;
+}
+
+void testThreeGroups() {
+    System system;
+    vector<Vec3> positions(6);
+    for (int i=0; i<6; ++i)
+        system.addParticle(1.0);
+    positions[0] = Vec3(3.0, 0.0, 0.0);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    positions[2] = Vec3(2.0, 0.0, 0.0);
+    positions[3] = Vec3(5.0, 0.0, 0.0);
+    positions[4] = Vec3(5.0, 0.0, 0.0);
+    positions[5] = Vec3(200.0, 0.0, 0.0);
+
+    system.addForce(createLeafletForce());
+
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName("CUDA");
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+
+    State state = context.getState(State::Energy | State::Forces);
+
+    // X = 3 - 0.5 * 1.75 - 0.5 * 5 = -0.375
+    ASSERT_EQUAL_TOL(0.5 * 2.0 * 0.625 * 0.625, state.getPotentialEnergy(), 1e-5);
+
+    // F_i = -k * (X - r0) * c_g * w_i
+    ASSERT_EQUAL_TOL(-1.25, state.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(1.25 * 0.5 * 0.25, state.getForces()[1][0], 1e-5);
+    ASSERT_EQUAL_TOL(1.25 * 0.5 * 0.75, state.getForces()[2][0], 1e-5);
+    ASSERT_EQUAL_TOL(1.25 * 0.5 * 0.5, state.getForces()[3][0], 1e-5);
+    ASSERT_EQUAL_TOL(1.25 * 0.5 * 0.5, state.getForces()[4][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[5][0], 1e-5);
+}
+
+void testChangingParameters() {
+    System system;
+    vector<Vec3> positions(6);
+    for (int i=0; i<6; ++i)
+        system.addParticle(1.0);
+    positions[0] = Vec3(3.0, 0.0, 0.0);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    positions[2] = Vec3(2.0, 0.0, 0.0);
+    positions[3] = Vec3(5.0, 0.0, 0.0);
+    positions[4] = Vec3(5.0, 0.0, 0.0);
+    positions[5] = Vec3(200.0, 0.0, 0.0);
+
+    OneDimComCombinationForce* force = createLeafletForce();
+    system.addForce(force);
+
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName("CUDA");
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+
+    // measure the peptide against the first leaflet only
+    force->setGroupParameters(2, force->getGroupIndices(2), force->getGroupWeights(2), 0.0);
+    force->setGroupParameters(1, force->getGroupIndices(1), force->getGroupWeights(1), -1.0);
+    force->setForceConst(1.0);
+    force->setR0(1.0);
+    force->updateParametersInContext(context);
+
+    // X = 3 - 1.75 = 1.25
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(0.5 * 0.25 * 0.25, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(-0.25, state.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.25 * 0.25, state.getForces()[1][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.25 * 0.75, state.getForces()[2][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[3][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[4][0], 1e-5);
+}
+
+void testGroupSum() {
+    // a group whose weights don't add up to one should be rejected
+    OneDimComCombinationForce force(1.0, 1.0);
+    vector<int> group;
+    vector<float> weights;
+    group.push_back(0);
+    group.push_back(1);
+    weights.push_back(0.5);
+    weights.push_back(0.0);
+
+    try {
+        force.addGroup(group, weights, 1.0);
+    }
+    catch (OpenMMException e) {
+        // we're supposed to throw an exception, so we return successfully if we get here.
+        return;
+    }
+    // we shouldn't get here
+    throw OpenMMException("Should have thrown an exception when the group weights didn't sum to 1.0");
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        registerOneDimComCudaKernelFactories();
+        if (argc > 1)
+            Platform::getPlatformByName("CUDA").setPropertyDefaultValue("CudaPrecision", string(argv[1]));
+
+        // run the tests
+        testGroupSum();
+        testThreeGroups();
+        testChangingParameters();
+    }
+    catch(const std::exception& e) {
+        std::cout << "exception: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Done" << std::endl;
+    return 0;
+}
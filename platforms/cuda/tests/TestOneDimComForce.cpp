@@ -1,20 +1,27 @@
+#include "CudaOneDimComTests.h"
+#include "TestOneDimComForce.h"
 #include "OneDimComForce.h"
+#include "OneDimComColvarReader.h"
+#include "OneDimComPairwiseForce.h"
 #include "openmm/internal/AssertionUtilities.h"
 #include "openmm/Context.h"
+#include "openmm/CustomExternalForce.h"
 #include "openmm/Platform.h"
 #include "openmm/System.h"
 #include "openmm/VerletIntegrator.h"
 #include "openmm/OpenMMException.h"
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
 #include <iostream>
+#include <map>
 #include <vector>
 
 using namespace OneDimComPlugin;
 using namespace OpenMM;
 using namespace std;
 
-extern "C" OPENMM_EXPORT void registerOneDimComCudaKernelFactories();
-
 void testTwoParticles() {
     System system;
     vector<Vec3> positions(3);
@@ -152,6 +159,369 @@ void testChangingParameters() {
     ASSERT_EQUAL_TOL(expectedForce, state.getForces()[2][0], 1e-5);
 }
 
+void testEvaluationCache() {
+    System system;
+    vector<Vec3> positions(3);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    positions[0] = Vec3(1.0, 0.0, 0.0);
+    positions[1] = Vec3(200.0, 0.0, 0.0);
+    positions[2] = Vec3(2.0, 0.0, 0.0);
+
+    vector<int> group1;
+    vector<int> group2;
+    vector<float> weights1;
+    vector<float> weights2;
+    group1.push_back(0);
+    group2.push_back(2);
+    weights1.push_back(1.0);
+    weights2.push_back(1.0);
+
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights1, weights2, 1.0, 2.0);
+    force->setUseEvaluationCache(true);
+    system.addForce(force);
+
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName("CUDA");
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+
+    // the second evaluation reuses the displacement from the first
+    State state1 = context.getState(State::Energy | State::Forces);
+    State state2 = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(0.5, state1.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(state1.getPotentialEnergy(), state2.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(state1.getForces()[0][0], state2.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(state1.getForces()[2][0], state2.getForces()[2][0], 1e-5);
+
+    // changing the parameters must invalidate the cache
+    force->setR0(3.0);
+    force->updateParametersInContext(context);
+    State state3 = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(2.0, state3.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(-2.0, state3.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(2.0, state3.getForces()[2][0], 1e-5);
+
+    // so must advancing the time
+    positions[2] = Vec3(4.0, 0.0, 0.0);
+    context.setPositions(positions);
+    context.setTime(1.0);
+    State state4 = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(0.0, state4.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state4.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state4.getForces()[2][0], 1e-5);
+
+    // and so must setting positions at the same time, which the checksum of
+    // the group coordinates picks up, giving a displacement of 5
+    positions[2] = Vec3(6.0, 0.0, 0.0);
+    context.setPositions(positions);
+    State state5 = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(2.0, state5.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(2.0, state5.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(-2.0, state5.getForces()[2][0], 1e-5);
+    ASSERT_EQUAL_TOL(5.0, force->getDisplacement(context), 1e-5);
+
+    // moving an atom outside the groups changes nothing
+    positions[1] = Vec3(100.0, 0.0, 0.0);
+    context.setPositions(positions);
+    State state6 = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(2.0, state6.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(-2.0, state6.getForces()[2][0], 1e-5);
+}
+
+void testColvarFile() {
+    System system;
+    vector<Vec3> positions(3);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    positions[0] = Vec3(1.0, 0.0, 0.0);
+    positions[1] = Vec3(200.0, 0.0, 0.0);
+    positions[2] = Vec3(2.0, 0.0, 0.0);
+
+    vector<int> group1;
+    vector<int> group2;
+    vector<float> weights1;
+    vector<float> weights2;
+    group1.push_back(0);
+    group2.push_back(2);
+    weights1.push_back(1.0);
+    weights2.push_back(1.0);
+
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights1, weights2, 1.0, 2.0);
+    force->setColvarFile("TestOneDimComForceColvar.dat", 2);
+    system.addForce(force);
+
+    // the file is complete once the context is destroyed
+    {
+        VerletIntegrator integrator(0.001);
+        Platform& platform = Platform::getPlatformByName("CUDA");
+        Context context(system, integrator, platform);
+        context.setPositions(positions);
+        integrator.step(10);
+    }
+
+    // forces are evaluated at the start of steps 0 through 9
+    OneDimComColvarReader reader("TestOneDimComForceColvar.dat");
+    ASSERT_EQUAL(5, reader.getNumRecords());
+    for (int i=0; i<reader.getNumRecords(); ++i) {
+        ASSERT_EQUAL(2*i, reader.getSteps()[i]);
+        double displacement = reader.getDisplacements()[i];
+        ASSERT_EQUAL_TOL(0.5*(displacement-2.0)*(displacement-2.0), reader.getEnergies()[i], 1e-5);
+    }
+    ASSERT_EQUAL_TOL(1.0, reader.getDisplacements()[0], 1e-5);
+    ASSERT_EQUAL_TOL(0.5, reader.getEnergies()[0], 1e-5);
+    remove("TestOneDimComForceColvar.dat");
+}
+
+void testWindowEnergies() {
+    System system;
+    vector<Vec3> positions(3);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    positions[0] = Vec3(1.0, 0.0, 0.0);
+    positions[1] = Vec3(200.0, 0.0, 0.0);
+    positions[2] = Vec3(2.0, 0.0, 0.0);
+
+    vector<int> group1;
+    vector<int> group2;
+    vector<float> weights1;
+    vector<float> weights2;
+    group1.push_back(0);
+    group2.push_back(2);
+    weights1.push_back(1.0);
+    weights2.push_back(1.0);
+
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights1, weights2, 1.0, 2.0);
+    system.addForce(force);
+
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName("CUDA");
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+
+    ASSERT_EQUAL_TOL(1.0, force->getDisplacement(context), 1e-5);
+
+    vector<double> ks, r0s;
+    ks.push_back(1.0);
+    r0s.push_back(2.0);
+    ks.push_back(2.0);
+    r0s.push_back(0.0);
+    ks.push_back(0.5);
+    r0s.push_back(1.0);
+    vector<double> energies = force->computeWindowEnergies(context, ks, r0s);
+    ASSERT_EQUAL(3, energies.size());
+    ASSERT_EQUAL_TOL(0.5, energies[0], 1e-5);
+    ASSERT_EQUAL_TOL(1.0, energies[1], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, energies[2], 1e-5);
+
+    // the force itself is unaffected
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(0.5, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(-1.0, state.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(1.0, state.getForces()[2][0], 1e-5);
+}
+
+void checkStrategy(Platform& platform, int numParticlesPerGroup, string& strategy) {
+    // every strategy has to give the same answer, so only its description
+    // depends on the size of the groups
+    System system;
+    vector<Vec3> positions(numParticlesPerGroup * 2);
+    vector<int> group1, group2;
+    vector<float> weights1, weights2;
+    double expected = 0.0;
+    for (int i=0; i<2*numParticlesPerGroup; ++i) {
+        system.addParticle(1.0);
+        positions[i] = Vec3((i%7)*0.25, 0.0, 0.0);
+        if (i < numParticlesPerGroup) {
+            group1.push_back(i);
+            weights1.push_back(1.0 / numParticlesPerGroup);
+            expected -= positions[i][0] / numParticlesPerGroup;
+        }
+        else {
+            group2.push_back(i);
+            weights2.push_back(1.0 / numParticlesPerGroup);
+            expected += positions[i][0] / numParticlesPerGroup;
+        }
+    }
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights1, weights2, 1.0, 2.0);
+    system.addForce(force);
+
+    VerletIntegrator integrator(1.0);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(expected, force->getDisplacement(context), 1e-4);
+    ASSERT_EQUAL_TOL(0.5*(expected-2.0)*(expected-2.0), state.getPotentialEnergy(), 1e-4);
+    ASSERT_EQUAL_TOL((expected-2.0) / numParticlesPerGroup, state.getForces()[0][0], 1e-4);
+    strategy = force->getExecutionStrategy(context);
+}
+
+void testExecutionStrategy() {
+    Platform& platform = Platform::getPlatformByName("CUDA");
+    const int sizes[] = {3, 500, 100000};
+    for (int i=0; i<3; ++i) {
+        string strategy, repeated;
+        checkStrategy(platform, sizes[i], strategy);
+        ASSERT(strategy.size() > 0);
+
+        // the choice is remembered for the size class
+        checkStrategy(platform, sizes[i], repeated);
+        ASSERT_EQUAL(strategy, repeated);
+    }
+}
+
+void testSharedGroups() {
+    // two restraints pull different ligands (1 and 2) towards the same
+    // backbone (3 and 4), so the backbone is only gathered once
+    System system;
+    vector<Vec3> positions(5);
+    for (int i=0; i<5; ++i)
+        system.addParticle(1.0);
+    positions[0] = Vec3(100.0, 0.0, 0.0);
+    positions[1] = Vec3(2.0, 0.0, 0.0);
+    positions[2] = Vec3(4.0, 0.0, 0.0);
+    positions[3] = Vec3(0.0, 0.0, 0.0);
+    positions[4] = Vec3(1.0, 0.0, 0.0);
+    vector<int> backbone;
+    backbone.push_back(3);
+    backbone.push_back(4);
+    vector<float> backboneWeights(2, 0.5);
+    vector<int> ligand1(1, 1), ligand2(1, 2);
+    vector<float> ligandWeights(1, 1.0);
+    OneDimComForce* force1 = new OneDimComForce(backbone, ligand1, backboneWeights, ligandWeights, 1.0, 1.0);
+    OneDimComForce* force2 = new OneDimComForce(backbone, ligand2, backboneWeights, ligandWeights, 2.0, 1.0);
+    system.addForce(force1);
+    system.addForce(force2);
+
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName("CUDA");
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+
+    // d1 = 1.5 and d2 = 3.5, so E = 0.5*0.25 + 0.5*2*6.25
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(6.375, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(-0.5, state.getForces()[1][0], 1e-5);
+    ASSERT_EQUAL_TOL(-5.0, state.getForces()[2][0], 1e-5);
+    ASSERT_EQUAL_TOL(2.75, state.getForces()[3][0], 1e-5);
+    ASSERT_EQUAL_TOL(2.75, state.getForces()[4][0], 1e-5);
+
+    // outside a force evaluation each force still sees the current positions
+    positions[2] = Vec3(5.0, 0.0, 0.0);
+    context.setPositions(positions);
+    ASSERT_EQUAL_TOL(1.5, force1->getDisplacement(context), 1e-5);
+    ASSERT_EQUAL_TOL(4.5, force2->getDisplacement(context), 1e-5);
+    state = context.getState(State::Energy);
+    ASSERT_EQUAL_TOL(0.125+12.25, state.getPotentialEnergy(), 1e-5);
+}
+
+void testConstraint() {
+    // a constant force of 3 pulls atom 1 to the right.  With masses of 1 and 2
+    // the constraint has to push back with a generalized force of -1 to keep
+    // the two atoms moving together.
+    System system;
+    vector<Vec3> positions(3);
+    system.addParticle(1.0);
+    system.addParticle(2.0);
+    system.addParticle(1.0);
+    positions[0] = Vec3(-0.75, 0.0, 0.0);
+    positions[1] = Vec3(0.75, 0.0, 0.0);
+    positions[2] = Vec3(5.0, 0.0, 0.0);
+
+    vector<int> group1;
+    vector<int> group2;
+    vector<float> weights1;
+    vector<float> weights2;
+    group1.push_back(0);
+    group2.push_back(1);
+    weights1.push_back(1.0);
+    weights2.push_back(1.0);
+
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights1, weights2, 1000.0, 1.5);
+    force->setUseConstraint(true);
+    system.addForce(force);
+    CustomExternalForce* pull = new CustomExternalForce("-3*x");
+    pull->addParticle(1);
+    system.addForce(pull);
+
+    VerletIntegrator integrator(0.01);
+    Platform& platform = Platform::getPlatformByName("CUDA");
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+
+    // the restraint itself contributes nothing
+    State state = context.getState(State::Forces);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[0][0], 1e-5);
+
+    // the first step starts on the constraint, so there is nothing to
+    // correct until it has been taken
+    integrator.step(1);
+
+    // the projection lags integration by a step, so the positions seen
+    // between steps carry the drift of exactly one step, which is 1.5*dt^2
+    // here, rather than accumulating it
+    double totalForce = 0.0;
+    for (int i=0; i<20; ++i) {
+        integrator.step(1);
+        totalForce += force->getConstraintForce(context);
+        state = context.getState(State::Positions);
+        ASSERT_EQUAL_TOL(1.5e-4, state.getPositions()[1][0]-state.getPositions()[0][0]-1.5, 1e-5);
+    }
+    ASSERT_EQUAL_TOL(-1.0, totalForce/20, 1e-2);
+}
+
+int countCachedModules(const string& directory) {
+    int count = 0;
+    DIR* dir = opendir(directory.c_str());
+    ASSERT(dir != NULL);
+    while (struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] != '.')
+            count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+void testPrewarmKernels() {
+    // prewarming must put every kernel of the plugin in the on-disk cache, so a
+    // Context like the one it builds compiles nothing new when it is evaluated
+    Platform& platform = Platform::getPlatformByName("CUDA");
+    char directoryTemplate[] = "/tmp/OneDimComPrewarmXXXXXX";
+    string directory = string(mkdtemp(directoryTemplate))+"/";
+    map<string, string> properties;
+    properties["CudaPrecision"] = platform.getPropertyDefaultValue("CudaPrecision");
+    properties["CudaTempDirectory"] = directory;
+    OneDimComForce::prewarmKernels(platform, properties);
+    int cached = countCachedModules(directory);
+    ASSERT(cached > 0);
+
+    System system;
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    vector<int> group1(1, 0), group2(1, 1);
+    vector<float> weights(1, 1.0);
+    system.addForce(new OneDimComForce(group1, group2, weights, weights, 1.0, 0.5));
+    OneDimComPairwiseForce* pairwise = new OneDimComPairwiseForce();
+    pairwise->addGroup(group1, weights);
+    pairwise->addGroup(group2, weights);
+    pairwise->addPair(0, 1, 2.0, 1.0);
+    system.addForce(pairwise);
+    VerletIntegrator integrator(0.001);
+    Context context(system, integrator, platform, properties);
+    vector<Vec3> positions(2, Vec3());
+    positions[1] = Vec3(2, 0, 0);
+    context.setPositions(positions);
+    context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL(cached, countCachedModules(directory));
+
+    // and it must leave the platform usable with the same properties
+    testTwoParticles();
+}
+
 void testGroupSum1() {
     // Create a OneDimComForce where the group 1 weights don't add up to one
     int g1[] = {0, 1};
@@ -252,28 +622,22 @@ void testSizeMatch2() {
     throw OpenMMException("Should have thrown an exception when group2 and weights2 have different sizes.");
 }
 
-int main(int argc, char* argv[]) {
-    try {
-        registerOneDimComCudaKernelFactories();
-        if (argc > 1)
-            Platform::getPlatformByName("CUDA").setPropertyDefaultValue("CudaPrecision", string(argv[1]));
-
-        // run the tests
-        testGroupSum1();
-        testGroupSum2();
-        testSizeMatch1();
-        testSizeMatch2();
-        testTwoParticles();
-        testManyParticles();
-        testChangingParameters();
-
-        /* testForce(); */
-        /* testChangingParameters(); */
-    }
-    catch(const std::exception& e) {
-        std::cout << "exception: " << e.what() << std::endl;
-        return 1;
-    }
-    std::cout << "Done" << std::endl;
-    return 0;
+void runPlatformTests() {
+    testGroupSum1();
+    testGroupSum2();
+    testSizeMatch1();
+    testSizeMatch2();
+    testTwoParticles();
+    testManyParticles();
+    testChangingParameters();
+    testEvaluationCache();
+    testColvarFile();
+    testWindowEnergies();
+    testConstraint();
+    testSharedGroups();
+    testExecutionStrategy();
+    testPrewarmKernels();
+
+    /* testForce(); */
+    /* testChangingParameters(); */
 }
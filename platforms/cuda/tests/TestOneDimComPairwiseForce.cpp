@@ -0,0 +1,5 @@
+#include "CudaOneDimComTests.h"
+#include "TestOneDimComPairwiseForce.h"
+
+void runPlatformTests() {
+}
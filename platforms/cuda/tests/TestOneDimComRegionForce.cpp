@@ -0,0 +1,221 @@
+#include "OneDimComRegionForce.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/Context.h"
+#include "openmm/Platform.h"
+#include "openmm/System.h"
+#include "openmm/VerletIntegrator.h"
+#include "openmm/OpenMMException.h"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+extern "C" OPENMM_EXPORT void registerOneDimComCudaKernelFactories();
+
+OneDimComRegionForce* createSlabForce() {
+    // a peptide (atom 0) relative to the atoms 1-4 that are inside the
+    // slab 0.5 <= x <= 2.0, with atom 5 left out in order to catch stupid
+    // indexing errors
+    vector<int> group1;
+    vector<float> weights1;
+    group1.push_back(0);
+    weights1.push_back(1.0);
+    vector<int> candidates;
+    for (int i=1; i<5; ++i)
+        candidates.push_back(i);
+    return new OneDimComRegionForce(group1, weights1, candidates, 0.5, 2.0, 2.0, 1.0);
+}
+
+void createSystem(System& system, vector<Vec3>& positions) {
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    system.addParticle(3.0);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    positions.resize(6);
+    positions[0] = Vec3(0.0, 0.0, 0.0);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    positions[2] = Vec3(1.4, 0.0, 0.0);
+    positions[3] = Vec3(5.0, 0.0, 0.0);
+    positions[4] = Vec3(-3.0, 0.0, 0.0);
+    positions[5] = Vec3(200.0, 0.0, 0.0);
+}
+
+void testInsideSlab() {
+    System system;
+    vector<Vec3> positions;
+    createSystem(system, positions);
+    system.addForce(createSlabForce());
+
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName("CUDA");
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    State state = context.getState(State::Energy | State::Forces);
+
+    // the center of mass of atoms 1 and 2 is 1.3, so the displacement is 1.3
+    ASSERT_EQUAL_TOL(0.09, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(0.6, state.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(-0.15, state.getForces()[1][0], 1e-5);
+    ASSERT_EQUAL_TOL(-0.45, state.getForces()[2][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[3][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[4][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[5][0], 1e-5);
+}
+
+void testSwitchedAtom() {
+    // put atom 3 half way through the switching region and compare
+    // its force to a finite difference of the energy
+    System system;
+    vector<Vec3> positions;
+    createSystem(system, positions);
+    positions[3] = Vec3(2.05, 0.0, 0.0);
+    system.addForce(createSlabForce());
+
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName("CUDA");
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    State state = context.getState(State::Forces);
+
+    const double delta = 1e-3;
+    positions[3][0] += delta;
+    context.setPositions(positions);
+    double energyPlus = context.getState(State::Energy).getPotentialEnergy();
+    positions[3][0] -= 2*delta;
+    context.setPositions(positions);
+    double energyMinus = context.getState(State::Energy).getPotentialEnergy();
+    ASSERT_EQUAL_TOL(-(energyPlus-energyMinus)/(2*delta), state.getForces()[3][0], 1e-2);
+}
+
+void testRefresh() {
+    System system;
+    vector<Vec3> positions;
+    createSystem(system, positions);
+    OneDimComRegionForce* force = createSlabForce();
+    force->setRefreshInterval(5);
+    system.addForce(force);
+
+    VerletIntegrator integrator(0.001);
+    Platform& platform = Platform::getPlatformByName("CUDA");
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    ASSERT_EQUAL_TOL(0.09, context.getState(State::Energy).getPotentialEnergy(), 1e-5);
+
+    // once the list has been rebuilt, atom 3 counts towards the region,
+    // which moves its center to (1 + 4.2 + 1.5) / 5 = 1.34
+    positions[3] = Vec3(1.5, 0.0, 0.0);
+    context.setPositions(positions);
+    context.setTime(5*0.001);
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(0.5*2.0*0.34*0.34, state.getPotentialEnergy(), 1e-4);
+    ASSERT_EQUAL_TOL(-2.0*0.34/5, state.getForces()[3][0], 1e-4);
+}
+
+void testSkin() {
+    // a candidate that moves further than half the skin forces a rebuild
+    // long before the interval is up
+    System system;
+    vector<Vec3> positions;
+    createSystem(system, positions);
+    OneDimComRegionForce* force = createSlabForce();
+    force->setRefreshInterval(1000);
+    system.addForce(force);
+
+    VerletIntegrator integrator(0.001);
+    Platform& platform = Platform::getPlatformByName("CUDA");
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    ASSERT_EQUAL_TOL(0.09, context.getState(State::Energy).getPotentialEnergy(), 1e-5);
+    positions[3] = Vec3(1.5, 0.0, 0.0);
+    context.setPositions(positions);
+    context.setTime(0.001);
+    ASSERT_EQUAL_TOL(0.5*2.0*0.34*0.34, context.getState(State::Energy).getPotentialEnergy(), 1e-4);
+}
+
+void testChangingParameters() {
+    System system;
+    vector<Vec3> positions;
+    createSystem(system, positions);
+    OneDimComRegionForce* force = createSlabForce();
+    system.addForce(force);
+
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName("CUDA");
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+
+    // moving the slab over atom 4 leaves it as the only member
+    force->setRegion(-3.5, -2.5);
+    force->updateParametersInContext(context);
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(0.5*2.0*16.0, state.getPotentialEnergy(), 1e-4);
+    ASSERT_EQUAL_TOL(-8.0, state.getForces()[0][0], 1e-4);
+    ASSERT_EQUAL_TOL(8.0, state.getForces()[4][0], 1e-4);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[1][0], 1e-5);
+}
+
+void testEmptyingRegion() {
+    // the only member leaves through the switching region, and the energy
+    // must fall to 0 with forces that match it all the way
+    System system;
+    system.addParticle(1.0);
+    system.addParticle(2.0);
+    vector<Vec3> positions(2);
+    OneDimComRegionForce* force = new OneDimComRegionForce(vector<int>(1, 0), vector<float>(1, 1.0), vector<int>(1, 1), 0.5, 2.0, 2.0, 1.0);
+    force->setSwitchWidth(1.0);
+    force->setSkin(1.0);
+    system.addForce(force);
+
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName("CUDA");
+    Context context(system, integrator, platform);
+    const double delta = 1e-3;
+    double x[] = {2.2, 2.5, 2.8, 2.95};
+    for (int i=0; i<4; ++i) {
+        positions[1] = Vec3(x[i], 0.0, 0.0);
+        context.setPositions(positions);
+        State state = context.getState(State::Forces);
+        positions[1][0] += delta;
+        context.setPositions(positions);
+        double energyPlus = context.getState(State::Energy).getPotentialEnergy();
+        positions[1][0] -= 2*delta;
+        context.setPositions(positions);
+        double energyMinus = context.getState(State::Energy).getPotentialEnergy();
+        ASSERT_EQUAL_TOL(-(energyPlus-energyMinus)/(2*delta), state.getForces()[1][0], 1e-2);
+    }
+
+    // the restraint has let go by the time the atom leaves
+    positions[1] = Vec3(2.999, 0.0, 0.0);
+    context.setPositions(positions);
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(0.0, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[1][0], 1e-3);
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        registerOneDimComCudaKernelFactories();
+        if (argc > 1)
+            Platform::getPlatformByName("CUDA").setPropertyDefaultValue("CudaPrecision", string(argv[1]));
+
+        // run the tests
+        testInsideSlab();
+        testSwitchedAtom();
+        testRefresh();
+        testSkin();
+        testChangingParameters();
+        testEmptyingRegion();
+    }
+    catch(const std::exception& e) {
+        std::cout << "exception: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Done" << std::endl;
+    return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef OPENMM_REFERENCEEXAMPLEKERNELFACTORY_H_
+#define OPENMM_REFERENCEEXAMPLEKERNELFACTORY_H_
+
+#include "openmm/KernelFactory.h"
+
+namespace OpenMM {
+
+/**
+ * This KernelFactory creates kernels for the reference implementation of the OneDimComplugin.
+ */
+
+class ReferenceOneDimComKernelFactory : public KernelFactory {
+public:
+    KernelImpl* createKernelImpl(std::string name, const Platform& platform, ContextImpl& context) const;
+};
+
+} // namespace OpenMM
+
+#endif /*OPENMM_REFERENCEEXAMPLEKERNELFACTORY_H_*/
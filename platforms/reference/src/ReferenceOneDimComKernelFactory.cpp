@@ -0,0 +1,71 @@
+/* -------------------------------------------------------------------------- *
+ *                              OpenMMExample                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "ReferenceOneDimComKernelFactory.h"
+#include "ReferenceOneDimComKernels.h"
+#include "openmm/reference/ReferencePlatform.h"
+#include "openmm/internal/ContextImpl.h"
+#include "openmm/OpenMMException.h"
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+
+extern "C" OPENMM_EXPORT void registerPlatforms() {
+}
+
+extern "C" OPENMM_EXPORT void registerKernelFactories() {
+    for (int i = 0; i < Platform::getNumPlatforms(); i++) {
+        Platform& platform = Platform::getPlatform(i);
+        if (dynamic_cast<ReferencePlatform*>(&platform) != NULL) {
+            ReferenceOneDimComKernelFactory* factory = new ReferenceOneDimComKernelFactory();
+            platform.registerKernelFactory(CalcOneDimComForceKernel::Name(), factory);
+            platform.registerKernelFactory(CalcOneDimComCombinationForceKernel::Name(), factory);
+            platform.registerKernelFactory(CalcOneDimComRegionForceKernel::Name(), factory);
+            platform.registerKernelFactory(CalcOneDimComPairwiseForceKernel::Name(), factory);
+        }
+    }
+}
+
+extern "C" OPENMM_EXPORT void registerOneDimComReferenceKernelFactories() {
+    registerKernelFactories();
+}
+
+KernelImpl* ReferenceOneDimComKernelFactory::createKernelImpl(std::string name, const Platform& platform, ContextImpl& context) const {
+    if (name == CalcOneDimComForceKernel::Name())
+        return new ReferenceCalcOneDimComForceKernel(name, platform, context.getSystem());
+    if (name == CalcOneDimComCombinationForceKernel::Name())
+        return new ReferenceCalcOneDimComCombinationForceKernel(name, platform);
+    if (name == CalcOneDimComRegionForceKernel::Name())
+        return new ReferenceCalcOneDimComRegionForceKernel(name, platform);
+    if (name == CalcOneDimComPairwiseForceKernel::Name())
+        return new ReferenceCalcOneDimComPairwiseForceKernel(name, platform);
+    throw OpenMMException((std::string("Tried to create kernel with illegal kernel name '")+name+"'").c_str());
+}
@@ -0,0 +1,756 @@
+#include "ReferenceOneDimComKernels.h"
+#include "internal/OneDimComReduction.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/internal/ContextImpl.h"
+#include "openmm/internal/ThreadPool.h"
+#include "openmm/reference/ReferencePlatform.h"
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+namespace {
+
+// the reduction strategy chosen for each size class, where the size class
+// is the number of bits needed to hold the number of atoms
+map<int, int> strategies;
+mutex strategiesLock;
+
+}
+
+static vector<Vec3>& extractPositions(ContextImpl& context) {
+    ReferencePlatform::PlatformData* data = reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
+    return *((vector<Vec3>*) data->positions);
+}
+
+static vector<Vec3>& extractVelocities(ContextImpl& context) {
+    ReferencePlatform::PlatformData* data = reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
+    return *((vector<Vec3>*) data->velocities);
+}
+
+static vector<Vec3>& extractForces(ContextImpl& context) {
+    ReferencePlatform::PlatformData* data = reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
+    return *((vector<Vec3>*) data->forces);
+}
+
+class ReferenceCalcOneDimComForceKernel::ReduceTask : public ThreadPool::Task {
+public:
+    ReduceTask(const ReferenceCalcOneDimComForceKernel& owner, const vector<Vec3>& pos, int numAtoms, int numThreads) :
+            owner(owner), pos(pos), numAtoms(numAtoms), partialSums(numThreads) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        int start = (int) ((numAtoms*(long long) threadIndex)/threads.getNumThreads());
+        int end = (int) ((numAtoms*(long long) (threadIndex+1))/threads.getNumThreads());
+        partialSums[threadIndex] = owner.reduce(pos, start, end);
+    }
+    const ReferenceCalcOneDimComForceKernel& owner;
+    const vector<Vec3>& pos;
+    int numAtoms;
+    vector<double> partialSums;
+};
+
+class ReferenceCalcOneDimComForceKernel::ScatterTask : public ThreadPool::Task {
+public:
+    ScatterTask(const ReferenceCalcOneDimComForceKernel& owner, vector<Vec3>& force, double factor) :
+            owner(owner), force(force), factor(factor) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        int numAtoms = owner.scatterAtoms.size();
+        int start = (int) ((numAtoms*(long long) threadIndex)/threads.getNumThreads());
+        int end = (int) ((numAtoms*(long long) (threadIndex+1))/threads.getNumThreads());
+        owner.scatter(force, factor, start, end);
+    }
+    const ReferenceCalcOneDimComForceKernel& owner;
+    vector<Vec3>& force;
+    double factor;
+};
+
+ReferenceCalcOneDimComForceKernel::ReferenceCalcOneDimComForceKernel(std::string name, const Platform& platform, const System& system) :
+        CalcOneDimComForceKernel(name, platform), system(system), strategy(Serial), threads(NULL), weights(NULL), scatterWeights(NULL), activeSet(0),
+        forceConst(0.0), r0(0.0), displacement(0.0), constraintForce(0.0), varianceStart(0), varianceEnd(0),
+        varianceForceConst(0.0), variance0(0.0), varianceOrigin(0.0), varianceMean(0.0), variance(0.0), hasWorkParameters(false), workForceConst(0.0),
+        workR0(0.0), work(0.0), hasLastDisplacement(false), hasEvent(false), lastDisplacement(0.0), eventThreshold(-1),
+        eventDirection(0), eventStep(0) {
+}
+
+ReferenceCalcOneDimComForceKernel::~ReferenceCalcOneDimComForceKernel() {
+    if (threads != NULL)
+        delete threads;
+}
+
+void ReferenceCalcOneDimComForceKernel::initialize(const System& system, const OneDimComForce& force) {
+    setParameters(force);
+    chooseStrategy();
+}
+
+void ReferenceCalcOneDimComForceKernel::chooseStrategy() {
+    int sizeClass = 0;
+    while ((1<<sizeClass) < (int) indices.size())
+        sizeClass++;
+
+    // the lock is held while calibrating, so that two contexts don't
+    // both calibrate the same size class
+    lock_guard<mutex> guard(strategiesLock);
+    if (strategies.find(sizeClass) == strategies.end()) {
+        // starting threads costs far more than reducing a small group, so
+        // only large groups are even tried with them
+        vector<Strategy> candidates;
+        candidates.push_back(Serial);
+        candidates.push_back(Vectorized);
+        if (indices.size() >= 4096)
+            candidates.push_back(Threaded);
+
+        // the values don't matter for timing, so there is no need to wait
+        // for the real positions
+        vector<Vec3> pos(system.getNumParticles());
+        Strategy best = Serial;
+        double bestTime = 0.0;
+        for (int i=0; i<candidates.size(); ++i) {
+            strategy = candidates[i];
+            if (strategy == Threaded && threads == NULL)
+                threads = new ThreadPool();
+            reduce(pos);
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            for (int j=0; j<10; ++j)
+                reduce(pos);
+            double time = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+            if (i == 0 || time < bestTime) {
+                bestTime = time;
+                best = strategy;
+            }
+        }
+        strategies[sizeClass] = best;
+    }
+    strategy = (Strategy) strategies[sizeClass];
+    if (strategy == Threaded && threads == NULL)
+        threads = new ThreadPool();
+    if (strategy != Threaded && threads != NULL) {
+        delete threads;
+        threads = NULL;
+    }
+}
+
+double ReferenceCalcOneDimComForceKernel::reduce(const vector<Vec3>& pos, int start, int end) const {
+    if (strategy == Serial) {
+        double sum = 0.0;
+        for (int i=start; i<end; ++i)
+            sum -= pos[indices[i]][0]*weights[i];
+        return sum;
+    }
+
+    // independent partial sums let the compiler keep several in flight at
+    // once, or in vector registers, without reassociating floating point math
+    double sum0 = 0.0, sum1 = 0.0, sum2 = 0.0, sum3 = 0.0;
+    int i = start;
+    for (; i+3<end; i+=4) {
+        sum0 -= pos[indices[i]][0]*weights[i];
+        sum1 -= pos[indices[i+1]][0]*weights[i+1];
+        sum2 -= pos[indices[i+2]][0]*weights[i+2];
+        sum3 -= pos[indices[i+3]][0]*weights[i+3];
+    }
+    for (; i<end; ++i)
+        sum0 -= pos[indices[i]][0]*weights[i];
+    return (sum0+sum1)+(sum2+sum3);
+}
+
+void ReferenceCalcOneDimComForceKernel::scatter(vector<Vec3>& force, double factor, int start, int end) const {
+    for (int i=start; i<end; ++i)
+        force[scatterAtoms[i]][0] += factor*scatterWeights[i];
+}
+
+void ReferenceCalcOneDimComForceKernel::scatter(vector<Vec3>& force, double factor) {
+    // each atom appears once in scatterAtoms, so threads given disjoint
+    // ranges of it can add straight into the platform's force array
+    if (strategy != Threaded) {
+        scatter(force, factor, 0, scatterAtoms.size());
+        return;
+    }
+    ScatterTask task(*this, force, factor);
+    threads->execute(task);
+    threads->waitForThreads();
+}
+
+double ReferenceCalcOneDimComForceKernel::reduce(const vector<Vec3>& pos) {
+    if (strategy != Threaded)
+        return reduce(pos, 0, indices.size());
+    ReduceTask task(*this, pos, indices.size(), threads->getNumThreads());
+    threads->execute(task);
+    threads->waitForThreads();
+    double sum = 0.0;
+    for (int i=0; i<task.partialSums.size(); ++i)
+        sum += task.partialSums[i];
+    return sum;
+}
+
+string ReferenceCalcOneDimComForceKernel::getExecutionStrategy(ContextImpl& context) {
+    if (strategy == Serial)
+        return "serial";
+    if (strategy == Vectorized)
+        return "vectorized";
+    stringstream description;
+    description << "threaded threads=" << threads->getNumThreads();
+    return description.str();
+}
+
+double ReferenceCalcOneDimComForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    if (varianceEnd > varianceStart)
+        computeMoments(context);
+    else
+        computeDisplacement(context);
+    return applyForces(context, includeForces, includeEnergy);
+}
+
+void ReferenceCalcOneDimComForceKernel::computeMoments(ContextImpl& context) {
+    // one pass gives the displacement and both moments of the restrained
+    // group, which are taken relative to its first atom to keep the
+    // difference of the moments accurate
+    const vector<Vec3>& pos = extractPositions(context);
+    varianceOrigin = pos[indices[varianceStart]][0];
+    double sum = 0.0, first = 0.0, second = 0.0;
+    for (int i=0; i<indices.size(); ++i) {
+        double x = pos[indices[i]][0];
+        sum -= x*weights[i];
+        if (i >= varianceStart && i < varianceEnd) {
+            double w = fabs(weights[i]);
+            first += w*(x-varianceOrigin);
+            second += w*(x-varianceOrigin)*(x-varianceOrigin);
+        }
+    }
+    displacement = sum;
+    varianceMean = first;
+    variance = second-first*first;
+}
+
+void ReferenceCalcOneDimComForceKernel::applyVarianceForces(ContextImpl& context) {
+    const vector<Vec3>& pos = extractPositions(context);
+    vector<Vec3>& force = extractForces(context);
+    double factor = -2.0*varianceForceConst*(variance-variance0);
+    for (int i=varianceStart; i<varianceEnd; ++i)
+        force[indices[i]][0] += factor*fabs(weights[i])*(pos[indices[i]][0]-varianceOrigin-varianceMean);
+}
+
+double ReferenceCalcOneDimComForceKernel::getVariance(ContextImpl& context) {
+    return variance;
+}
+
+void ReferenceCalcOneDimComForceKernel::recordDisplacement(ContextImpl& context, bool reduce) {
+    // there is nothing to wait for here, so the values are kept as they are
+    if (reduce)
+        computeDisplacement(context);
+    records.push_back(make_pair(displacement, varianceEnd > varianceStart ? variance : 0.0));
+}
+
+bool ReferenceCalcOneDimComForceKernel::getRecordedDisplacement(ContextImpl& context, bool wait, double& recordedDisplacement, double& recordedVariance) {
+    if (records.empty())
+        return false;
+    recordedDisplacement = records.front().first;
+    recordedVariance = records.front().second;
+    records.pop_front();
+    return true;
+}
+
+void ReferenceCalcOneDimComForceKernel::accumulateWork() {
+    // the parameters changed between the last evaluation and this one, so
+    // the work is the change in energy that caused at the current positions
+    if (hasWorkParameters && (forceConst != workForceConst || r0 != workR0))
+        work += 0.5*forceConst*(displacement-r0)*(displacement-r0) - 0.5*workForceConst*(displacement-workR0)*(displacement-workR0);
+    hasWorkParameters = true;
+    workForceConst = forceConst;
+    workR0 = r0;
+}
+
+void ReferenceCalcOneDimComForceKernel::setScheduledParameters(ContextImpl& context, double k, double r0, bool doesWork) {
+    // see setScheduledParameters() in the CUDA platform
+    if (!doesWork && hasWorkParameters) {
+        workForceConst = (workForceConst == forceConst ? k : workForceConst+k-forceConst);
+        workR0 = (workR0 == this->r0 ? r0 : workR0+r0-this->r0);
+    }
+    forceConst = k;
+    this->r0 = r0;
+}
+
+void ReferenceCalcOneDimComForceKernel::setPublishedParameters(ContextImpl& context, double k, double r0,
+        const vector<float>& weights1, const vector<float>& weights2) {
+    forceConst = k;
+    this->r0 = r0;
+    if (weights1.empty())
+        return;
+
+    // lay the weights out the same way OneDimComReduction does
+    publishedWeights.resize(indices.size());
+    for (int i=0; i<weights1.size(); ++i)
+        publishedWeights[i] = weights1[i];
+    for (int i=0; i<weights2.size(); ++i)
+        publishedWeights[weights1.size()+i] = -weights2[i];
+    publishedScatterWeights.assign(scatterAtoms.size(), 0.0f);
+    for (int i=0; i<indices.size(); ++i)
+        publishedScatterWeights[scatterSlots[i]] += publishedWeights[i];
+    weights = (publishedWeights.empty() ? NULL : &publishedWeights[0]);
+    scatterWeights = (publishedScatterWeights.empty() ? NULL : &publishedScatterWeights[0]);
+}
+
+double ReferenceCalcOneDimComForceKernel::getWork(ContextImpl& context) {
+    return work;
+}
+
+void ReferenceCalcOneDimComForceKernel::resetWork(ContextImpl& context) {
+    work = 0.0;
+}
+
+void ReferenceCalcOneDimComForceKernel::checkThresholds(ContextImpl& context, long long step) {
+    if (hasLastDisplacement && !hasEvent) {
+        // see checkOneDimComThresholds() in the CUDA platform
+        double nearest = 0.0;
+        for (int i=0; i<thresholds.size(); ++i) {
+            double distance = fabs(thresholds[i]-lastDisplacement);
+            if ((lastDisplacement < thresholds[i]) != (displacement < thresholds[i]) && (!hasEvent || distance < nearest)) {
+                hasEvent = true;
+                eventThreshold = i;
+                eventStep = step;
+                eventDirection = (displacement > lastDisplacement ? 1 : -1);
+                nearest = distance;
+            }
+        }
+    }
+    hasLastDisplacement = true;
+    lastDisplacement = displacement;
+}
+
+bool ReferenceCalcOneDimComForceKernel::getThresholdEvent(ContextImpl& context, int& threshold, long long& step, int& direction) {
+    if (!hasEvent)
+        return false;
+    threshold = eventThreshold;
+    step = eventStep;
+    direction = eventDirection;
+    return true;
+}
+
+void ReferenceCalcOneDimComForceKernel::resetThresholdEvent(ContextImpl& context) {
+    hasEvent = false;
+    hasLastDisplacement = false;
+}
+
+double ReferenceCalcOneDimComForceKernel::executeCached(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    return applyForces(context, includeForces, includeEnergy);
+}
+
+double ReferenceCalcOneDimComForceKernel::executeCollectiveVariable(ContextImpl& context, bool reduce, bool includeForces, bool includeEnergy) {
+    if (reduce)
+        computeDisplacement(context);
+    if (includeForces)
+        scatter(extractForces(context), 1.0);
+    return (includeEnergy ? displacement : 0.0);
+}
+
+double ReferenceCalcOneDimComForceKernel::executeStride(ContextImpl& context, bool reduce, double forceScale, bool includeEnergy) {
+    if (reduce) {
+        computeDisplacement(context);
+        accumulateWork();
+    }
+    if (forceScale != 0.0)
+        scatter(extractForces(context), forceScale*forceConst*(displacement-r0));
+    if (!includeEnergy)
+        return 0.0;
+    double current = (reduce ? displacement : this->reduce(extractPositions(context)));
+    return 0.5*forceConst*(current-r0)*(current-r0);
+}
+
+double ReferenceCalcOneDimComForceKernel::applyForces(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    accumulateWork();
+    if (includeForces) {
+        scatter(extractForces(context), forceConst*(displacement-r0));
+        if (varianceEnd > varianceStart)
+            applyVarianceForces(context);
+    }
+    if (!includeEnergy)
+        return 0.0;
+    double energy = 0.5*forceConst*(displacement-r0)*(displacement-r0);
+    if (varianceEnd > varianceStart)
+        energy += 0.5*varianceForceConst*(variance-variance0)*(variance-variance0);
+    return energy;
+}
+
+double ReferenceCalcOneDimComForceKernel::getDisplacement(ContextImpl& context) {
+    return displacement;
+}
+
+double ReferenceCalcOneDimComForceKernel::computeDisplacement(ContextImpl& context) {
+    // the moments come from the same pass, so they stay in step with the
+    // displacement for the energy of the variance restraint
+    if (varianceEnd > varianceStart)
+        computeMoments(context);
+    else
+        displacement = reduce(extractPositions(context));
+    keepCoordinates(extractPositions(context));
+    return displacement;
+}
+
+void ReferenceCalcOneDimComForceKernel::refreshDisplacement(ContextImpl& context) {
+    // the coordinates are compared directly rather than through a checksum,
+    // since on the host that costs no more
+    const vector<Vec3>& pos = extractPositions(context);
+    bool changed = (keptCoordinates.size() != indices.size());
+    for (int i=0; i<indices.size() && !changed; ++i)
+        changed = (pos[indices[i]][0] != keptCoordinates[i]);
+    if (changed)
+        computeDisplacement(context);
+}
+
+void ReferenceCalcOneDimComForceKernel::keepCoordinates(const vector<Vec3>& pos) {
+    keptCoordinates.resize(indices.size());
+    for (int i=0; i<indices.size(); ++i)
+        keptCoordinates[i] = pos[indices[i]][0];
+}
+
+void ReferenceCalcOneDimComForceKernel::applyConstraint(ContextImpl& context, double stepSize) {
+    // an atom in both groups moves with its combined weight, so the
+    // projection works over the distinct atoms
+    vector<Vec3>& pos = extractPositions(context);
+    vector<Vec3>& vel = extractVelocities(context);
+    double inverseMassSum = 0.0;
+    for (int i=0; i<scatterAtoms.size(); ++i)
+        inverseMassSum += scatterWeights[i]*scatterWeights[i]*inverseMasses[i];
+    if (inverseMassSum == 0.0)
+        return;
+
+    // see applyOneDimComConstraint() in the CUDA platform
+    double lambda = (computeDisplacement(context)-r0)/inverseMassSum;
+    for (int i=0; i<scatterAtoms.size(); ++i)
+        pos[scatterAtoms[i]][0] += lambda*scatterWeights[i]*inverseMasses[i];
+    double velocity = 0.0;
+    for (int i=0; i<scatterAtoms.size(); ++i)
+        velocity -= vel[scatterAtoms[i]][0]*scatterWeights[i];
+    double mu = velocity/inverseMassSum;
+    for (int i=0; i<scatterAtoms.size(); ++i)
+        vel[scatterAtoms[i]][0] += mu*scatterWeights[i]*inverseMasses[i];
+    displacement = r0;
+    keepCoordinates(pos);
+    constraintForce = -lambda/(stepSize*stepSize);
+}
+
+double ReferenceCalcOneDimComForceKernel::getConstraintForce(ContextImpl& context) {
+    return constraintForce;
+}
+
+void ReferenceCalcOneDimComForceKernel::copyParametersToContext(ContextImpl& context, const OneDimComForce& force) {
+    setParameters(force);
+}
+
+void ReferenceCalcOneDimComForceKernel::setParameters(const OneDimComForce& force) {
+    OneDimComReduction reduction(force);
+    indices = reduction.getIndices();
+    keptCoordinates.clear();
+
+    // forces are scattered over the distinct atoms, with the weights of an
+    // atom that is in both groups combined
+    map<int, int> atomSlots;
+    scatterSlots.resize(indices.size());
+    scatterAtoms.clear();
+    for (int i=0; i<indices.size(); ++i) {
+        map<int, int>::iterator slot = atomSlots.find(indices[i]);
+        if (slot == atomSlots.end()) {
+            slot = atomSlots.insert(make_pair(indices[i], (int) scatterAtoms.size())).first;
+            scatterAtoms.push_back(indices[i]);
+        }
+        scatterSlots[i] = slot->second;
+    }
+    inverseMasses.resize(scatterAtoms.size());
+    for (int i=0; i<scatterAtoms.size(); ++i) {
+        double mass = system.getParticleMass(scatterAtoms[i]);
+        inverseMasses[i] = (mass == 0.0 ? 0.0 : 1.0/mass);
+    }
+
+    int numSets = force.getNumParameterSets();
+    setWeights.resize(numSets*indices.size());
+    setScatterWeights.assign(numSets*scatterAtoms.size(), 0.0f);
+    setForceConsts.resize(numSets);
+    setR0s.resize(numSets);
+    for (int i=0; i<numSets; ++i) {
+        OneDimComReduction setReduction(force, i);
+        copy(setReduction.getWeights().begin(), setReduction.getWeights().end(), setWeights.begin()+i*indices.size());
+        for (int j=0; j<indices.size(); ++j)
+            setScatterWeights[i*scatterAtoms.size()+scatterSlots[j]] += setReduction.getWeights()[j];
+        float k, r;
+        vector<float> weights1, weights2;
+        force.getParameterSet(i, k, r, weights1, weights2);
+        setForceConsts[i] = k;
+        setR0s[i] = r;
+    }
+    if (activeSet >= numSets)
+        activeSet = 0;
+    setActiveParameterSet(activeSet);
+    int numGroup1 = force.getGroup1Indices().size();
+    varianceStart = (force.getVarianceGroup() == 2 ? numGroup1 : 0);
+    varianceEnd = (force.getVarianceGroup() == 0 ? 0 : force.getVarianceGroup() == 1 ? numGroup1 : indices.size());
+    varianceForceConst = force.getVarianceForceConst();
+    variance0 = force.getVariance0();
+    thresholds.resize(force.getNumThresholds());
+    for (int i=0; i<thresholds.size(); ++i)
+        thresholds[i] = force.getThreshold(i);
+}
+
+void ReferenceCalcOneDimComForceKernel::setActiveParameterSet(int index) {
+    activeSet = index;
+    weights = (setWeights.empty() ? NULL : &setWeights[index*indices.size()]);
+    scatterWeights = (setScatterWeights.empty() ? NULL : &setScatterWeights[index*scatterAtoms.size()]);
+    forceConst = setForceConsts[index];
+    r0 = setR0s[index];
+}
+
+void ReferenceCalcOneDimComForceKernel::setActiveParameterSet(ContextImpl& context, int index) {
+    setActiveParameterSet(index);
+}
+
+ReferenceCalcOneDimComCombinationForceKernel::ReferenceCalcOneDimComCombinationForceKernel(std::string name, const Platform& platform) :
+        CalcOneDimComCombinationForceKernel(name, platform), forceConst(0.0), r0(0.0) {
+}
+
+void ReferenceCalcOneDimComCombinationForceKernel::initialize(const System& system, const OneDimComCombinationForce& force) {
+    OneDimComReduction reduction(force);
+    indices = reduction.getIndices();
+    weights = reduction.getWeights();
+    forceConst = force.getForceConst();
+    r0 = force.getR0();
+}
+
+double ReferenceCalcOneDimComCombinationForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    vector<Vec3>& pos = extractPositions(context);
+    vector<Vec3>& force = extractForces(context);
+    double displacement = 0.0;
+    for (int i=0; i<indices.size(); ++i)
+        displacement -= pos[indices[i]][0]*weights[i];
+    double factor = forceConst*(displacement-r0);
+    for (int i=0; i<indices.size(); ++i)
+        force[indices[i]][0] += factor*weights[i];
+    return 0.5*forceConst*(displacement-r0)*(displacement-r0);
+}
+
+void ReferenceCalcOneDimComCombinationForceKernel::copyParametersToContext(ContextImpl& context, const OneDimComCombinationForce& force) {
+    OneDimComReduction reduction(force);
+    if (reduction.getNumAtoms() != indices.size())
+        throw OpenMMException("updateParametersInContext: The number of atoms in the groups has changed");
+    indices = reduction.getIndices();
+    weights = reduction.getWeights();
+    forceConst = force.getForceConst();
+    r0 = force.getR0();
+}
+
+/**
+ * The weight of an atom in the region.  This matches switchOneDimComRegion() in the CUDA platform.
+ */
+static double switchRegion(double x, double lower, double upper, double width, double& dsdx) {
+    double t, sign;
+    if (x < lower) {
+        t = (x-(lower-width))/width;
+        sign = 1.0;
+    }
+    else if (x > upper) {
+        t = ((upper+width)-x)/width;
+        sign = -1.0;
+    }
+    else {
+        dsdx = 0.0;
+        return 1.0;
+    }
+    if (t <= 0.0) {
+        dsdx = 0.0;
+        return 0.0;
+    }
+    dsdx = sign*6.0*t*(1.0-t)/width;
+    return t*t*(3.0-2.0*t);
+}
+
+/**
+ * The factor the restraint is scaled by for a region of a given switched mass.
+ * This matches fadeOneDimComRegion() in the CUDA platform.
+ */
+static double fadeRegion(double mass, double fadeMass, double& dfdm) {
+    if (mass >= fadeMass) {
+        dfdm = 0.0;
+        return 1.0;
+    }
+    double t = mass/fadeMass;
+    dfdm = 6.0*t*(1.0-t)/fadeMass;
+    return t*t*(3.0-2.0*t);
+}
+
+ReferenceCalcOneDimComRegionForceKernel::ReferenceCalcOneDimComRegionForceKernel(std::string name, const Platform& platform) :
+        CalcOneDimComRegionForceKernel(name, platform), fadeMass(0.0), lower(0.0), upper(0.0), switchWidth(0.0), skin(0.0), forceConst(0.0), r0(0.0) {
+}
+
+void ReferenceCalcOneDimComRegionForceKernel::setParameters(const OneDimComRegionForce& force) {
+    weights1 = force.getGroup1Weights();
+    lower = force.getLower();
+    upper = force.getUpper();
+    switchWidth = force.getSwitchWidth();
+    skin = force.getSkin();
+    forceConst = force.getForceConst();
+    r0 = force.getR0();
+}
+
+void ReferenceCalcOneDimComRegionForceKernel::initialize(const System& system, const OneDimComRegionForce& force) {
+    group1 = force.getGroup1Indices();
+    candidates = force.getCandidates();
+    candidateMasses.resize(candidates.size());
+    fadeMass = 0.0;
+    for (int i=0; i<candidates.size(); ++i) {
+        candidateMasses[i] = system.getParticleMass(candidates[i]);
+        if (candidateMasses[i] > 0.0 && (fadeMass == 0.0 || candidateMasses[i] < fadeMass))
+            fadeMass = candidateMasses[i];
+    }
+    setParameters(force);
+}
+
+void ReferenceCalcOneDimComRegionForceKernel::refreshRegion(ContextImpl& context, bool force) {
+    vector<Vec3>& pos = extractPositions(context);
+    bool moved = (force || refreshPositions.size() != candidates.size());
+    for (int i=0; i<candidates.size() && !moved; ++i)
+        moved = (fabs(pos[candidates[i]][0]-refreshPositions[i]) > 0.5*skin);
+    if (!moved)
+        return;
+    double lowerCutoff = lower-switchWidth-skin;
+    double upperCutoff = upper+switchWidth+skin;
+    activeCandidates.clear();
+    refreshPositions.resize(candidates.size());
+    for (int i=0; i<candidates.size(); ++i) {
+        double x = pos[candidates[i]][0];
+        refreshPositions[i] = x;
+        if (x >= lowerCutoff && x <= upperCutoff)
+            activeCandidates.push_back(i);
+    }
+}
+
+double ReferenceCalcOneDimComRegionForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    if (group1.size() == 0 || candidates.size() == 0)
+        return 0.0;
+    vector<Vec3>& pos = extractPositions(context);
+    vector<Vec3>& force = extractForces(context);
+    double center1 = 0.0;
+    for (int i=0; i<group1.size(); ++i)
+        center1 += pos[group1[i]][0]*weights1[i];
+    double regionSum = 0.0, regionMass = 0.0;
+    for (int i=0; i<activeCandidates.size(); ++i) {
+        int candidate = activeCandidates[i];
+        double x = pos[candidates[candidate]][0];
+        double dsdx;
+        double weight = switchRegion(x, lower, upper, switchWidth, dsdx)*candidateMasses[candidate];
+        regionSum += weight*x;
+        regionMass += weight;
+    }
+
+    // an empty region has no center, so it contributes nothing, and the
+    // restraint fades out before that so the energy stays continuous
+    if (regionMass == 0.0)
+        return 0.0;
+    double dfdm;
+    double fade = fadeRegion(regionMass, fadeMass, dfdm);
+    double center = regionSum/regionMass;
+    double displacement = center-center1;
+    double energy = 0.5*forceConst*(displacement-r0)*(displacement-r0);
+    double factor = fade*forceConst*(displacement-r0);
+    for (int i=0; i<group1.size(); ++i)
+        force[group1[i]][0] += factor*weights1[i];
+    for (int i=0; i<activeCandidates.size(); ++i) {
+        int candidate = activeCandidates[i];
+        int atom = candidates[candidate];
+        double x = pos[atom][0];
+        double dsdx;
+        double s = switchRegion(x, lower, upper, switchWidth, dsdx);
+        force[atom][0] -= factor*candidateMasses[candidate]*(s+dsdx*(x-center))/regionMass+energy*dfdm*candidateMasses[candidate]*dsdx;
+    }
+    return fade*energy;
+}
+
+void ReferenceCalcOneDimComRegionForceKernel::copyParametersToContext(ContextImpl& context, const OneDimComRegionForce& force) {
+    if (force.getGroup1Indices().size() != group1.size() || force.getCandidates().size() != candidates.size())
+        throw OpenMMException("updateParametersInContext: The number of atoms in the groups has changed");
+    setParameters(force);
+}
+
+ReferenceCalcOneDimComPairwiseForceKernel::ReferenceCalcOneDimComPairwiseForceKernel(std::string name, const Platform& platform) :
+        CalcOneDimComPairwiseForceKernel(name, platform) {
+}
+
+void ReferenceCalcOneDimComPairwiseForceKernel::setParameters(const OneDimComPairwiseForce& force) {
+    groupStarts.assign(1, 0);
+    atoms.clear();
+    weights.clear();
+    for (int i=0; i<force.getNumGroups(); ++i) {
+        atoms.insert(atoms.end(), force.getGroupIndices(i).begin(), force.getGroupIndices(i).end());
+        weights.insert(weights.end(), force.getGroupWeights(i).begin(), force.getGroupWeights(i).end());
+        groupStarts.push_back(atoms.size());
+    }
+    int numPairs = force.getNumPairs();
+    pairGroup1.resize(numPairs);
+    pairGroup2.resize(numPairs);
+    pairType.resize(numPairs);
+    pairForceConst.resize(numPairs);
+    pairR0.resize(numPairs);
+    for (int i=0; i<numPairs; ++i) {
+        float k, r0;
+        OneDimComPairwiseForce::PairType type;
+        force.getPairParameters(i, pairGroup1[i], pairGroup2[i], k, r0, type);
+        pairForceConst[i] = k;
+        pairR0[i] = r0;
+        pairType[i] = type;
+    }
+    centers.resize(force.getNumGroups());
+    centerForces.resize(force.getNumGroups());
+}
+
+void ReferenceCalcOneDimComPairwiseForceKernel::initialize(const System& system, const OneDimComPairwiseForce& force) {
+    setParameters(force);
+}
+
+double ReferenceCalcOneDimComPairwiseForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    if (!includeForces && !includeEnergy)
+        return 0.0;
+    vector<Vec3>& pos = extractPositions(context);
+    vector<Vec3>& force = extractForces(context);
+    int numGroups = centers.size();
+
+    // each group is reduced once, however many pairs use it
+    for (int i=0; i<numGroups; ++i) {
+        centers[i] = 0.0;
+        for (int j=groupStarts[i]; j<groupStarts[i+1]; ++j)
+            centers[i] += pos[atoms[j]][0]*weights[j];
+        centerForces[i] = 0.0;
+    }
+
+    // the pairs only accumulate a force on each center
+    double energy = 0.0;
+    for (int i=0; i<pairGroup1.size(); ++i) {
+        double delta = centers[pairGroup2[i]]-centers[pairGroup1[i]]-pairR0[i];
+        if ((pairType[i] == OneDimComPairwiseForce::LowerWall && delta > 0.0) || (pairType[i] == OneDimComPairwiseForce::UpperWall && delta < 0.0))
+            continue;
+        energy += 0.5*pairForceConst[i]*delta*delta;
+        double factor = pairForceConst[i]*delta;
+        centerForces[pairGroup1[i]] += factor;
+        centerForces[pairGroup2[i]] -= factor;
+    }
+
+    if (includeForces) {
+        for (int i=0; i<numGroups; ++i) {
+            if (centerForces[i] == 0.0)
+                continue;
+            for (int j=groupStarts[i]; j<groupStarts[i+1]; ++j)
+                force[atoms[j]][0] += centerForces[i]*weights[j];
+        }
+    }
+    return (includeEnergy ? energy : 0.0);
+}
+
+void ReferenceCalcOneDimComPairwiseForceKernel::copyParametersToContext(ContextImpl& context, const OneDimComPairwiseForce& force) {
+    if (force.getNumGroups() != centers.size())
+        throw OpenMMException("updateParametersInContext: The number of groups has changed");
+    for (int i=0; i<force.getNumGroups(); ++i)
+        if (force.getGroupIndices(i).size() != groupStarts[i+1]-groupStarts[i])
+            throw OpenMMException("updateParametersInContext: The number of atoms in the groups has changed");
+    setParameters(force);
+}
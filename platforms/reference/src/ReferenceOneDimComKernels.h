@@ -0,0 +1,396 @@
+#ifndef REFERENCE_ONEDIMCOM_KERNELS_H_
+#define REFERENCE_ONEDIMCOM_KERNELS_H_
+
+#include "OneDimComKernels.h"
+#include "openmm/Platform.h"
+#include "openmm/Vec3.h"
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace OpenMM {
+class ThreadPool;
+}
+
+namespace OneDimComPlugin {
+
+/**
+ * This kernel is invoked by OneDimComForce to calculate the forces acting on the system and the energy of the system.
+ */
+class ReferenceCalcOneDimComForceKernel : public CalcOneDimComForceKernel {
+public:
+    ReferenceCalcOneDimComForceKernel(std::string name, const OpenMM::Platform& platform, const OpenMM::System& system);
+    ~ReferenceCalcOneDimComForceKernel();
+    /**
+     * Initialize the kernel.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param force      the OneDimComForce this kernel will be used for
+     */
+    void initialize(const OpenMM::System& system, const OneDimComForce& force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(OpenMM::ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Execute the kernel reusing the displacement kept by the most recent evaluation.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double executeCached(OpenMM::ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Execute the kernel with the displacement itself as the energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param reduce         true if the displacement should be computed from the current positions
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double executeCollectiveVariable(OpenMM::ContextImpl& context, bool reduce, bool includeForces, bool includeEnergy);
+    /**
+     * Execute the kernel for a force that is only evaluated every few steps.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param reduce         true if the displacement should be computed from the current positions and kept
+     * @param forceScale     the factor to multiply the forces by, or 0 to apply none
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double executeStride(OpenMM::ContextImpl& context, bool reduce, double forceScale, bool includeEnergy);
+    /**
+     * Get the displacement computed by the most recent call to execute().
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    double getDisplacement(OpenMM::ContextImpl& context);
+    /**
+     * Compute the displacement for the current positions without applying any forces or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @return the displacement
+     */
+    double computeDisplacement(OpenMM::ContextImpl& context);
+    /**
+     * Make sure the kept displacement belongs to the current positions, computing it
+     * again only if the coordinates of the group atoms have changed.
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    void refreshDisplacement(OpenMM::ContextImpl& context);
+    /**
+     * Project the group atoms so the displacement is exactly r0.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param stepSize       the size of the step that produced the current positions
+     */
+    void applyConstraint(OpenMM::ContextImpl& context, double stepSize);
+    /**
+     * Get the constraint force from the most recent call to applyConstraint().
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    double getConstraintForce(OpenMM::ContextImpl& context);
+    /**
+     * Get a description of the strategy chosen for reducing the groups.
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    std::string getExecutionStrategy(OpenMM::ContextImpl& context);
+    /**
+     * Switch to another parameter set.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param index          the index of the set to use
+     */
+    void setActiveParameterSet(OpenMM::ContextImpl& context, int index);
+    /**
+     * Override the force constant and r0 of the active set.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param k              the force constant to use
+     * @param r0             the equilibrium displacement to use
+     * @param doesWork       true if the change should be counted as work
+     */
+    void setScheduledParameters(OpenMM::ContextImpl& context, double k, double r0, bool doesWork);
+    /**
+     * Override the parameters of the active set with published ones, leaving the set
+     * itself unchanged.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param k              the force constant to use
+     * @param r0             the equilibrium displacement to use
+     * @param weights1       the weights of the group 1 atoms, or an empty vector to keep them
+     * @param weights2       the weights of the group 2 atoms, or an empty vector to keep them
+     */
+    void setPublishedParameters(OpenMM::ContextImpl& context, double k, double r0,
+            const std::vector<float>& weights1, const std::vector<float>& weights2);
+    /**
+     * Get the work accumulated from changes in the parameters.
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    double getWork(OpenMM::ContextImpl& context);
+    /**
+     * Get the variance of the restrained group from the last evaluation.
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    double getVariance(OpenMM::ContextImpl& context);
+    /**
+     * Start copying the displacement and variance of the last evaluation to the host.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param reduce         true if the displacement should first be computed from the current positions
+     */
+    void recordDisplacement(OpenMM::ContextImpl& context, bool reduce);
+    /**
+     * Collect the oldest displacement and variance started by recordDisplacement().
+     *
+     * @param context        the context in which to execute this kernel
+     * @param wait           true to wait for the copy to finish
+     * @param displacement   on exit, the recorded displacement
+     * @param variance       on exit, the recorded variance
+     * @return true if a displacement was collected
+     */
+    bool getRecordedDisplacement(OpenMM::ContextImpl& context, bool wait, double& displacement, double& variance);
+    /**
+     * Set the accumulated work to 0.
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    void resetWork(OpenMM::ContextImpl& context);
+    /**
+     * Record the first threshold crossed since the last evaluation.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param step           the step of the last evaluation
+     */
+    void checkThresholds(OpenMM::ContextImpl& context, long long step);
+    /**
+     * Get the recorded threshold crossing.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param threshold      on exit, the index of the threshold that was crossed
+     * @param step           on exit, the step it was crossed on
+     * @param direction      on exit, the direction it was crossed in
+     * @return true if a crossing was recorded
+     */
+    bool getThresholdEvent(OpenMM::ContextImpl& context, int& threshold, long long& step, int& direction);
+    /**
+     * Clear the recorded crossing.
+     *
+     * @param context        the context in which to execute this kernel
+     */
+    void resetThresholdEvent(OpenMM::ContextImpl& context);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the OneDimComForce to copy the parameters from
+     */
+    void copyParametersToContext(OpenMM::ContextImpl& context, const OneDimComForce& force);
+private:
+    enum Strategy {Serial, Vectorized, Threaded};
+    class ReduceTask;
+    class ScatterTask;
+    void setParameters(const OneDimComForce& force);
+    void setActiveParameterSet(int index);
+    void chooseStrategy();
+    double reduce(const std::vector<OpenMM::Vec3>& pos, int start, int end) const;
+    double reduce(const std::vector<OpenMM::Vec3>& pos);
+    void scatter(std::vector<OpenMM::Vec3>& force, double factor, int start, int end) const;
+    void scatter(std::vector<OpenMM::Vec3>& force, double factor);
+    double applyForces(OpenMM::ContextImpl& context, bool includeForces, bool includeEnergy);
+    void computeMoments(OpenMM::ContextImpl& context);
+    void applyVarianceForces(OpenMM::ContextImpl& context);
+    void accumulateWork();
+    void keepCoordinates(const std::vector<OpenMM::Vec3>& pos);
+    const OpenMM::System& system;
+    Strategy strategy;
+    OpenMM::ThreadPool* threads;
+    std::vector<int> indices;
+    // the weights of every parameter set one after another, and the
+    // ones of the active set
+    std::vector<float> setWeights;
+    const float* weights;
+    // the distinct group atoms that forces are added to, and their combined
+    // weights in every parameter set and in the active one
+    std::vector<int> scatterAtoms;
+    // the position in scatterAtoms of each entry of indices
+    std::vector<int> scatterSlots;
+    std::vector<float> setScatterWeights;
+    const float* scatterWeights;
+    // published weights, which the active ones point to until the set is
+    // switched or the parameters are copied again
+    std::vector<float> publishedWeights, publishedScatterWeights;
+    std::vector<double> setForceConsts, setR0s;
+    int activeSet;
+    // the inverse mass of each entry of scatterAtoms
+    std::vector<double> inverseMasses;
+    double forceConst, r0;
+    double displacement, constraintForce;
+    // the x coordinate of each entry of indices when displacement was computed
+    std::vector<double> keptCoordinates;
+    // the displacements and variances recorded but not yet collected
+    std::deque<std::pair<double, double> > records;
+    // the range of indices whose variance is restrained, which is empty when
+    // there is no variance restraint, and the moments of the last evaluation
+    // relative to the first atom of the range
+    int varianceStart, varianceEnd;
+    double varianceForceConst, variance0;
+    double varianceOrigin, varianceMean, variance;
+    // the parameters of the previous evaluation, and the work done by
+    // changing them since
+    bool hasWorkParameters;
+    double workForceConst, workR0, work;
+    // the thresholds, the displacement they were last compared with, and
+    // the first crossing
+    std::vector<double> thresholds;
+    bool hasLastDisplacement, hasEvent;
+    double lastDisplacement;
+    int eventThreshold, eventDirection;
+    long long eventStep;
+};
+
+/**
+ * This kernel is invoked by OneDimComCombinationForce to calculate the forces acting on the system and the energy of the system.
+ */
+class ReferenceCalcOneDimComCombinationForceKernel : public CalcOneDimComCombinationForceKernel {
+public:
+    ReferenceCalcOneDimComCombinationForceKernel(std::string name, const OpenMM::Platform& platform);
+    /**
+     * Initialize the kernel.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param force      the OneDimComCombinationForce this kernel will be used for
+     */
+    void initialize(const OpenMM::System& system, const OneDimComCombinationForce& force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(OpenMM::ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the OneDimComCombinationForce to copy the parameters from
+     */
+    void copyParametersToContext(OpenMM::ContextImpl& context, const OneDimComCombinationForce& force);
+private:
+    std::vector<int> indices;
+    std::vector<float> weights;
+    double forceConst, r0;
+};
+
+/**
+ * This kernel is invoked by OneDimComRegionForce to calculate the forces acting on the system and the energy of the system.
+ */
+class ReferenceCalcOneDimComRegionForceKernel : public CalcOneDimComRegionForceKernel {
+public:
+    ReferenceCalcOneDimComRegionForceKernel(std::string name, const OpenMM::Platform& platform);
+    /**
+     * Initialize the kernel.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param force      the OneDimComRegionForce this kernel will be used for
+     */
+    void initialize(const OpenMM::System& system, const OneDimComRegionForce& force);
+    /**
+     * Rebuild the list of candidate atoms close enough to the region to be evaluated,
+     * if asked to or if any candidate has moved further than half the skin since the
+     * list was last built.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param force          true if the list must be rebuilt regardless of how far the candidates have moved
+     */
+    void refreshRegion(OpenMM::ContextImpl& context, bool force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(OpenMM::ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the OneDimComRegionForce to copy the parameters from
+     */
+    void copyParametersToContext(OpenMM::ContextImpl& context, const OneDimComRegionForce& force);
+private:
+    void setParameters(const OneDimComRegionForce& force);
+    std::vector<int> group1;
+    std::vector<float> weights1;
+    std::vector<int> candidates;
+    std::vector<double> candidateMasses;
+    std::vector<int> activeCandidates;
+    // the position of each candidate when the active list was last built
+    std::vector<double> refreshPositions;
+    // the switched mass below which the restraint is faded out, which is
+    // that of the lightest candidate
+    double fadeMass;
+    double lower, upper, switchWidth, skin;
+    double forceConst, r0;
+};
+
+/**
+ * This kernel is invoked by OneDimComPairwiseForce to calculate the forces acting on the system and the energy of the system.
+ */
+class ReferenceCalcOneDimComPairwiseForceKernel : public CalcOneDimComPairwiseForceKernel {
+public:
+    ReferenceCalcOneDimComPairwiseForceKernel(std::string name, const OpenMM::Platform& platform);
+    /**
+     * Initialize the kernel.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param force      the OneDimComPairwiseForce this kernel will be used for
+     */
+    void initialize(const OpenMM::System& system, const OneDimComPairwiseForce& force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(OpenMM::ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the OneDimComPairwiseForce to copy the parameters from
+     */
+    void copyParametersToContext(OpenMM::ContextImpl& context, const OneDimComPairwiseForce& force);
+private:
+    void setParameters(const OneDimComPairwiseForce& force);
+    // the atoms of all groups one after the other, with group i in
+    // [groupStarts[i], groupStarts[i+1])
+    std::vector<int> groupStarts, atoms;
+    std::vector<float> weights;
+    std::vector<int> pairGroup1, pairGroup2, pairType;
+    std::vector<double> pairForceConst, pairR0;
+    std::vector<double> centers, centerForces;
+};
+
+} // namespace OneDimComPlugin
+
+#endif /*REFERENCE_ONEDIMCOM_KERNELS_H_*/
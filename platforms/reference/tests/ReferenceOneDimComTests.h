@@ -0,0 +1,20 @@
+#ifndef REFERENCE_ONEDIMCOM_TESTS_H_
+#define REFERENCE_ONEDIMCOM_TESTS_H_
+
+/**
+ * The platform the shared tests in the top level tests directory run on.
+ */
+
+#include "openmm/Platform.h"
+#include "openmm/internal/windowsExport.h"
+#include <string>
+
+extern "C" OPENMM_EXPORT void registerOneDimComReferenceKernelFactories();
+
+const std::string platformName = "Reference";
+
+void initializeTests(int argc, char* argv[]) {
+    registerOneDimComReferenceKernelFactories();
+}
+
+#endif /*REFERENCE_ONEDIMCOM_TESTS_H_*/
@@ -0,0 +1,288 @@
+#include "ReferenceOneDimComTests.h"
+#include "TestOneDimComForce.h"
+#include "OneDimComForce.h"
+#include "OneDimComCombinationForce.h"
+#include "OneDimComRegionForce.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/Context.h"
+#include "openmm/CustomExternalForce.h"
+#include "openmm/Platform.h"
+#include "openmm/System.h"
+#include "openmm/VerletIntegrator.h"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+void testTwoParticles() {
+    System system;
+    vector<Vec3> positions(3);
+
+    // three particles, but the middle one is not included
+    // int the force in order to catch stupid indexing errors
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    positions[0] = Vec3(1.0, 0.0, 0.0);
+    positions[1] = Vec3(200.0, 0.0, 0.0);
+    positions[2] = Vec3(2.0, 0.0, 0.0);
+
+    vector<int> group1;
+    vector<int> group2;
+    vector<float> weights1;
+    vector<float> weights2;
+    group1.push_back(0);
+    group2.push_back(2);
+    weights1.push_back(1.0);
+    weights2.push_back(1.0);
+
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights1, weights2, 1.0, 2.0);
+    system.addForce(force);
+
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName("Reference");
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(0.5, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(-1.0, state.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[1][0], 1e-5);
+    ASSERT_EQUAL_TOL(1.0, state.getForces()[2][0], 1e-5);
+    ASSERT_EQUAL_TOL(1.0, force->getDisplacement(context), 1e-5);
+}
+
+void testOverlappingGroups() {
+    // particle 1 is in both groups, so its forces cancel
+    System system;
+    vector<Vec3> positions(3);
+    for (int i=0; i<3; ++i)
+        system.addParticle(1.0);
+    positions[0] = Vec3(0.0, 0.0, 0.0);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    positions[2] = Vec3(3.0, 0.0, 0.0);
+    vector<int> group1, group2;
+    group1.push_back(0);
+    group1.push_back(1);
+    group2.push_back(1);
+    group2.push_back(2);
+    vector<float> weights(2, 0.5);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights, weights, 2.0, 1.0);
+    system.addForce(force);
+
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName("Reference");
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(0.25, state.getPotentialEnergy(), 1e-6);
+    ASSERT_EQUAL_TOL(0.5, state.getForces()[0][0], 1e-6);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[1][0], 1e-6);
+    ASSERT_EQUAL_TOL(-0.5, state.getForces()[2][0], 1e-6);
+}
+
+void checkStrategy(Platform& platform, int numParticlesPerGroup, string& strategy) {
+    // every strategy has to give the same answer, so only its description
+    // depends on the size of the groups
+    System system;
+    vector<Vec3> positions(numParticlesPerGroup * 2);
+    vector<int> group1, group2;
+    vector<float> weights1, weights2;
+    double expected = 0.0;
+    for (int i=0; i<2*numParticlesPerGroup; ++i) {
+        system.addParticle(1.0);
+        positions[i] = Vec3((i%7)*0.25, 0.0, 0.0);
+        if (i < numParticlesPerGroup) {
+            group1.push_back(i);
+            weights1.push_back(1.0 / numParticlesPerGroup);
+            expected -= positions[i][0] / numParticlesPerGroup;
+        }
+        else {
+            group2.push_back(i);
+            weights2.push_back(1.0 / numParticlesPerGroup);
+            expected += positions[i][0] / numParticlesPerGroup;
+        }
+    }
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights1, weights2, 1.0, 2.0);
+    system.addForce(force);
+
+    VerletIntegrator integrator(1.0);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(expected, force->getDisplacement(context), 1e-4);
+    ASSERT_EQUAL_TOL(0.5*(expected-2.0)*(expected-2.0), state.getPotentialEnergy(), 1e-4);
+    ASSERT_EQUAL_TOL((expected-2.0) / numParticlesPerGroup, state.getForces()[0][0], 1e-4);
+    strategy = force->getExecutionStrategy(context);
+}
+
+void testExecutionStrategy() {
+    Platform& platform = Platform::getPlatformByName("Reference");
+    const int sizes[] = {3, 500, 100000};
+    for (int i=0; i<3; ++i) {
+        string strategy, repeated;
+        checkStrategy(platform, sizes[i], strategy);
+        ASSERT(strategy.size() > 0);
+
+        // the choice is remembered for the size class
+        checkStrategy(platform, sizes[i], repeated);
+        ASSERT_EQUAL(strategy, repeated);
+    }
+}
+
+void testConstraint() {
+    // see testConstraint() in the CUDA tests
+    System system;
+    vector<Vec3> positions(2);
+    system.addParticle(1.0);
+    system.addParticle(2.0);
+    positions[0] = Vec3(-0.75, 0.0, 0.0);
+    positions[1] = Vec3(0.75, 0.0, 0.0);
+
+    vector<int> group1(1, 0);
+    vector<int> group2(1, 1);
+    vector<float> weights(1, 1.0);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights, weights, 1000.0, 1.5);
+    force->setUseConstraint(true);
+    system.addForce(force);
+    CustomExternalForce* pull = new CustomExternalForce("-3*x");
+    pull->addParticle(1);
+    system.addForce(pull);
+
+    VerletIntegrator integrator(0.01);
+    Platform& platform = Platform::getPlatformByName("Reference");
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    integrator.step(1);
+    for (int i=0; i<20; ++i) {
+        integrator.step(1);
+        ASSERT_EQUAL_TOL(-1.0, force->getConstraintForce(context), 1e-5);
+        ASSERT_EQUAL_TOL(1.5+1.5*0.01*0.01, force->getDisplacement(context), 1e-5);
+    }
+}
+
+void testCombination() {
+    // a peptide relative to the average of two leaflets
+    System system;
+    vector<Vec3> positions(5);
+    for (int i=0; i<5; ++i)
+        system.addParticle(1.0);
+    positions[0] = Vec3(3.0, 0.0, 0.0);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    positions[2] = Vec3(2.0, 0.0, 0.0);
+    positions[3] = Vec3(5.0, 0.0, 0.0);
+    positions[4] = Vec3(5.0, 0.0, 0.0);
+
+    OneDimComCombinationForce* force = new OneDimComCombinationForce(2.0, -1.0);
+    force->addGroup(vector<int>(1, 0), vector<float>(1, 1.0), 1.0);
+    vector<int> leaflet(2);
+    vector<float> leafletWeights(2, 0.5);
+    leaflet[0] = 1;
+    leaflet[1] = 2;
+    force->addGroup(leaflet, leafletWeights, -0.5);
+    leaflet[0] = 3;
+    leaflet[1] = 4;
+    force->addGroup(leaflet, leafletWeights, -0.5);
+    system.addForce(force);
+
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName("Reference");
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+
+    // X = 3 - 0.5*1.5 - 0.5*5 = -0.25
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(0.5*2.0*0.75*0.75, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(-1.5, state.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.375, state.getForces()[1][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.375, state.getForces()[4][0], 1e-5);
+}
+
+void testRegion() {
+    // see testInsideSlab() in the CUDA tests
+    System system;
+    vector<Vec3> positions(5);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    system.addParticle(3.0);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    positions[0] = Vec3(0.0, 0.0, 0.0);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    positions[2] = Vec3(1.4, 0.0, 0.0);
+    positions[3] = Vec3(5.0, 0.0, 0.0);
+    positions[4] = Vec3(-3.0, 0.0, 0.0);
+
+    vector<int> candidates;
+    for (int i=1; i<5; ++i)
+        candidates.push_back(i);
+    system.addForce(new OneDimComRegionForce(vector<int>(1, 0), vector<float>(1, 1.0), candidates, 0.5, 2.0, 2.0, 1.0));
+
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName("Reference");
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(0.09, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(0.6, state.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(-0.15, state.getForces()[1][0], 1e-5);
+    ASSERT_EQUAL_TOL(-0.45, state.getForces()[2][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[3][0], 1e-5);
+
+    // see testSkin() in the CUDA tests
+    positions[3] = Vec3(1.5, 0.0, 0.0);
+    context.setPositions(positions);
+    context.setTime(1.0);
+    ASSERT_EQUAL_TOL(0.5*2.0*0.34*0.34, context.getState(State::Energy).getPotentialEnergy(), 1e-5);
+}
+
+void testEmptyingRegion() {
+    // see testEmptyingRegion() in the CUDA tests
+    System system;
+    system.addParticle(1.0);
+    system.addParticle(2.0);
+    vector<Vec3> positions(2);
+    OneDimComRegionForce* force = new OneDimComRegionForce(vector<int>(1, 0), vector<float>(1, 1.0), vector<int>(1, 1), 0.5, 2.0, 2.0, 1.0);
+    force->setSwitchWidth(1.0);
+    force->setSkin(1.0);
+    system.addForce(force);
+
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName("Reference");
+    Context context(system, integrator, platform);
+    const double delta = 1e-3;
+    double x[] = {2.2, 2.5, 2.8, 2.95};
+    for (int i=0; i<4; ++i) {
+        positions[1] = Vec3(x[i], 0.0, 0.0);
+        context.setPositions(positions);
+        State state = context.getState(State::Forces);
+        positions[1][0] += delta;
+        context.setPositions(positions);
+        double energyPlus = context.getState(State::Energy).getPotentialEnergy();
+        positions[1][0] -= 2*delta;
+        context.setPositions(positions);
+        double energyMinus = context.getState(State::Energy).getPotentialEnergy();
+        ASSERT_EQUAL_TOL(-(energyPlus-energyMinus)/(2*delta), state.getForces()[1][0], 1e-2);
+    }
+
+    // the restraint has let go by the time the atom leaves
+    positions[1] = Vec3(2.999, 0.0, 0.0);
+    context.setPositions(positions);
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(0.0, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[1][0], 1e-3);
+}
+
+void runPlatformTests() {
+    testTwoParticles();
+    testConstraint();
+    testOverlappingGroups();
+    testExecutionStrategy();
+    testCombination();
+    testRegion();
+    testEmptyingRegion();
+}
@@ -0,0 +1,5 @@
+#include "ReferenceOneDimComTests.h"
+#include "TestOneDimComPairwiseForce.h"
+
+void runPlatformTests() {
+}
@@ -0,0 +1,107 @@
+#include "OneDimComForce.h"
+#include "OneDimComWindowScheduler.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/Context.h"
+#include "openmm/Platform.h"
+#include "openmm/System.h"
+#include "openmm/VerletIntegrator.h"
+#include "openmm/OpenMMException.h"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+extern "C" OPENMM_EXPORT void registerOneDimComReferenceKernelFactories();
+
+OneDimComForce* createSystem(System& system) {
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    vector<int> group1(1, 0);
+    vector<int> group2(1, 1);
+    vector<float> weights(1, 1.0);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights, weights, 0.0, 0.0);
+    system.addForce(force);
+    return force;
+}
+
+void setDisplacement(Context& context, double displacement) {
+    vector<Vec3> positions(2);
+    positions[1] = Vec3(displacement, 0.0, 0.0);
+    context.setPositions(positions);
+}
+
+void testStep() {
+    System system;
+    OneDimComForce* force = createSystem(system);
+    OneDimComWindowScheduler scheduler(system, *force, Platform::getPlatformByName("Reference"), 2);
+    ASSERT_EQUAL(2, scheduler.getNumThreads());
+    for (int i=0; i<5; ++i)
+        scheduler.addWindow(new VerletIntegrator(0.001), 100.0, 0.5*i);
+    ASSERT_EQUAL(5, scheduler.getNumWindows());
+    for (int i=0; i<5; ++i) {
+        ASSERT_EQUAL_TOL(0.5*i, scheduler.getR0(i), 1e-10);
+        setDisplacement(scheduler.getContext(i), 1.0);
+    }
+
+    // every window has been advanced, each under its own restraint
+    scheduler.step(10);
+    vector<double> displacements = scheduler.getDisplacements();
+    for (int i=0; i<5; ++i) {
+        ASSERT_EQUAL_TOL(0.01, scheduler.getContext(i).getState(0).getTime(), 1e-10);
+        if (i < 2) {
+            ASSERT(displacements[i] < 1.0);
+        }
+        else if (i == 2) {
+            ASSERT_EQUAL_TOL(1.0, displacements[i], 1e-10);
+        }
+        else {
+            ASSERT(displacements[i] > 1.0);
+        }
+    }
+}
+
+void testExchange() {
+    System system;
+    OneDimComForce* force = createSystem(system);
+    OneDimComWindowScheduler scheduler(system, *force, Platform::getPlatformByName("Reference"));
+    scheduler.addWindow(new VerletIntegrator(0.001), 10.0, 0.0);
+    scheduler.addWindow(new VerletIntegrator(0.001), 10.0, 1.0);
+    scheduler.setRandomNumberSeed(5);
+
+    // each Context sits at the center of the other window, so swapping
+    // lowers the energy and must be accepted
+    Context& context0 = scheduler.getContext(0);
+    Context& context1 = scheduler.getContext(1);
+    setDisplacement(context0, 1.0);
+    setDisplacement(context1, 0.0);
+    ASSERT_EQUAL_TOL(5.0, context0.getState(State::Energy).getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL(1, scheduler.attemptExchanges(300.0));
+    ASSERT(&scheduler.getContext(0) == &context1);
+    ASSERT(&scheduler.getContext(1) == &context0);
+    ASSERT_EQUAL_TOL(0.0, scheduler.getContext(0).getState(State::Energy).getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(0.0, scheduler.getContext(1).getState(State::Energy).getPotentialEnergy(), 1e-5);
+
+    // the next attempt pairs (1,2), which doesn't exist
+    ASSERT_EQUAL(0, scheduler.attemptExchanges(300.0));
+
+    // swapping back now costs 10 kJ/mol, which is never accepted at 1 K
+    ASSERT_EQUAL(0, scheduler.attemptExchanges(1.0));
+    ASSERT(&scheduler.getContext(0) == &context1);
+}
+
+int main() {
+    try {
+        registerOneDimComReferenceKernelFactories();
+        testStep();
+        testExchange();
+    }
+    catch(const std::exception& e) {
+        std::cout << "exception: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Done" << std::endl;
+    return 0;
+}
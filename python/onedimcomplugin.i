@@ -9,14 +9,25 @@
  * for other STL types like maps.
  */
 
+%include "std_string.i"
 %include "std_vector.i"
+%include "std_map.i"
 namespace std {
+  %template(mapss) map<string, string>;
   %template(vectorf) vector<float>;
   %template(vectori) vector<int>;
+  %template(vectorll) vector<long long>;
+  %template(vectord) vector<double>;
 };
 
 %{
 #include "OneDimComForce.h"
+#include "OneDimComCombinationForce.h"
+#include "OneDimComPairwiseForce.h"
+#include "OneDimComRegionForce.h"
+#include "OneDimComColvarReader.h"
+#include "OneDimComBatchEvaluator.h"
+#include "OneDimComWindowScheduler.h"
 #include "OpenMM.h"
 #include "OpenMMAmoeba.h"
 #include "OpenMMDrude.h"
@@ -32,6 +43,23 @@ namespace std {
 %pythoncode %{
 import simtk.openmm as mm
 import simtk.unit as unit
+
+
+def loadColvarFile(filename):
+    """Load a colvar file written by OneDimComForce.setColvarFile().
+
+    Returns a numpy record array with fields 'step', 'displacement' and 'energy'.
+    """
+    import numpy as np
+    header = np.fromfile(filename, dtype=np.dtype([('magic', 'S8'), ('version', 'i4'), ('recordSize', 'i4')]), count=1)
+    if len(header) != 1 or header['magic'][0] != b'ODCOLVAR':
+        raise ValueError('%s is not a colvar file' % filename)
+    record = np.dtype([('step', 'i8'), ('displacement', 'f4'), ('energy', 'f4')])
+    if header['version'][0] != 1 or header['recordSize'][0] != record.itemsize:
+        raise ValueError('Unsupported colvar file version in %s' % filename)
+    data = np.fromfile(filename, dtype=np.uint8, offset=header.itemsize)
+    numRecords = len(data) // record.itemsize
+    return data[:numRecords*record.itemsize].view(record)
 %}
 
 
@@ -55,6 +83,80 @@ except UnboundLocalError:
     val[0] = unit.Quantity(val[0], unit.nanometer)
 %}
 
+%pythonappend OneDimComPlugin::OneDimComForce::getThreshold(int index) const %{
+    val = unit.Quantity(val, unit.nanometer)
+%}
+
+%pythonappend OneDimComPlugin::OneDimComForce::getDisplacement(OpenMM::Context& context) %{
+    val = unit.Quantity(val, unit.nanometer)
+%}
+
+%pythonappend OneDimComPlugin::OneDimComForce::getConstraintForce(OpenMM::Context& context) %{
+    val = unit.Quantity(val, unit.kilojoule_per_mole / unit.nanometer)
+%}
+
+%pythonappend OneDimComPlugin::OneDimComForce::getVariance0() const %{
+    val = unit.Quantity(val, unit.nanometer * unit.nanometer)
+%}
+
+%pythonappend OneDimComPlugin::OneDimComForce::getVariance(OpenMM::Context& context) %{
+    val = unit.Quantity(val, unit.nanometer * unit.nanometer)
+%}
+
+%pythonappend OneDimComPlugin::OneDimComForce::getAccumulatedWork(OpenMM::Context& context) %{
+    val = unit.Quantity(val, unit.kilojoule_per_mole)
+%}
+
+%pythonappend OneDimComPlugin::OneDimComForce::computeWindowEnergies(OpenMM::Context& context, const std::vector<double>& ks, const std::vector<double>& r0s) %{
+    val = unit.Quantity(list(val), unit.kilojoule_per_mole)
+%}
+
+%pythonappend OneDimComPlugin::OneDimComCombinationForce::getForceConst() const %{
+    val[0] = unit.Quantity(val[0], unit.kilojoule_per_mole / (unit.nanometer * unit.nanometer))
+%}
+
+%pythonappend OneDimComPlugin::OneDimComCombinationForce::getR0() const %{
+    val[0] = unit.Quantity(val[0], unit.nanometer)
+%}
+
+%pythonappend OneDimComPlugin::OneDimComRegionForce::getLower() const %{
+    val = unit.Quantity(val, unit.nanometer)
+%}
+
+%pythonappend OneDimComPlugin::OneDimComRegionForce::getUpper() const %{
+    val = unit.Quantity(val, unit.nanometer)
+%}
+
+%pythonappend OneDimComPlugin::OneDimComRegionForce::getSwitchWidth() const %{
+    val = unit.Quantity(val, unit.nanometer)
+%}
+
+%pythonappend OneDimComPlugin::OneDimComRegionForce::getSkin() const %{
+    val = unit.Quantity(val, unit.nanometer)
+%}
+
+%pythonappend OneDimComPlugin::OneDimComRegionForce::getR0() const %{
+    val = unit.Quantity(val, unit.nanometer)
+%}
+
+%pythonappend OneDimComPlugin::OneDimComRegionForce::getForceConst() const %{
+    val = unit.Quantity(val, unit.kilojoule_per_mole / (unit.nanometer * unit.nanometer))
+%}
+
+%pythonappend OneDimComPlugin::OneDimComWindowScheduler::OneDimComWindowScheduler(const OpenMM::System& system, OneDimComForce& force, OpenMM::Platform& platform, int numThreads) %{
+    # the scheduler refers to these, so keep them alive as long as it is
+    self._system = args[0]
+    self._force = args[1]
+%}
+
+%pythonappend OneDimComPlugin::OneDimComWindowScheduler::addWindow(OpenMM::Integrator* integrator, double k, double r0) %{
+    args[0].thisown = 0
+%}
+
+%pythonappend OneDimComPlugin::OneDimComWindowScheduler::getDisplacements() %{
+    val = unit.Quantity(list(val), unit.nanometer)
+%}
+
 namespace OneDimComPlugin {
 
 class OneDimComForce : public OpenMM::Force {
@@ -79,7 +181,268 @@ public:
     void setForceConst(float k);
     void setR0(float r0);
 
+    bool getUseEvaluationCache() const;
+    void setUseEvaluationCache(bool use);
+    bool getUseConstraint() const;
+    void setUseConstraint(bool use);
+    bool getUseAsCollectiveVariable() const;
+    void setUseAsCollectiveVariable(bool use);
+    int getEvaluationStride() const;
+    bool getUseImpulse() const;
+    void setEvaluationStride(int stride, bool useImpulse=true);
+    double getR0Rate() const;
+    double getForceConstRate() const;
+    void setPullingSchedule(double r0Rate, double forceConstRate=0.0);
+    int getVarianceGroup() const;
+    double getVarianceForceConst() const;
+    double getVariance0() const;
+    void setVarianceRestraint(int group, double varianceK, double variance0);
+    bool getUseExtendedLagrangian() const;
+    const std::string& getExtendedParameterName() const;
+    double getExtendedMass() const;
+    double getExtendedTemperature() const;
+    double getExtendedFriction() const;
+    int getExtendedRandomSeed() const;
+    void setExtendedLagrangian(const std::string& name, double mass, double temperature, double friction, int randomSeed=0);
+    int getNumThresholds() const;
+    int addThreshold(double value);
+    double getThreshold(int index) const;
+    void setThreshold(int index, double value);
+    const std::string& getColvarFile() const;
+    int getColvarInterval() const;
+    void setColvarFile(const std::string& filename, int interval);
+
+    int getNumParameterSets() const;
+    int addParameterSet(float k, float r0, const std::vector<float>& weights1, const std::vector<float>& weights2);
+    void setParameterSet(int index, float k, float r0, const std::vector<float>& weights1, const std::vector<float>& weights2);
+    int getActiveParameterSet(OpenMM::Context& context);
+    void setActiveParameterSet(OpenMM::Context& context, int index);
+    void publishParameters(OpenMM::Context& context, float k, float r0);
+    void publishParameters(OpenMM::Context& context, float k, float r0, const std::vector<float>& weights1, const std::vector<float>& weights2);
+
     void updateParametersInContext(OpenMM::Context& context);
+
+    double getDisplacement(OpenMM::Context& context);
+    double getConstraintForce(OpenMM::Context& context);
+    std::string getExecutionStrategy(OpenMM::Context& context);
+    double getVariance(OpenMM::Context& context);
+    double getAccumulatedWork(OpenMM::Context& context);
+    void resetAccumulatedWork(OpenMM::Context& context);
+    void resetThresholdEvent(OpenMM::Context& context);
+    int stepUntilThreshold(OpenMM::Context& context, int steps, int checkInterval=100);
+    std::vector<double> computeWindowEnergies(OpenMM::Context& context, const std::vector<double>& ks, const std::vector<double>& r0s);
+
+    static void prewarmKernels(OpenMM::Platform& platform);
+    static void prewarmKernels(OpenMM::Platform& platform, const std::map<std::string, std::string>& properties);
+};
+
+%extend OneDimComForce {
+    %pythoncode %{
+    def getCollectiveVariableGradient(self):
+        """Get the gradient of the displacement as a dict mapping each group atom to
+        the derivative with respect to its x coordinate.
+        """
+        particles = vectori()
+        gradient = vectord()
+        self._getCollectiveVariableGradient(particles, gradient)
+        return dict(zip(particles, gradient))
+
+    def getThresholdEvent(self, context):
+        """Get the first threshold crossing as a tuple (threshold, step, direction),
+        or None if no threshold has been crossed.
+        """
+        event = vectorll()
+        if not self._getThresholdEvent(context, event):
+            return None
+        return tuple(event)
+
+    def getParameterSet(self, index):
+        """Get a parameter set as a tuple (k, r0, weights1, weights2)."""
+        values = vectorf()
+        weights1 = vectorf()
+        weights2 = vectorf()
+        self._getParameterSet(index, values, weights1, weights2)
+        return (unit.Quantity(values[0], unit.kilojoule_per_mole / (unit.nanometer * unit.nanometer)),
+                unit.Quantity(values[1], unit.nanometer), list(weights1), list(weights2))
+    %}
+
+    void _getCollectiveVariableGradient(std::vector<int>& particles, std::vector<double>& gradient) const {
+        self->getCollectiveVariableGradient(particles, gradient);
+    }
+
+    bool _getThresholdEvent(OpenMM::Context& context, std::vector<long long>& event) {
+        int threshold, direction;
+        long long step;
+        if (!self->getThresholdEvent(context, threshold, step, direction))
+            return false;
+        event.push_back(threshold);
+        event.push_back(step);
+        event.push_back(direction);
+        return true;
+    }
+
+    void _getParameterSet(int index, std::vector<float>& values, std::vector<float>& weights1, std::vector<float>& weights2) const {
+        float k, r0;
+        self->getParameterSet(index, k, r0, weights1, weights2);
+        values.push_back(k);
+        values.push_back(r0);
+    }
+}
+
+class OneDimComColvarReader {
+public:
+    OneDimComColvarReader(const std::string& filename);
+
+    int getNumRecords() const;
+    const std::vector<long long>& getSteps() const;
+    const std::vector<float>& getDisplacements() const;
+    const std::vector<float>& getEnergies() const;
+};
+
+class OneDimComBatchEvaluator {
+public:
+    OneDimComBatchEvaluator(const OneDimComForce& force, int numThreads=0);
+    int getNumThreads() const;
+};
+
+%extend OneDimComBatchEvaluator {
+    void evaluateBuffers(long long coordinates, int numAtoms, long long numFrames, long long displacements, long long energies) {
+        self->evaluate((const float*) (size_t) coordinates, numAtoms, numFrames, (double*) (size_t) displacements, (double*) (size_t) energies);
+    }
+
+    %pythoncode %{
+    def evaluateArray(self, coordinates):
+        """Evaluate a stack of frames with shape (numFrames, numAtoms, 3).
+
+        The frames are passed to C++ without copying if they are already a
+        contiguous float32 array.  Returns a tuple of numpy arrays holding the
+        displacement and energy in each frame.
+        """
+        import numpy as np
+        coordinates = np.ascontiguousarray(mm.stripUnits((coordinates,))[0], dtype=np.float32)
+        coordinates = coordinates.reshape(coordinates.shape[0], -1, 3)
+        numFrames, numAtoms = coordinates.shape[0], coordinates.shape[1]
+        displacements = np.empty(numFrames, dtype=np.float64)
+        energies = np.empty(numFrames, dtype=np.float64)
+        self.evaluateBuffers(coordinates.ctypes.data, numAtoms, numFrames, displacements.ctypes.data, energies.ctypes.data)
+        return displacements, energies
+
+    def evaluateFile(self, filename, numAtoms):
+        """Evaluate every frame in a raw binary file of float32 coordinates.
+
+        The file is memory mapped rather than read.  Returns a tuple of numpy
+        arrays holding the displacement and energy in each frame.
+        """
+        import numpy as np
+        return self.evaluateArray(np.memmap(filename, dtype=np.float32, mode='r').reshape(-1, numAtoms, 3))
+    %}
+}
+
+class OneDimComCombinationForce : public OpenMM::Force {
+public:
+    OneDimComCombinationForce(float k, float r0);
+
+    int getNumGroups() const;
+    int addGroup(const std::vector<int>& indices, const std::vector<float>& weights, float coefficient);
+    const std::vector<int>& getGroupIndices(int index) const;
+    const std::vector<float>& getGroupWeights(int index) const;
+    float getGroupCoefficient(int index) const;
+    float getForceConst() const;
+    float getR0() const;
+
+    void setGroupParameters(int index, const std::vector<int>& indices, const std::vector<float>& weights, float coefficient);
+    void setForceConst(float k);
+    void setR0(float r0);
+
+    void updateParametersInContext(OpenMM::Context& context);
+};
+
+class OneDimComPairwiseForce : public OpenMM::Force {
+public:
+    enum PairType {
+        Harmonic = 0,
+        LowerWall = 1,
+        UpperWall = 2
+    };
+    OneDimComPairwiseForce();
+
+    int getNumGroups() const;
+    int getNumPairs() const;
+    int addGroup(const std::vector<int>& indices, const std::vector<float>& weights);
+    int addPair(int group1, int group2, float k, float r0, PairType type=Harmonic);
+    const std::vector<int>& getGroupIndices(int index) const;
+    const std::vector<float>& getGroupWeights(int index) const;
+
+    void setGroupParameters(int index, const std::vector<int>& indices, const std::vector<float>& weights);
+    void setPairParameters(int index, int group1, int group2, float k, float r0, PairType type=Harmonic);
+
+    void updateParametersInContext(OpenMM::Context& context);
+};
+
+%extend OneDimComPairwiseForce {
+    %pythoncode %{
+    def getPairParameters(self, index):
+        """Get a pair as a tuple (group1, group2, k, r0, type)."""
+        groups = vectori()
+        values = vectorf()
+        self._getPairParameters(index, groups, values)
+        return (groups[0], groups[1], unit.Quantity(values[0], unit.kilojoule_per_mole / (unit.nanometer * unit.nanometer)),
+                unit.Quantity(values[1], unit.nanometer), groups[2])
+    %}
+
+    void _getPairParameters(int index, std::vector<int>& groups, std::vector<float>& values) const {
+        int group1, group2;
+        float k, r0;
+        OneDimComPlugin::OneDimComPairwiseForce::PairType type;
+        self->getPairParameters(index, group1, group2, k, r0, type);
+        groups.push_back(group1);
+        groups.push_back(group2);
+        groups.push_back(type);
+        values.push_back(k);
+        values.push_back(r0);
+    }
+}
+
+class OneDimComRegionForce : public OpenMM::Force {
+public:
+    OneDimComRegionForce(const std::vector<int>& group1, const std::vector<float>& weights1,
+            const std::vector<int>& candidates, float lower, float upper, float k, float r0);
+
+    const std::vector<int>& getGroup1Indices() const;
+    const std::vector<float>& getGroup1Weights() const;
+    const std::vector<int>& getCandidates() const;
+    float getLower() const;
+    float getUpper() const;
+    float getSwitchWidth() const;
+    float getSkin() const;
+    int getRefreshInterval() const;
+    float getForceConst() const;
+    float getR0() const;
+
+    void setGroup1Weights(const std::vector<float>& weights);
+    void setRegion(float lower, float upper);
+    void setSwitchWidth(float width);
+    void setSkin(float skin);
+    void setRefreshInterval(int interval);
+    void setForceConst(float k);
+    void setR0(float r0);
+
+    void updateParametersInContext(OpenMM::Context& context);
+};
+
+class OneDimComWindowScheduler {
+public:
+    OneDimComWindowScheduler(const OpenMM::System& system, OneDimComForce& force, OpenMM::Platform& platform, int numThreads=0);
+    int addWindow(OpenMM::Integrator* integrator, double k, double r0);
+    int getNumWindows() const;
+    int getNumThreads() const;
+    double getForceConst(int window) const;
+    double getR0(int window) const;
+    OpenMM::Context& getContext(int window);
+    void step(int steps);
+    std::vector<double> getDisplacements();
+    int attemptExchanges(double temperature);
+    void setRandomNumberSeed(int seed);
 };
 
 }
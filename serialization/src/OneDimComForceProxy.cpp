@@ -44,10 +44,27 @@ OneDimComForceProxy::OneDimComForceProxy() : SerializationProxy("OneDimComForce"
 }
 
 void OneDimComForceProxy::serialize(const void* object, SerializationNode& node) const {
-    node.setIntProperty("version", 1);
+    node.setIntProperty("version", 11);
     const OneDimComForce& force = *reinterpret_cast<const OneDimComForce*>(object);
     node.setDoubleProperty("forceConst", force.getForceConst());
     node.setDoubleProperty("r0", force.getR0());
+    node.setBoolProperty("useEvaluationCache", force.getUseEvaluationCache());
+    node.setStringProperty("colvarFile", force.getColvarFile());
+    node.setIntProperty("colvarInterval", force.getColvarInterval());
+    node.setBoolProperty("useConstraint", force.getUseConstraint());
+    node.setBoolProperty("useAsCollectiveVariable", force.getUseAsCollectiveVariable());
+    node.setIntProperty("evaluationStride", force.getEvaluationStride());
+    node.setBoolProperty("useImpulse", force.getUseImpulse());
+    node.setDoubleProperty("r0Rate", force.getR0Rate());
+    node.setDoubleProperty("forceConstRate", force.getForceConstRate());
+    node.setIntProperty("varianceGroup", force.getVarianceGroup());
+    node.setDoubleProperty("varianceForceConst", force.getVarianceForceConst());
+    node.setDoubleProperty("variance0", force.getVariance0());
+    node.setStringProperty("extendedName", force.getExtendedParameterName());
+    node.setDoubleProperty("extendedMass", force.getExtendedMass());
+    node.setDoubleProperty("extendedTemperature", force.getExtendedTemperature());
+    node.setDoubleProperty("extendedFriction", force.getExtendedFriction());
+    node.setIntProperty("extendedRandomSeed", force.getExtendedRandomSeed());
 
     SerializationNode& group1 = node.createChildNode("group1");
     for (vector<int>::const_iterator it=force.getGroup1Indices().begin(); it!=force.getGroup1Indices().end(); ++it) {
@@ -68,13 +85,52 @@ void OneDimComForceProxy::serialize(const void* object, SerializationNode& node)
     for (vector<float>::const_iterator it=force.getGroup2Weights().begin(); it!=force.getGroup2Weights().end(); ++it) {
         weights2.createChildNode("weight").setDoubleProperty("weight", *it);
     }
+
+    SerializationNode& thresholds = node.createChildNode("thresholds");
+    for (int i=0; i<force.getNumThresholds(); ++i) {
+        thresholds.createChildNode("threshold").setDoubleProperty("value", force.getThreshold(i));
+    }
+
+    SerializationNode& parameterSets = node.createChildNode("parameterSets");
+    for (int i=1; i<force.getNumParameterSets(); ++i) {
+        float k, r0;
+        vector<float> setWeights1, setWeights2;
+        force.getParameterSet(i, k, r0, setWeights1, setWeights2);
+        SerializationNode& set = parameterSets.createChildNode("parameterSet").setDoubleProperty("forceConst", k).setDoubleProperty("r0", r0);
+        SerializationNode& setWeights1Node = set.createChildNode("weights1");
+        for (vector<float>::const_iterator it=setWeights1.begin(); it!=setWeights1.end(); ++it) {
+            setWeights1Node.createChildNode("weight").setDoubleProperty("weight", *it);
+        }
+        SerializationNode& setWeights2Node = set.createChildNode("weights2");
+        for (vector<float>::const_iterator it=setWeights2.begin(); it!=setWeights2.end(); ++it) {
+            setWeights2Node.createChildNode("weight").setDoubleProperty("weight", *it);
+        }
+    }
 }
 
 void* OneDimComForceProxy::deserialize(const SerializationNode& node) const {
-    if (node.getIntProperty("version") != 1)
+    int version = node.getIntProperty("version");
+    if (version < 1 || version > 11)
         throw OpenMMException("Unsupported version number");
     float forceConst = 0.0;
     float r0 = 0.0;
+    bool useEvaluationCache = false;
+    string colvarFile;
+    int colvarInterval = 0;
+    bool useConstraint = false;
+    bool useAsCollectiveVariable = false;
+    int evaluationStride = 1;
+    bool useImpulse = true;
+    double r0Rate = 0.0;
+    double forceConstRate = 0.0;
+    int varianceGroup = 0;
+    double varianceForceConst = 0.0;
+    double variance0 = 0.0;
+    string extendedName;
+    double extendedMass = 0.0;
+    double extendedTemperature = 0.0;
+    double extendedFriction = 0.0;
+    int extendedRandomSeed = 0;
     vector<int> group1;
     vector<int> group2;
     vector<float> weights1;
@@ -82,6 +138,36 @@ void* OneDimComForceProxy::deserialize(const SerializationNode& node) const {
     try {
         forceConst = node.getDoubleProperty("forceConst");
         r0 = node.getDoubleProperty("r0");
+        if (version >= 2)
+            useEvaluationCache = node.getBoolProperty("useEvaluationCache");
+        if (version >= 3) {
+            colvarFile = node.getStringProperty("colvarFile");
+            colvarInterval = node.getIntProperty("colvarInterval");
+        }
+        if (version >= 4)
+            useConstraint = node.getBoolProperty("useConstraint");
+        if (version >= 5)
+            useAsCollectiveVariable = node.getBoolProperty("useAsCollectiveVariable");
+        if (version >= 6) {
+            evaluationStride = node.getIntProperty("evaluationStride");
+            useImpulse = node.getBoolProperty("useImpulse");
+        }
+        if (version >= 8) {
+            r0Rate = node.getDoubleProperty("r0Rate");
+            forceConstRate = node.getDoubleProperty("forceConstRate");
+        }
+        if (version >= 10) {
+            varianceGroup = node.getIntProperty("varianceGroup");
+            varianceForceConst = node.getDoubleProperty("varianceForceConst");
+            variance0 = node.getDoubleProperty("variance0");
+        }
+        if (version >= 11) {
+            extendedName = node.getStringProperty("extendedName");
+            extendedMass = node.getDoubleProperty("extendedMass");
+            extendedTemperature = node.getDoubleProperty("extendedTemperature");
+            extendedFriction = node.getDoubleProperty("extendedFriction");
+            extendedRandomSeed = node.getIntProperty("extendedRandomSeed");
+        }
 
         const SerializationNode& group1Node = node.getChildNode("group1");
         for (vector<SerializationNode>::const_iterator it=group1Node.getChildren().begin(); it!=group1Node.getChildren().end(); ++it) {
@@ -107,5 +193,46 @@ void* OneDimComForceProxy::deserialize(const SerializationNode& node) const {
         throw;
     }
     OneDimComForce* force = new OneDimComForce(group1, group2, weights1, weights2, forceConst, r0);
+    if (version >= 7) {
+        try {
+            const SerializationNode& parameterSets = node.getChildNode("parameterSets");
+            for (vector<SerializationNode>::const_iterator set=parameterSets.getChildren().begin(); set!=parameterSets.getChildren().end(); ++set) {
+                vector<float> setWeights1, setWeights2;
+                const SerializationNode& setWeights1Node = set->getChildNode("weights1");
+                for (vector<SerializationNode>::const_iterator it=setWeights1Node.getChildren().begin(); it!=setWeights1Node.getChildren().end(); ++it) {
+                    setWeights1.push_back(it->getDoubleProperty("weight"));
+                }
+                const SerializationNode& setWeights2Node = set->getChildNode("weights2");
+                for (vector<SerializationNode>::const_iterator it=setWeights2Node.getChildren().begin(); it!=setWeights2Node.getChildren().end(); ++it) {
+                    setWeights2.push_back(it->getDoubleProperty("weight"));
+                }
+                force->addParameterSet(set->getDoubleProperty("forceConst"), set->getDoubleProperty("r0"), setWeights1, setWeights2);
+            }
+        }
+        catch (...) {
+            delete force;
+            throw;
+        }
+    }
+    if (version >= 9) {
+        try {
+            const SerializationNode& thresholds = node.getChildNode("thresholds");
+            for (vector<SerializationNode>::const_iterator it=thresholds.getChildren().begin(); it!=thresholds.getChildren().end(); ++it) {
+                force->addThreshold(it->getDoubleProperty("value"));
+            }
+        }
+        catch (...) {
+            delete force;
+            throw;
+        }
+    }
+    force->setUseEvaluationCache(useEvaluationCache);
+    force->setColvarFile(colvarFile, colvarInterval);
+    force->setUseConstraint(useConstraint);
+    force->setUseAsCollectiveVariable(useAsCollectiveVariable);
+    force->setEvaluationStride(evaluationStride, useImpulse);
+    force->setPullingSchedule(r0Rate, forceConstRate);
+    force->setVarianceRestraint(varianceGroup, varianceForceConst, variance0);
+    force->setExtendedLagrangian(extendedName, extendedMass, extendedTemperature, extendedFriction, extendedRandomSeed);
     return force;
 }
@@ -0,0 +1,94 @@
+/* -------------------------------------------------------------------------- *
+ *                                OpenMMExample                                 *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "OneDimComPairwiseForceProxy.h"
+#include "OneDimComPairwiseForce.h"
+#include "openmm/serialization/SerializationNode.h"
+#include <sstream>
+#include <vector>
+#include <iostream>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+OneDimComPairwiseForceProxy::OneDimComPairwiseForceProxy() : SerializationProxy("OneDimComPairwiseForce") {
+}
+
+void OneDimComPairwiseForceProxy::serialize(const void* object, SerializationNode& node) const {
+    node.setIntProperty("version", 1);
+    const OneDimComPairwiseForce& force = *reinterpret_cast<const OneDimComPairwiseForce*>(object);
+
+    SerializationNode& groups = node.createChildNode("groups");
+    for (int i=0; i<force.getNumGroups(); ++i) {
+        SerializationNode& group = groups.createChildNode("group");
+        for (int j=0; j<force.getGroupIndices(i).size(); ++j) {
+            group.createChildNode("atom").setIntProperty("index", force.getGroupIndices(i)[j]).setDoubleProperty("weight", force.getGroupWeights(i)[j]);
+        }
+    }
+    SerializationNode& pairs = node.createChildNode("pairs");
+    for (int i=0; i<force.getNumPairs(); ++i) {
+        int group1, group2;
+        float k, r0;
+        OneDimComPairwiseForce::PairType type;
+        force.getPairParameters(i, group1, group2, k, r0, type);
+        pairs.createChildNode("pair").setIntProperty("group1", group1).setIntProperty("group2", group2)
+                .setDoubleProperty("forceConst", k).setDoubleProperty("r0", r0).setIntProperty("type", type);
+    }
+}
+
+void* OneDimComPairwiseForceProxy::deserialize(const SerializationNode& node) const {
+    if (node.getIntProperty("version") != 1)
+        throw OpenMMException("Unsupported version number");
+    OneDimComPairwiseForce* force = new OneDimComPairwiseForce();
+    try {
+        const SerializationNode& groups = node.getChildNode("groups");
+        for (vector<SerializationNode>::const_iterator group=groups.getChildren().begin(); group!=groups.getChildren().end(); ++group) {
+            vector<int> indices;
+            vector<float> weights;
+            for (vector<SerializationNode>::const_iterator atom=group->getChildren().begin(); atom!=group->getChildren().end(); ++atom) {
+                indices.push_back(atom->getIntProperty("index"));
+                weights.push_back(atom->getDoubleProperty("weight"));
+            }
+            force->addGroup(indices, weights);
+        }
+        const SerializationNode& pairs = node.getChildNode("pairs");
+        for (vector<SerializationNode>::const_iterator pair=pairs.getChildren().begin(); pair!=pairs.getChildren().end(); ++pair) {
+            force->addPair(pair->getIntProperty("group1"), pair->getIntProperty("group2"), pair->getDoubleProperty("forceConst"),
+                    pair->getDoubleProperty("r0"), (OneDimComPairwiseForce::PairType) pair->getIntProperty("type"));
+        }
+    }
+    catch (...) {
+        delete force;
+        throw;
+    }
+    return force;
+}
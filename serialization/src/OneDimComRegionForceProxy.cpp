@@ -0,0 +1,95 @@
+/* -------------------------------------------------------------------------- *
+ *                                OpenMMExample                                 *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "OneDimComRegionForceProxy.h"
+#include "OneDimComRegionForce.h"
+#include "openmm/serialization/SerializationNode.h"
+#include <sstream>
+#include <vector>
+#include <iostream>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+OneDimComRegionForceProxy::OneDimComRegionForceProxy() : SerializationProxy("OneDimComRegionForce") {
+}
+
+void OneDimComRegionForceProxy::serialize(const void* object, SerializationNode& node) const {
+    node.setIntProperty("version", 1);
+    const OneDimComRegionForce& force = *reinterpret_cast<const OneDimComRegionForce*>(object);
+    node.setDoubleProperty("forceConst", force.getForceConst());
+    node.setDoubleProperty("r0", force.getR0());
+    node.setDoubleProperty("lower", force.getLower());
+    node.setDoubleProperty("upper", force.getUpper());
+    node.setDoubleProperty("switchWidth", force.getSwitchWidth());
+    node.setDoubleProperty("skin", force.getSkin());
+    node.setIntProperty("refreshInterval", force.getRefreshInterval());
+
+    SerializationNode& group1 = node.createChildNode("group1");
+    for (int i=0; i<force.getGroup1Indices().size(); ++i) {
+        group1.createChildNode("atom").setIntProperty("index", force.getGroup1Indices()[i]).setDoubleProperty("weight", force.getGroup1Weights()[i]);
+    }
+
+    SerializationNode& candidates = node.createChildNode("candidates");
+    for (vector<int>::const_iterator it=force.getCandidates().begin(); it!=force.getCandidates().end(); ++it) {
+        candidates.createChildNode("atom").setIntProperty("index", *it);
+    }
+}
+
+void* OneDimComRegionForceProxy::deserialize(const SerializationNode& node) const {
+    if (node.getIntProperty("version") != 1)
+        throw OpenMMException("Unsupported version number");
+    vector<int> group1;
+    vector<float> weights1;
+    vector<int> candidates;
+    const SerializationNode& group1Node = node.getChildNode("group1");
+    for (vector<SerializationNode>::const_iterator atom=group1Node.getChildren().begin(); atom!=group1Node.getChildren().end(); ++atom) {
+        group1.push_back(atom->getIntProperty("index"));
+        weights1.push_back(atom->getDoubleProperty("weight"));
+    }
+    const SerializationNode& candidatesNode = node.getChildNode("candidates");
+    for (vector<SerializationNode>::const_iterator atom=candidatesNode.getChildren().begin(); atom!=candidatesNode.getChildren().end(); ++atom) {
+        candidates.push_back(atom->getIntProperty("index"));
+    }
+    OneDimComRegionForce* force = new OneDimComRegionForce(group1, weights1, candidates, node.getDoubleProperty("lower"),
+            node.getDoubleProperty("upper"), node.getDoubleProperty("forceConst"), node.getDoubleProperty("r0"));
+    try {
+        force->setSwitchWidth(node.getDoubleProperty("switchWidth"));
+        force->setSkin(node.getDoubleProperty("skin"));
+        force->setRefreshInterval(node.getIntProperty("refreshInterval"));
+    }
+    catch (...) {
+        delete force;
+        throw;
+    }
+    return force;
+}
@@ -40,6 +40,12 @@
 
 #include "OneDimComForce.h"
 #include "OneDimComForceProxy.h"
+#include "OneDimComCombinationForce.h"
+#include "OneDimComCombinationForceProxy.h"
+#include "OneDimComPairwiseForce.h"
+#include "OneDimComPairwiseForceProxy.h"
+#include "OneDimComRegionForce.h"
+#include "OneDimComRegionForceProxy.h"
 #include "openmm/serialization/SerializationProxy.h"
 
 #if defined(WIN32)
@@ -59,4 +65,7 @@ using namespace OpenMM;
 
 extern "C" OPENMM_EXPORT_EXAMPLE void registerOneDimComSerializationProxies() {
     SerializationProxy::registerProxy(typeid(OneDimComForce), new OneDimComForceProxy());
+    SerializationProxy::registerProxy(typeid(OneDimComCombinationForce), new OneDimComCombinationForceProxy());
+    SerializationProxy::registerProxy(typeid(OneDimComPairwiseForce), new OneDimComPairwiseForceProxy());
+    SerializationProxy::registerProxy(typeid(OneDimComRegionForce), new OneDimComRegionForceProxy());
 }
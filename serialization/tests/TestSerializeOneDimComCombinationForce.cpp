@@ -0,0 +1,105 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "OneDimComCombinationForce.h"
+#include "openmm/Platform.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/serialization/XmlSerializer.h"
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+extern "C" void registerOneDimComSerializationProxies();
+
+void testSerialization() {
+    // Create a Force with a peptide and two leaflets.
+    OneDimComCombinationForce force(2.0, 1.5);
+
+    vector<int> peptide;
+    vector<float> peptideWeights;
+    peptide.push_back(0);
+    peptideWeights.push_back(1.0);
+    force.addGroup(peptide, peptideWeights, 1.0);
+
+    vector<int> leaflet1;
+    vector<float> leaflet1Weights;
+    leaflet1.push_back(1);
+    leaflet1.push_back(2);
+    leaflet1Weights.push_back(0.25);
+    leaflet1Weights.push_back(0.75);
+    force.addGroup(leaflet1, leaflet1Weights, -0.5);
+
+    vector<int> leaflet2;
+    vector<float> leaflet2Weights;
+    leaflet2.push_back(3);
+    leaflet2.push_back(4);
+    leaflet2Weights.push_back(0.5);
+    leaflet2Weights.push_back(0.5);
+    force.addGroup(leaflet2, leaflet2Weights, -0.5);
+
+    // serialize and then deserialize it
+    stringstream buffer;
+    XmlSerializer::serialize<OneDimComCombinationForce>(&force, "Force", buffer);
+    OneDimComCombinationForce* copy = XmlSerializer::deserialize<OneDimComCombinationForce>(buffer);
+
+    // Compare the two forces to see if they are identical.
+    OneDimComCombinationForce& force2 = *copy;
+    ASSERT_EQUAL(force.getForceConst(), force2.getForceConst());
+    ASSERT_EQUAL(force.getR0(), force2.getR0());
+    ASSERT_EQUAL(force.getNumGroups(), force2.getNumGroups());
+    for (int i=0; i<force.getNumGroups(); ++i) {
+        ASSERT_EQUAL(force.getGroupCoefficient(i), force2.getGroupCoefficient(i));
+        ASSERT_EQUAL(force.getGroupIndices(i).size(), force2.getGroupIndices(i).size());
+        ASSERT_EQUAL(force.getGroupWeights(i).size(), force2.getGroupWeights(i).size());
+        for (int j=0; j<force.getGroupIndices(i).size(); ++j) {
+            ASSERT_EQUAL(force.getGroupIndices(i)[j], force2.getGroupIndices(i)[j]);
+            ASSERT_EQUAL(force.getGroupWeights(i)[j], force2.getGroupWeights(i)[j]);
+        }
+    }
+    delete copy;
+}
+
+int main() {
+    try {
+        registerOneDimComSerializationProxies();
+        testSerialization();
+    }
+    catch(const exception& e) {
+        cout << "exception: " << e.what() << endl;
+        return 1;
+    }
+    cout << "Done" << endl;
+    return 0;
+}
@@ -0,0 +1,114 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "OneDimComPairwiseForce.h"
+#include "openmm/Platform.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/serialization/XmlSerializer.h"
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+extern "C" void registerOneDimComSerializationProxies();
+
+void testSerialization() {
+    // Create a Force with three groups and a pair of each type.
+    OneDimComPairwiseForce force;
+    vector<int> group;
+    vector<float> weights;
+    group.push_back(0);
+    weights.push_back(1.0);
+    force.addGroup(group, weights);
+
+    group[0] = 1;
+    group.push_back(2);
+    weights[0] = 0.25;
+    weights.push_back(0.75);
+    force.addGroup(group, weights);
+
+    group[0] = 3;
+    group[1] = 4;
+    weights[0] = 0.5;
+    weights[1] = 0.5;
+    force.addGroup(group, weights);
+
+    force.addPair(0, 1, 2.0, 1.5);
+    force.addPair(1, 2, 3.0, -0.5, OneDimComPairwiseForce::LowerWall);
+    force.addPair(2, 0, 4.0, 2.5, OneDimComPairwiseForce::UpperWall);
+
+    // serialize and then deserialize it
+    stringstream buffer;
+    XmlSerializer::serialize<OneDimComPairwiseForce>(&force, "Force", buffer);
+    OneDimComPairwiseForce* copy = XmlSerializer::deserialize<OneDimComPairwiseForce>(buffer);
+
+    // Compare the two forces to see if they are identical.
+    OneDimComPairwiseForce& force2 = *copy;
+    ASSERT_EQUAL(force.getNumGroups(), force2.getNumGroups());
+    for (int i=0; i<force.getNumGroups(); ++i) {
+        ASSERT_EQUAL(force.getGroupIndices(i).size(), force2.getGroupIndices(i).size());
+        ASSERT_EQUAL(force.getGroupWeights(i).size(), force2.getGroupWeights(i).size());
+        for (int j=0; j<force.getGroupIndices(i).size(); ++j) {
+            ASSERT_EQUAL(force.getGroupIndices(i)[j], force2.getGroupIndices(i)[j]);
+            ASSERT_EQUAL(force.getGroupWeights(i)[j], force2.getGroupWeights(i)[j]);
+        }
+    }
+    ASSERT_EQUAL(force.getNumPairs(), force2.getNumPairs());
+    for (int i=0; i<force.getNumPairs(); ++i) {
+        int group1, group2, group1b, group2b;
+        float k, r0, kb, r0b;
+        OneDimComPairwiseForce::PairType type, typeb;
+        force.getPairParameters(i, group1, group2, k, r0, type);
+        force2.getPairParameters(i, group1b, group2b, kb, r0b, typeb);
+        ASSERT_EQUAL(group1, group1b);
+        ASSERT_EQUAL(group2, group2b);
+        ASSERT_EQUAL(k, kb);
+        ASSERT_EQUAL(r0, r0b);
+        ASSERT_EQUAL(type, typeb);
+    }
+    delete copy;
+}
+
+int main() {
+    try {
+        registerOneDimComSerializationProxies();
+        testSerialization();
+    }
+    catch(const exception& e) {
+        cout << "exception: " << e.what() << endl;
+        return 1;
+    }
+    cout << "Done" << endl;
+    return 0;
+}
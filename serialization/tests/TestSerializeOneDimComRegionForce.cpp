@@ -0,0 +1,99 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2014 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "OneDimComRegionForce.h"
+#include "openmm/Platform.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/serialization/XmlSerializer.h"
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+extern "C" void registerOneDimComSerializationProxies();
+
+void testSerialization() {
+    // Create a Force with a peptide and the lipids of a slab.
+    vector<int> group1;
+    vector<float> weights1;
+    group1.push_back(0);
+    group1.push_back(1);
+    weights1.push_back(0.25);
+    weights1.push_back(0.75);
+    vector<int> candidates;
+    for (int i=2; i<10; ++i)
+        candidates.push_back(i);
+    OneDimComRegionForce force(group1, weights1, candidates, -1.0, 1.5, 2.0, 0.5);
+    force.setSwitchWidth(0.2);
+    force.setSkin(0.3);
+    force.setRefreshInterval(25);
+
+    // serialize and then deserialize it
+    stringstream buffer;
+    XmlSerializer::serialize<OneDimComRegionForce>(&force, "Force", buffer);
+    OneDimComRegionForce* copy = XmlSerializer::deserialize<OneDimComRegionForce>(buffer);
+
+    // Compare the two forces to see if they are identical.
+    OneDimComRegionForce& force2 = *copy;
+    ASSERT_EQUAL(force.getForceConst(), force2.getForceConst());
+    ASSERT_EQUAL(force.getR0(), force2.getR0());
+    ASSERT_EQUAL(force.getLower(), force2.getLower());
+    ASSERT_EQUAL(force.getUpper(), force2.getUpper());
+    ASSERT_EQUAL(force.getSwitchWidth(), force2.getSwitchWidth());
+    ASSERT_EQUAL(force.getSkin(), force2.getSkin());
+    ASSERT_EQUAL(force.getRefreshInterval(), force2.getRefreshInterval());
+    ASSERT_EQUAL(force.getGroup1Indices().size(), force2.getGroup1Indices().size());
+    for (int i=0; i<force.getGroup1Indices().size(); ++i) {
+        ASSERT_EQUAL(force.getGroup1Indices()[i], force2.getGroup1Indices()[i]);
+        ASSERT_EQUAL(force.getGroup1Weights()[i], force2.getGroup1Weights()[i]);
+    }
+    ASSERT_EQUAL(force.getCandidates().size(), force2.getCandidates().size());
+    for (int i=0; i<force.getCandidates().size(); ++i) {
+        ASSERT_EQUAL(force.getCandidates()[i], force2.getCandidates()[i]);
+    }
+    delete copy;
+}
+
+int main() {
+    try {
+        registerOneDimComSerializationProxies();
+        testSerialization();
+    }
+    catch(const exception& e) {
+        cout << "exception: " << e.what() << endl;
+        return 1;
+    }
+    cout << "Done" << endl;
+    return 0;
+}
@@ -64,6 +64,20 @@ void testSerialization() {
 
     // create the force
     OneDimComForce force(g1, g2, w1, w2, k, r0);
+    force.setUseEvaluationCache(true);
+    force.setColvarFile("colvar.dat", 10);
+    force.setUseConstraint(true);
+    force.setUseAsCollectiveVariable(true);
+    force.setEvaluationStride(4, false);
+    force.setPullingSchedule(0.5, -0.25);
+    force.addThreshold(0.5);
+    force.addThreshold(1.5);
+    force.setVarianceRestraint(2, 5.0, 0.3);
+    force.setExtendedLagrangian("s", 50.0, 3000.0, 10.0, 1234);
+    vector<float> setWeights1(1, 1.0), setWeights2(2, 0.5);
+    setWeights2[0] = 0.25;
+    setWeights2[1] = 0.75;
+    force.addParameterSet(3.0, 1.5, setWeights1, setWeights2);
 
     // serialize and then deserialize it
     stringstream buffer;
@@ -73,6 +87,37 @@ void testSerialization() {
     OneDimComForce& force2 = *copy;
     ASSERT_EQUAL(force.getForceConst(), force2.getForceConst());
     ASSERT_EQUAL(force.getR0(), force2.getR0());
+    ASSERT_EQUAL(force.getUseEvaluationCache(), force2.getUseEvaluationCache());
+    ASSERT_EQUAL(force.getColvarFile(), force2.getColvarFile());
+    ASSERT_EQUAL(force.getColvarInterval(), force2.getColvarInterval());
+    ASSERT_EQUAL(force.getUseConstraint(), force2.getUseConstraint());
+    ASSERT_EQUAL(force.getUseAsCollectiveVariable(), force2.getUseAsCollectiveVariable());
+    ASSERT_EQUAL(force.getEvaluationStride(), force2.getEvaluationStride());
+    ASSERT_EQUAL(force.getUseImpulse(), force2.getUseImpulse());
+    ASSERT_EQUAL(force.getR0Rate(), force2.getR0Rate());
+    ASSERT_EQUAL(force.getForceConstRate(), force2.getForceConstRate());
+    ASSERT_EQUAL(force.getVarianceGroup(), force2.getVarianceGroup());
+    ASSERT_EQUAL(force.getVarianceForceConst(), force2.getVarianceForceConst());
+    ASSERT_EQUAL(force.getVariance0(), force2.getVariance0());
+    ASSERT_EQUAL(force.getExtendedParameterName(), force2.getExtendedParameterName());
+    ASSERT_EQUAL(force.getExtendedMass(), force2.getExtendedMass());
+    ASSERT_EQUAL(force.getExtendedTemperature(), force2.getExtendedTemperature());
+    ASSERT_EQUAL(force.getExtendedFriction(), force2.getExtendedFriction());
+    ASSERT_EQUAL(force.getExtendedRandomSeed(), force2.getExtendedRandomSeed());
+    ASSERT_EQUAL(force.getNumThresholds(), force2.getNumThresholds());
+    for (int i=0; i<force.getNumThresholds(); ++i)
+        ASSERT_EQUAL(force.getThreshold(i), force2.getThreshold(i));
+    ASSERT_EQUAL(force.getNumParameterSets(), force2.getNumParameterSets());
+    for (int i=0; i<force.getNumParameterSets(); ++i) {
+        float k1, k2, r01, r02;
+        vector<float> w11, w12, w21, w22;
+        force.getParameterSet(i, k1, r01, w11, w21);
+        force2.getParameterSet(i, k2, r02, w12, w22);
+        ASSERT_EQUAL(k1, k2);
+        ASSERT_EQUAL(r01, r02);
+        ASSERT_EQUAL_CONTAINERS(w11, w12);
+        ASSERT_EQUAL_CONTAINERS(w21, w22);
+    }
 
     // get all of the groups and weights
     vector<int> g1_orig = force.getGroup1Indices();
@@ -0,0 +1,124 @@
+#include "OneDimComForce.h"
+#include "OneDimComBatchEvaluator.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/OpenMMException.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+OneDimComForce* createForce() {
+    // atom 2 is left out in order to catch stupid indexing errors
+    vector<int> group1, group2;
+    vector<float> weights1, weights2;
+    group1.push_back(0);
+    group1.push_back(1);
+    weights1.push_back(0.25);
+    weights1.push_back(0.75);
+    group2.push_back(3);
+    group2.push_back(4);
+    weights2.push_back(0.5);
+    weights2.push_back(0.5);
+    return new OneDimComForce(group1, group2, weights1, weights2, 2.0, 1.5);
+}
+
+vector<float> createFrames(int numAtoms, int numFrames) {
+    vector<float> frames(numFrames*numAtoms*3);
+    srand(0);
+    for (int i=0; i<frames.size(); ++i)
+        frames[i] = 10.0*rand()/RAND_MAX;
+    return frames;
+}
+
+void testFile() {
+    const int numAtoms = 5;
+    const int numFrames = 100;
+    OneDimComForce* force = createForce();
+    vector<float> frames = createFrames(numAtoms, numFrames);
+    FILE* file = fopen("TestOneDimComBatchEvaluator.dat", "wb");
+    fwrite(&frames[0], sizeof(float), frames.size(), file);
+    fclose(file);
+
+    OneDimComBatchEvaluator evaluator(*force, 3);
+    ASSERT_EQUAL(3, evaluator.getNumThreads());
+    vector<double> displacements, energies;
+    evaluator.evaluateFile("TestOneDimComBatchEvaluator.dat", numAtoms, displacements, energies);
+    remove("TestOneDimComBatchEvaluator.dat");
+    ASSERT_EQUAL(numFrames, displacements.size());
+    ASSERT_EQUAL(numFrames, energies.size());
+    for (int frame=0; frame<numFrames; ++frame) {
+        const float* x = &frames[frame*numAtoms*3];
+        double expected = 0.5*x[9] + 0.5*x[12] - 0.25*x[0] - 0.75*x[3];
+        ASSERT_EQUAL_TOL(expected, displacements[frame], 1e-5);
+        ASSERT_EQUAL_TOL(0.5*2.0*(expected-1.5)*(expected-1.5), energies[frame], 1e-5);
+    }
+    delete force;
+}
+
+void testModes() {
+    // the energy includes the variance restraint, and in the collective
+    // variable mode is the displacement itself
+    const int numAtoms = 5;
+    const int numFrames = 10;
+    vector<float> frames = createFrames(numAtoms, numFrames);
+    OneDimComForce* force = createForce();
+    force->setVarianceRestraint(1, 3.0, 0.5);
+    OneDimComBatchEvaluator evaluator(*force);
+    vector<double> displacements(numFrames), energies(numFrames);
+    evaluator.evaluate(&frames[0], numAtoms, numFrames, &displacements[0], &energies[0]);
+    for (int frame=0; frame<numFrames; ++frame) {
+        const float* x = &frames[frame*numAtoms*3];
+        double expected = 0.5*x[9] + 0.5*x[12] - 0.25*x[0] - 0.75*x[3];
+        double mean = 0.25*x[0] + 0.75*x[3];
+        double variance = 0.25*x[0]*x[0] + 0.75*x[3]*x[3] - mean*mean;
+        ASSERT_EQUAL_TOL(expected, displacements[frame], 1e-5);
+        ASSERT_EQUAL_TOL(0.5*2.0*(expected-1.5)*(expected-1.5) + 0.5*3.0*(variance-0.5)*(variance-0.5), energies[frame], 1e-4);
+    }
+    force->setVarianceRestraint(0, 0.0, 0.0);
+    force->setUseAsCollectiveVariable(true);
+    OneDimComBatchEvaluator variable(*force);
+    variable.evaluate(&frames[0], numAtoms, numFrames, &displacements[0], &energies[0]);
+    for (int frame=0; frame<numFrames; ++frame)
+        ASSERT_EQUAL_TOL(displacements[frame], energies[frame], 1e-5);
+    delete force;
+}
+
+void testNoAtoms() {
+    // a frame size of 0 can't divide up a file
+    OneDimComForce* force = createForce();
+    vector<float> frames = createFrames(5, 1);
+    FILE* file = fopen("TestOneDimComBatchEvaluator.dat", "wb");
+    fwrite(&frames[0], sizeof(float), frames.size(), file);
+    fclose(file);
+    OneDimComBatchEvaluator evaluator(*force);
+    vector<double> displacements, energies;
+    bool threw = false;
+    try {
+        evaluator.evaluateFile("TestOneDimComBatchEvaluator.dat", 0, displacements, energies);
+    }
+    catch (OpenMMException e) {
+        threw = true;
+    }
+    remove("TestOneDimComBatchEvaluator.dat");
+    ASSERT(threw);
+    delete force;
+}
+
+int main() {
+    try {
+        testFile();
+        testModes();
+        testNoAtoms();
+    }
+    catch(const std::exception& e) {
+        std::cout << "exception: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Done" << std::endl;
+    return 0;
+}
@@ -0,0 +1,831 @@
+/**
+ * Tests of OneDimComForce that every platform must pass.  A platform's test
+ * program includes the header that defines platformName and initializeTests()
+ * for it, then this one, and defines runPlatformTests() for the tests that only
+ * apply to that platform.
+ */
+
+#include "OneDimComForce.h"
+#include "OneDimComBatchEvaluator.h"
+#include "OneDimComColvarReader.h"
+#include "OneDimComKernels.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/Context.h"
+#include "openmm/CustomCVForce.h"
+#include "openmm/CustomExternalForce.h"
+#include "openmm/Platform.h"
+#include "openmm/System.h"
+#include "openmm/VerletIntegrator.h"
+#include "openmm/OpenMMException.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+void runPlatformTests();
+
+void testCollectiveVariable() {
+    System system;
+    vector<Vec3> positions(3);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    positions[0] = Vec3(0.0, 0.0, 0.0);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    positions[2] = Vec3(3.0, 0.0, 0.0);
+
+    vector<int> group1(1, 0);
+    vector<int> group2;
+    group2.push_back(1);
+    group2.push_back(2);
+    vector<float> weights1(1, 1.0);
+    vector<float> weights2(2, 0.5);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights1, weights2, 1.0, 2.0);
+    force->setUseAsCollectiveVariable(true);
+
+    // the gradient is just the signed weights
+    vector<int> particles;
+    vector<double> gradient;
+    force->getCollectiveVariableGradient(particles, gradient);
+    ASSERT_EQUAL(3, particles.size());
+    ASSERT_EQUAL(0, particles[0]);
+    ASSERT_EQUAL(2, particles[2]);
+    ASSERT_EQUAL_TOL(-1.0, gradient[0], 1e-6);
+    ASSERT_EQUAL_TOL(0.5, gradient[1], 1e-6);
+    ASSERT_EQUAL_TOL(0.5, gradient[2], 1e-6);
+
+    // the displacement is 2, so E = 2.5*(d-1)^2 = 2.5
+    CustomCVForce* cv = new CustomCVForce("2.5*(d-1)^2");
+    cv->addCollectiveVariable("d", force);
+    system.addForce(cv);
+
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName(platformName);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(2.5, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(5.0, state.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(-2.5, state.getForces()[1][0], 1e-5);
+    ASSERT_EQUAL_TOL(-2.5, state.getForces()[2][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[2][1], 1e-5);
+}
+
+void testEvaluationStride() {
+    System system;
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    vector<int> group1(1, 0), group2(1, 1);
+    vector<float> weights(1, 1.0);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights, weights, 1.0, 2.0);
+    force->setEvaluationStride(3, true);
+    system.addForce(force);
+    VerletIntegrator integrator(0.01);
+    Platform& platform = Platform::getPlatformByName(platformName);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(2);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    context.setPositions(positions);
+
+    // on an evaluation step the impulse is three times the force
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(0.5, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(-3.0, state.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(3.0, state.getForces()[1][0], 1e-5);
+
+    // in between there is no force, but the energy is still current
+    positions[1] = Vec3(3.0, 0.0, 0.0);
+    context.setTime(0.01);
+    context.setPositions(positions);
+    state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(0.5, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[1][0], 1e-5);
+
+    // holding the force keeps the one from the last evaluation
+    force->setEvaluationStride(3, false);
+    context.reinitialize();
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    context.setTime(0.0);
+    context.setPositions(positions);
+    state = context.getState(State::Forces);
+    ASSERT_EQUAL_TOL(-1.0, state.getForces()[0][0], 1e-5);
+    positions[1] = Vec3(3.0, 0.0, 0.0);
+    context.setTime(0.02);
+    context.setPositions(positions);
+    state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(0.5, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(-1.0, state.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(1.0, state.getForces()[1][0], 1e-5);
+
+    // and the next evaluation picks up the new positions
+    context.setTime(0.03);
+    state = context.getState(State::Forces);
+    ASSERT_EQUAL_TOL(1.0, state.getForces()[0][0], 1e-5);
+}
+
+void testParameterSets() {
+    System system;
+    vector<Vec3> positions(3);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    positions[0] = Vec3(0.0, 0.0, 0.0);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    positions[2] = Vec3(3.0, 0.0, 0.0);
+    vector<int> group1(1, 0);
+    vector<int> group2;
+    group2.push_back(1);
+    group2.push_back(2);
+    vector<float> weights1(1, 1.0);
+    vector<float> weights2(2, 0.5);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights1, weights2, 1.0, 2.0);
+    vector<float> otherWeights2(2);
+    otherWeights2[0] = 0.0;
+    otherWeights2[1] = 1.0;
+    ASSERT_EQUAL(1, force->addParameterSet(4.0, 1.0, weights1, otherWeights2));
+    ASSERT_EQUAL(2, force->getNumParameterSets());
+    system.addForce(force);
+
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName(platformName);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    ASSERT_EQUAL(0, force->getActiveParameterSet(context));
+    ASSERT_EQUAL_TOL(0.0, context.getState(State::Energy).getPotentialEnergy(), 1e-5);
+
+    // set 1 puts all the weight on the last atom, so d = 3 and E = 0.5*4*2^2
+    force->setActiveParameterSet(context, 1);
+    ASSERT_EQUAL(1, force->getActiveParameterSet(context));
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(8.0, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(8.0, state.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[1][0], 1e-5);
+    ASSERT_EQUAL_TOL(-8.0, state.getForces()[2][0], 1e-5);
+    ASSERT_EQUAL_TOL(3.0, force->getDisplacement(context), 1e-5);
+
+    // a set added later needs updateParametersInContext() first
+    force->addParameterSet(1.0, 0.0, weights1, weights2);
+    bool threwException = false;
+    try {
+        force->setActiveParameterSet(context, 2);
+    }
+    catch (const OpenMMException& e) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+    force->updateParametersInContext(context);
+    ASSERT_EQUAL(1, force->getActiveParameterSet(context));
+    force->setActiveParameterSet(context, 2);
+    ASSERT_EQUAL_TOL(2.0, context.getState(State::Energy).getPotentialEnergy(), 1e-5);
+    force->setActiveParameterSet(context, 0);
+    ASSERT_EQUAL_TOL(0.0, context.getState(State::Energy).getPotentialEnergy(), 1e-5);
+}
+
+void testPullingWork() {
+    System system;
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    vector<int> group1(1, 0), group2(1, 1);
+    vector<float> weights(1, 1.0);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights, weights, 1.0, 2.0);
+    force->setPullingSchedule(1.0);
+    system.addForce(force);
+    VerletIntegrator integrator(0.01);
+    Platform& platform = Platform::getPlatformByName(platformName);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(2);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    context.setPositions(positions);
+    State state = context.getState(State::Energy);
+    ASSERT_EQUAL_TOL(0.5, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(0.0, force->getAccumulatedWork(context), 1e-5);
+
+    // with the particles held in place, the work is the change in energy
+    context.setTime(1.0);
+    state = context.getState(State::Energy);
+    ASSERT_EQUAL_TOL(2.0, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(1.5, force->getAccumulatedWork(context), 1e-5);
+    context.setTime(2.0);
+    state = context.getState(State::Energy);
+    ASSERT_EQUAL_TOL(4.0, force->getAccumulatedWork(context), 1e-5);
+
+    // evaluating again without a change does no work
+    state = context.getState(State::Forces);
+    ASSERT_EQUAL_TOL(4.0, force->getAccumulatedWork(context), 1e-5);
+    force->resetAccumulatedWork(context);
+    ASSERT_EQUAL_TOL(0.0, force->getAccumulatedWork(context), 1e-5);
+
+    // changing the force constant does work too
+    force->setPullingSchedule(1.0, 2.0);
+    context.setTime(3.0);
+    state = context.getState(State::Energy);
+    ASSERT_EQUAL_TOL(0.5*7.0*4.0*4.0, state.getPotentialEnergy(), 1e-4);
+    ASSERT_EQUAL_TOL(0.5*7.0*4.0*4.0-4.5, force->getAccumulatedWork(context), 1e-4);
+}
+
+void testThresholds() {
+    System system;
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    vector<int> group1(1, 0), group2(1, 1);
+    vector<float> weights(1, 1.0);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights, weights, 0.0, 0.0);
+    force->addThreshold(1.505);
+    force->addThreshold(2.5);
+    system.addForce(force);
+    VerletIntegrator integrator(0.01);
+    Platform& platform = Platform::getPlatformByName(platformName);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(2);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    context.setPositions(positions);
+    context.getState(State::Energy);
+    int threshold, direction;
+    long long step;
+    ASSERT(!force->getThresholdEvent(context, threshold, step, direction));
+
+    // the first crossing is kept until it is reset
+    positions[1] = Vec3(2.0, 0.0, 0.0);
+    context.setTime(0.05);
+    context.setPositions(positions);
+    context.getState(State::Energy);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    context.setTime(0.06);
+    context.setPositions(positions);
+    context.getState(State::Energy);
+    ASSERT(force->getThresholdEvent(context, threshold, step, direction));
+    ASSERT_EQUAL(0, threshold);
+    ASSERT_EQUAL(5, step);
+    ASSERT_EQUAL(1, direction);
+
+    // after a reset the next evaluation is only a starting point, and when
+    // several thresholds are crossed at once the one the trajectory passed
+    // first is reported
+    force->resetThresholdEvent(context);
+    positions[1] = Vec3(3.0, 0.0, 0.0);
+    context.setTime(0.07);
+    context.setPositions(positions);
+    context.getState(State::Energy);
+    ASSERT(!force->getThresholdEvent(context, threshold, step, direction));
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    context.setTime(0.08);
+    context.setPositions(positions);
+    context.getState(State::Energy);
+    ASSERT(force->getThresholdEvent(context, threshold, step, direction));
+    ASSERT_EQUAL(1, threshold);
+    ASSERT_EQUAL(8, step);
+    ASSERT_EQUAL(-1, direction);
+
+    // steps past the range of an int are reported in full
+    force->resetThresholdEvent(context);
+    context.setTime(30000000.0);
+    context.getState(State::Energy);
+    positions[1] = Vec3(2.0, 0.0, 0.0);
+    context.setTime(30000000.01);
+    context.setPositions(positions);
+    context.getState(State::Energy);
+    ASSERT(force->getThresholdEvent(context, threshold, step, direction));
+    ASSERT_EQUAL(0, threshold);
+    ASSERT_EQUAL(3000000001LL, step);
+    ASSERT_EQUAL(1, direction);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+
+    // moving apart at 1 nm/ps, the first threshold is crossed on step 51,
+    // which is seen at the end of the block that contains it
+    force->resetThresholdEvent(context);
+    context.setTime(0.0);
+    context.setPositions(positions);
+    vector<Vec3> velocities(2);
+    velocities[1] = Vec3(1.0, 0.0, 0.0);
+    context.setVelocities(velocities);
+    ASSERT_EQUAL(60, force->stepUntilThreshold(context, 1000, 20));
+    ASSERT(force->getThresholdEvent(context, threshold, step, direction));
+    ASSERT_EQUAL(0, threshold);
+    ASSERT_EQUAL(51, step);
+    ASSERT_EQUAL(1, direction);
+}
+
+void publishParameters(OneDimComForce* force, Context* context) {
+    force->publishParameters(*context, 2.0, 1.0);
+}
+
+void testPublishedParameters() {
+    System system;
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    vector<int> group1(1, 0), group2(2);
+    group2[0] = 1;
+    group2[1] = 2;
+    vector<float> weights1(1, 1.0), weights2(2, 0.5);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights1, weights2, 1.0, 0.0);
+    system.addForce(force);
+    VerletIntegrator integrator(0.01);
+    Platform& platform = Platform::getPlatformByName(platformName);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(3);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    positions[2] = Vec3(3.0, 0.0, 0.0);
+    context.setPositions(positions);
+    ASSERT_EQUAL_TOL(2.0, context.getState(State::Energy).getPotentialEnergy(), 1e-5);
+
+    // values published from another thread are picked up by the next
+    // evaluation, without changing the force itself
+    thread controller(publishParameters, force, &context);
+    controller.join();
+    ASSERT_EQUAL_TOL(1.0, context.getState(State::Energy).getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(1.0, force->getForceConst(), 1e-5);
+
+    // only the newest of several publications is used
+    vector<float> newWeights2(2, 0.0);
+    newWeights2[0] = 1.0;
+    force->publishParameters(context, 3.0, 0.0);
+    force->publishParameters(context, 4.0, 0.0, weights1, newWeights2);
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(2.0, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(-4.0, state.getForces()[1][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[2][0], 1e-5);
+
+    // updating the parameters goes back to those of the force
+    force->updateParametersInContext(context);
+    state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(2.0, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(-1.0, state.getForces()[2][0], 1e-5);
+}
+
+void testPublishedParameterSets() {
+    System system;
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    vector<int> group1(1, 0), group2(2);
+    group2[0] = 1;
+    group2[1] = 2;
+    vector<float> weights1(1, 1.0), weights2(2, 0.5);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights1, weights2, 1.0, 0.0);
+    vector<float> otherWeights2(2, 0.0);
+    otherWeights2[1] = 1.0;
+    force->addParameterSet(4.0, 1.0, weights1, otherWeights2);
+    system.addForce(force);
+    VerletIntegrator integrator(0.01);
+    Platform& platform = Platform::getPlatformByName(platformName);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(3);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    positions[2] = Vec3(3.0, 0.0, 0.0);
+    context.setPositions(positions);
+
+    // publish over set 0, which puts all the weight of group 2 on atom 1
+    vector<float> publishedWeights2(2, 0.0);
+    publishedWeights2[0] = 1.0;
+    force->publishParameters(context, 2.0, 0.0, weights1, publishedWeights2);
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(1.0, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(-2.0, state.getForces()[1][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[2][0], 1e-5);
+
+    // set 1 is untouched by the publication
+    force->setActiveParameterSet(context, 1);
+    state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(8.0, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[1][0], 1e-5);
+    ASSERT_EQUAL_TOL(-8.0, state.getForces()[2][0], 1e-5);
+
+    // and switching back drops the published values, so set 0 has its own
+    // force constant, r0 and weights again
+    force->setActiveParameterSet(context, 0);
+    state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(2.0, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(-1.0, state.getForces()[1][0], 1e-5);
+    ASSERT_EQUAL_TOL(-1.0, state.getForces()[2][0], 1e-5);
+    ASSERT_EQUAL_TOL(2.0, force->getDisplacement(context), 1e-5);
+}
+
+void testVariance() {
+    System system;
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    vector<int> group1(2), group2(1, 2);
+    group1[0] = 0;
+    group1[1] = 1;
+    vector<float> weights1(2, 0.5), weights2(1, 1.0);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights1, weights2, 1.0, 4.0);
+    force->setVarianceRestraint(1, 2.0, 0.5);
+    system.addForce(force);
+    VerletIntegrator integrator(0.01);
+    Platform& platform = Platform::getPlatformByName(platformName);
+    Context context(system, integrator, platform);
+
+    // the groups are at 1 and 5, so only the variance of 1 is restrained,
+    // and the result does not depend on where along the axis they are
+    for (int i=0; i<2; ++i) {
+        double offset = 100.0*i;
+        vector<Vec3> positions(3);
+        positions[0] = Vec3(offset, 0.0, 0.0);
+        positions[1] = Vec3(offset+2.0, 0.0, 0.0);
+        positions[2] = Vec3(offset+5.0, 0.0, 0.0);
+        context.setPositions(positions);
+        State state = context.getState(State::Energy | State::Forces);
+        ASSERT_EQUAL_TOL(0.25, state.getPotentialEnergy(), 1e-4);
+        ASSERT_EQUAL_TOL(1.0, force->getVariance(context), 1e-4);
+        ASSERT_EQUAL_TOL(1.0, state.getForces()[0][0], 1e-4);
+        ASSERT_EQUAL_TOL(-1.0, state.getForces()[1][0], 1e-4);
+        ASSERT_EQUAL_TOL(0.0, state.getForces()[2][0], 1e-4);
+    }
+}
+
+void testVarianceEnergies() {
+    // the system of testVariance(), where the variance restraint is the only
+    // term with any energy
+    System system;
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    vector<int> group1(2), group2(1, 2);
+    group1[0] = 0;
+    group1[1] = 1;
+    vector<float> weights1(2, 0.5), weights2(1, 1.0);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights1, weights2, 1.0, 4.0);
+    force->setVarianceRestraint(1, 2.0, 0.5);
+    force->setColvarFile("TestOneDimComForceVariance.dat", 100);
+    system.addForce(force);
+    vector<Vec3> positions(3);
+    positions[1] = Vec3(2.0, 0.0, 0.0);
+    positions[2] = Vec3(5.0, 0.0, 0.0);
+
+    // the file is complete once the context is destroyed
+    {
+        VerletIntegrator integrator(0.001);
+        Platform& platform = Platform::getPlatformByName(platformName);
+        Context context(system, integrator, platform);
+        context.setPositions(positions);
+
+        // every window gets the same variance term
+        vector<double> ks(2), r0s(2);
+        ks[0] = 1.0;
+        r0s[0] = 4.0;
+        ks[1] = 2.0;
+        r0s[1] = 2.0;
+        vector<double> energies = force->computeWindowEnergies(context, ks, r0s);
+        ASSERT_EQUAL_TOL(0.25, energies[0], 1e-4);
+        ASSERT_EQUAL_TOL(4.25, energies[1], 1e-4);
+        integrator.step(1);
+    }
+
+    // and so does the energy of the colvar file
+    OneDimComColvarReader reader("TestOneDimComForceVariance.dat");
+    ASSERT_EQUAL(1, reader.getNumRecords());
+    ASSERT_EQUAL_TOL(4.0, reader.getDisplacements()[0], 1e-4);
+    ASSERT_EQUAL_TOL(0.25, reader.getEnergies()[0], 1e-4);
+    remove("TestOneDimComForceVariance.dat");
+}
+
+void testEvaluationVariants() {
+    System system;
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    vector<int> group1(1, 0), group2(1, 1);
+    vector<float> weights(1, 1.0);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights, weights, 2.0, 0.5);
+    system.addForce(force);
+    VerletIntegrator integrator(0.01);
+    Platform& platform = Platform::getPlatformByName(platformName);
+    vector<Vec3> positions(2);
+    positions[1] = Vec3(2.0, 0.0, 0.0);
+
+    // energy only, forces only and both give the same results, whether
+    // the displacement is reduced again or taken from the cache
+    for (int cache=0; cache<2; ++cache) {
+        force->setUseEvaluationCache(cache == 1);
+        Context context(system, integrator, platform);
+        context.setPositions(positions);
+        for (int repeat=0; repeat<2; ++repeat) {
+            ASSERT_EQUAL_TOL(2.25, context.getState(State::Energy).getPotentialEnergy(), 1e-5);
+            State state = context.getState(State::Forces);
+            ASSERT_EQUAL_TOL(3.0, state.getForces()[0][0], 1e-5);
+            ASSERT_EQUAL_TOL(-3.0, state.getForces()[1][0], 1e-5);
+            state = context.getState(State::Energy | State::Forces);
+            ASSERT_EQUAL_TOL(2.25, state.getPotentialEnergy(), 1e-5);
+            ASSERT_EQUAL_TOL(-3.0, state.getForces()[1][0], 1e-5);
+        }
+    }
+    // and the same holds for a collective variable, whose energy is the
+    // displacement of 2
+    force->setUseAsCollectiveVariable(true);
+    for (int cache=0; cache<2; ++cache) {
+        force->setUseEvaluationCache(cache == 1);
+        Context context(system, integrator, platform);
+        context.setPositions(positions);
+        for (int repeat=0; repeat<2; ++repeat) {
+            ASSERT_EQUAL_TOL(2.0, context.getState(State::Energy).getPotentialEnergy(), 1e-5);
+            State state = context.getState(State::Forces);
+            ASSERT_EQUAL_TOL(1.0, state.getForces()[0][0], 1e-5);
+            ASSERT_EQUAL_TOL(-1.0, state.getForces()[1][0], 1e-5);
+            state = context.getState(State::Energy | State::Forces);
+            ASSERT_EQUAL_TOL(2.0, state.getPotentialEnergy(), 1e-5);
+            ASSERT_EQUAL_TOL(-1.0, state.getForces()[1][0], 1e-5);
+        }
+    }
+}
+
+void testCachedPositions() {
+    // the system of testVariance(), with the evaluation cache enabled
+    System system;
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    vector<int> group1(2), group2(1, 2);
+    group1[0] = 0;
+    group1[1] = 1;
+    vector<float> weights1(2, 0.5), weights2(1, 1.0);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights1, weights2, 1.0, 4.0);
+    force->setVarianceRestraint(1, 2.0, 0.5);
+    force->setUseEvaluationCache(true);
+    system.addForce(force);
+    VerletIntegrator integrator(0.01);
+    Platform& platform = Platform::getPlatformByName(platformName);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(3);
+    positions[1] = Vec3(2.0, 0.0, 0.0);
+    positions[2] = Vec3(5.0, 0.0, 0.0);
+    context.setPositions(positions);
+    ASSERT_EQUAL_TOL(0.25, context.getState(State::Energy).getPotentialEnergy(), 1e-4);
+    ASSERT_EQUAL_TOL(0.25, context.getState(State::Energy).getPotentialEnergy(), 1e-4);
+
+    // spreading group 1 without advancing time gives a displacement of 3.5
+    // and a variance of 2.25, which the cache must not hide
+    positions[1] = Vec3(3.0, 0.0, 0.0);
+    context.setPositions(positions);
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(0.125+3.0625, state.getPotentialEnergy(), 1e-4);
+    ASSERT_EQUAL_TOL(2.25, force->getVariance(context), 1e-4);
+    ASSERT_EQUAL_TOL(3.5, force->getDisplacement(context), 1e-4);
+    ASSERT_EQUAL_TOL(0.5, state.getForces()[2][0], 1e-4);
+}
+
+void testLazyKernel() {
+    System system;
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    vector<int> group1(1, 0), group2(1, 1);
+    vector<float> weights(1, 1.0);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights, weights, 1.0, 2.0);
+    force->setForceGroup(1);
+    system.addForce(force);
+    VerletIntegrator integrator(0.01);
+    Platform& platform = Platform::getPlatformByName(platformName);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(2);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    context.setPositions(positions);
+
+    // evaluations that leave out the force's group, and queries of state it
+    // doesn't have yet, work without the kernel
+    ASSERT_EQUAL_TOL(0.0, context.getState(State::Energy, false, 1).getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(0.0, force->getAccumulatedWork(context), 1e-5);
+    force->setR0(3.0);
+    force->updateParametersInContext(context);
+
+    // and the first one that includes it sees the current parameters
+    ASSERT_EQUAL_TOL(2.0, context.getState(State::Energy, false, 2).getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(1.0, force->getDisplacement(context), 1e-5);
+}
+
+void testExtendedLagrangian() {
+    // the particles have no mass, so the displacement stays at 1
+    System system;
+    system.addParticle(0.0);
+    system.addParticle(0.0);
+    vector<int> group1(1, 0), group2(1, 1);
+    vector<float> weights(1, 1.0);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights, weights, 1.0, 2.0);
+    force->setExtendedLagrangian("s", 1.0, 0.0, 0.0);
+    system.addForce(force);
+    VerletIntegrator integrator(0.01);
+    Platform& platform = Platform::getPlatformByName(platformName);
+    Context context(system, integrator, platform);
+    vector<Vec3> positions(2);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    context.setPositions(positions);
+
+    // r0 starts at the force's value and follows the parameter
+    ASSERT_EQUAL_TOL(2.0, context.getParameter("s"), 1e-6);
+    ASSERT_EQUAL_TOL(0.0, context.getParameter("sVelocity"), 1e-6);
+    context.setParameter("s", 3.0);
+    ASSERT_EQUAL_TOL(2.0, context.getState(State::Energy).getPotentialEnergy(), 1e-5);
+
+    // without a thermostat r0 oscillates about the displacement as
+    // s = 1 + 2*cos(t)
+    context.setParameter("s", 3.0);
+    integrator.step(100);
+    ASSERT_EQUAL_TOL(1.0+2.0*cos(1.0), context.getParameter("s"), 2e-2);
+    ASSERT_EQUAL_TOL(-2.0*sin(1.0), context.getParameter("sVelocity"), 2e-2);
+
+    // moving r0 is part of the dynamics rather than work done on the system
+    ASSERT_EQUAL_TOL(0.0, force->getAccumulatedWork(context), 1e-5);
+}
+
+void testExtendedLagrangianCheckpoint() {
+    // a thermostatted r0 continued from a checkpoint gets the same noise as
+    // one that runs straight through
+    System system;
+    system.addParticle(0.0);
+    system.addParticle(0.0);
+    vector<int> group1(1, 0), group2(1, 1);
+    vector<float> weights(1, 1.0);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights, weights, 1.0, 2.0);
+    force->setExtendedLagrangian("s", 1.0, 3000.0, 5.0, 1234);
+    system.addForce(force);
+    Platform& platform = Platform::getPlatformByName(platformName);
+    vector<Vec3> positions(2);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+
+    VerletIntegrator integrator1(0.01);
+    Context context1(system, integrator1, platform);
+    context1.setPositions(positions);
+    integrator1.step(20);
+
+    VerletIntegrator integrator2(0.01);
+    Context context2(system, integrator2, platform);
+    context2.setPositions(positions);
+    integrator2.step(10);
+    stringstream checkpoint;
+    context2.createCheckpoint(checkpoint);
+    VerletIntegrator integrator3(0.01);
+    Context context3(system, integrator3, platform);
+    context3.loadCheckpoint(checkpoint);
+    integrator3.step(10);
+    ASSERT_EQUAL_TOL(context1.getParameter("s"), context3.getParameter("s"), 1e-5);
+    ASSERT_EQUAL_TOL(context1.getParameter("sVelocity"), context3.getParameter("sVelocity"), 1e-5);
+
+    // loading it back into a context that has moved on must not drive r0
+    // with a displacement left over from before the load
+    vector<Vec3> moved(2);
+    moved[1] = Vec3(4.0, 0.0, 0.0);
+    context2.setPositions(moved);
+    integrator2.step(10);
+    checkpoint.seekg(0);
+    context2.loadCheckpoint(checkpoint);
+    integrator2.step(10);
+    ASSERT_EQUAL_TOL(context1.getParameter("s"), context2.getParameter("s"), 1e-5);
+    ASSERT_EQUAL_TOL(context1.getParameter("sVelocity"), context2.getParameter("sVelocity"), 1e-5);
+}
+
+void testOverlappingConstraint() {
+    // particle 1 is in both groups with no net weight, so the constraint
+    // must leave it alone and move the others by half the difference each
+    System system;
+    system.addParticle(1.0);
+    system.addParticle(2.0);
+    system.addParticle(1.0);
+    vector<Vec3> positions(3);
+    positions[0] = Vec3(-1.0, 0.0, 0.0);
+    positions[2] = Vec3(1.0, 0.0, 0.0);
+    vector<int> group1, group2;
+    group1.push_back(0);
+    group1.push_back(1);
+    group2.push_back(1);
+    group2.push_back(2);
+    vector<float> weights(2, 0.5);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights, weights, 1000.0, 1.5);
+    force->setUseConstraint(true);
+    system.addForce(force);
+    VerletIntegrator integrator(0.01);
+    Platform& platform = Platform::getPlatformByName(platformName);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    for (int i=0; i<5; ++i) {
+        integrator.step(1);
+        State state = context.getState(State::Positions | State::Velocities);
+        ASSERT_EQUAL_TOL(1.5, force->getDisplacement(context), 1e-5);
+        ASSERT_EQUAL_TOL(-1.5, state.getPositions()[0][0], 1e-5);
+        ASSERT_EQUAL_TOL(0.0, state.getPositions()[1][0], 1e-5);
+        ASSERT_EQUAL_TOL(1.5, state.getPositions()[2][0], 1e-5);
+        ASSERT_EQUAL_TOL(0.0, state.getVelocities()[0][0], 1e-4);
+        ASSERT_EQUAL_TOL(0.0, state.getVelocities()[2][0], 1e-4);
+    }
+}
+
+void testColvarRecords() {
+    // more records than the kernel holds at once must all arrive, in order
+    System system;
+    system.addParticle(1.0);
+    system.addParticle(1.0);
+    vector<int> group1(1, 0), group2(1, 1);
+    vector<float> weights(1, 1.0);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights, weights, 1.0, 2.0);
+    force->setColvarFile("TestOneDimComForceRecords.dat", 1);
+    system.addForce(force);
+    int numSteps = 3*CalcOneDimComForceKernel::MaxRecordedDisplacements;
+    {
+        VerletIntegrator integrator(0.001);
+        Platform& platform = Platform::getPlatformByName(platformName);
+        Context context(system, integrator, platform);
+        vector<Vec3> positions(2);
+        positions[1] = Vec3(1.0, 0.0, 0.0);
+        context.setPositions(positions);
+        integrator.step(numSteps);
+
+        // a second Context must not truncate the file the first is writing
+        VerletIntegrator integrator2(0.001);
+        bool threw = false;
+        try {
+            Context context2(system, integrator2, platform);
+        }
+        catch (OpenMMException& ex) {
+            threw = true;
+        }
+        ASSERT(threw);
+    }
+    OneDimComColvarReader reader("TestOneDimComForceRecords.dat");
+    ASSERT_EQUAL(numSteps, reader.getNumRecords());
+    for (int i=0; i<numSteps; ++i) {
+        ASSERT_EQUAL(i, reader.getSteps()[i]);
+        double displacement = reader.getDisplacements()[i];
+        ASSERT_EQUAL_TOL(0.5*(displacement-2.0)*(displacement-2.0), reader.getEnergies()[i], 1e-5);
+    }
+    ASSERT_EQUAL_TOL(1.0, reader.getDisplacements()[0], 1e-5);
+    remove("TestOneDimComForceRecords.dat");
+}
+
+void testBatchEvaluator() {
+    // the batch evaluator works on the host, but every frame should match
+    // what the platform computes for it, variance restraint included
+    const int numAtoms = 5;
+    const int numFrames = 20;
+    System system;
+    for (int i=0; i<numAtoms; ++i)
+        system.addParticle(1.0);
+    vector<int> group1, group2;
+    vector<float> weights1, weights2;
+    group1.push_back(0);
+    group1.push_back(1);
+    weights1.push_back(0.25);
+    weights1.push_back(0.75);
+    group2.push_back(3);
+    group2.push_back(4);
+    weights2.push_back(0.5);
+    weights2.push_back(0.5);
+    OneDimComForce* force = new OneDimComForce(group1, group2, weights1, weights2, 2.0, 1.5);
+    force->setVarianceRestraint(2, 3.0, 0.5);
+    system.addForce(force);
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName(platformName);
+    Context context(system, integrator, platform);
+
+    vector<float> frames(numFrames*numAtoms*3);
+    srand(0);
+    for (int i=0; i<frames.size(); ++i)
+        frames[i] = 10.0*rand()/RAND_MAX;
+    vector<double> displacements(numFrames), energies(numFrames);
+    OneDimComBatchEvaluator evaluator(*force);
+    evaluator.evaluate(&frames[0], numAtoms, numFrames, &displacements[0], &energies[0]);
+    for (int frame=0; frame<numFrames; ++frame) {
+        vector<Vec3> positions(numAtoms);
+        for (int i=0; i<numAtoms; ++i)
+            positions[i] = Vec3(frames[3*(frame*numAtoms+i)], frames[3*(frame*numAtoms+i)+1], frames[3*(frame*numAtoms+i)+2]);
+        context.setPositions(positions);
+        State state = context.getState(State::Energy);
+        ASSERT_EQUAL_TOL(force->getDisplacement(context), displacements[frame], 1e-5);
+        ASSERT_EQUAL_TOL(state.getPotentialEnergy(), energies[frame], 1e-4);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        initializeTests(argc, argv);
+        testCollectiveVariable();
+        testEvaluationStride();
+        testParameterSets();
+        testPullingWork();
+        testThresholds();
+        testPublishedParameters();
+        testPublishedParameterSets();
+        testVariance();
+        testVarianceEnergies();
+        testEvaluationVariants();
+        testCachedPositions();
+        testLazyKernel();
+        testExtendedLagrangian();
+        testExtendedLagrangianCheckpoint();
+        testOverlappingConstraint();
+        testColvarRecords();
+        testBatchEvaluator();
+        runPlatformTests();
+    }
+    catch(const std::exception& e) {
+        std::cout << "exception: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Done" << std::endl;
+    return 0;
+}
@@ -0,0 +1,135 @@
+/**
+ * Tests of OneDimComPairwiseForce that every platform must pass.  See
+ * TestOneDimComForce.h for how a platform's test program uses them.
+ */
+
+#include "OneDimComPairwiseForce.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/Context.h"
+#include "openmm/Platform.h"
+#include "openmm/System.h"
+#include "openmm/VerletIntegrator.h"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+void runPlatformTests();
+
+OneDimComPairwiseForce* createThreeGroupForce() {
+    // three groups (atom 0, atoms 1 and 2, atom 3), with atom 4 left out
+    // in order to catch stupid indexing errors
+    OneDimComPairwiseForce* force = new OneDimComPairwiseForce();
+    force->addGroup(vector<int>(1, 0), vector<float>(1, 1.0));
+
+    vector<int> middle;
+    vector<float> middleWeights;
+    middle.push_back(1);
+    middle.push_back(2);
+    middleWeights.push_back(0.5);
+    middleWeights.push_back(0.5);
+    force->addGroup(middle, middleWeights);
+
+    force->addGroup(vector<int>(1, 3), vector<float>(1, 1.0));
+
+    force->addPair(0, 1, 2.0, 1.0);
+    force->addPair(1, 2, 1.0, 4.0, OneDimComPairwiseForce::UpperWall);
+    force->addPair(0, 2, 1.0, 6.0, OneDimComPairwiseForce::LowerWall);
+    return force;
+}
+
+vector<Vec3> createPositions(System& system) {
+    vector<Vec3> positions(5);
+    for (int i=0; i<5; ++i)
+        system.addParticle(1.0);
+    positions[0] = Vec3(0.0, 0.0, 0.0);
+    positions[1] = Vec3(1.0, 0.0, 0.0);
+    positions[2] = Vec3(3.0, 0.0, 0.0);
+    positions[3] = Vec3(5.0, 0.0, 0.0);
+    positions[4] = Vec3(100.0, 0.0, 0.0);
+    return positions;
+}
+
+void testPairs() {
+    System system;
+    vector<Vec3> positions = createPositions(system);
+    system.addForce(createThreeGroupForce());
+
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName(platformName);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+
+    State state = context.getState(State::Energy | State::Forces);
+
+    // the centers are 0, 2 and 5, so the upper wall at 4 between groups 1
+    // and 2 is inactive, and the lower wall at 6 between groups 0 and 2 is not
+    ASSERT_EQUAL_TOL(0.5 * 2.0 * 1.0 * 1.0 + 0.5 * 1.0 * 1.0 * 1.0, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(1.0, state.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(-1.0, state.getForces()[1][0], 1e-5);
+    ASSERT_EQUAL_TOL(-1.0, state.getForces()[2][0], 1e-5);
+    ASSERT_EQUAL_TOL(1.0, state.getForces()[3][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[4][0], 1e-5);
+}
+
+void testChangingParameters() {
+    System system;
+    vector<Vec3> positions = createPositions(system);
+    OneDimComPairwiseForce* force = createThreeGroupForce();
+    system.addForce(force);
+
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName(platformName);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+
+    // turn the upper wall into a harmonic restraint, and add a pair
+    force->setPairParameters(1, 1, 2, 1.0, 4.0, OneDimComPairwiseForce::Harmonic);
+    force->addPair(2, 1, 3.0, -3.0);
+    force->updateParametersInContext(context);
+
+    // pair 1 has delta = -1 and the new pair has delta = 0
+    State state = context.getState(State::Energy | State::Forces);
+    ASSERT_EQUAL_TOL(1.0 + 0.5 + 0.5, state.getPotentialEnergy(), 1e-5);
+    ASSERT_EQUAL_TOL(1.0, state.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(-1.5, state.getForces()[1][0], 1e-5);
+    ASSERT_EQUAL_TOL(-1.5, state.getForces()[2][0], 1e-5);
+    ASSERT_EQUAL_TOL(2.0, state.getForces()[3][0], 1e-5);
+    ASSERT_EQUAL_TOL(0.0, state.getForces()[4][0], 1e-5);
+}
+
+void testEvaluationVariants() {
+    // energy only and forces only give the same results as both together
+    System system;
+    vector<Vec3> positions = createPositions(system);
+    system.addForce(createThreeGroupForce());
+    VerletIntegrator integrator(1.0);
+    Platform& platform = Platform::getPlatformByName(platformName);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    ASSERT_EQUAL_TOL(1.5, context.getState(State::Energy).getPotentialEnergy(), 1e-5);
+    State state = context.getState(State::Forces);
+    ASSERT_EQUAL_TOL(1.0, state.getForces()[0][0], 1e-5);
+    ASSERT_EQUAL_TOL(-1.0, state.getForces()[2][0], 1e-5);
+    ASSERT_EQUAL_TOL(1.0, state.getForces()[3][0], 1e-5);
+    ASSERT_EQUAL_TOL(1.5, context.getState(State::Energy).getPotentialEnergy(), 1e-5);
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        initializeTests(argc, argv);
+        testPairs();
+        testChangingParameters();
+        testEvaluationVariants();
+        runPlatformTests();
+    }
+    catch(const std::exception& e) {
+        std::cout << "exception: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Done" << std::endl;
+    return 0;
+}
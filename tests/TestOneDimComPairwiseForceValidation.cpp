@@ -0,0 +1,73 @@
+#include "OneDimComPairwiseForce.h"
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/OpenMMException.h"
+#include <iostream>
+#include <vector>
+
+using namespace OneDimComPlugin;
+using namespace OpenMM;
+using namespace std;
+
+void testBadPair() {
+    // a pair must refer to two different groups that exist
+    OneDimComPairwiseForce force;
+    force.addGroup(vector<int>(1, 0), vector<float>(1, 1.0));
+    force.addGroup(vector<int>(1, 1), vector<float>(1, 1.0));
+    bool threw = false;
+    try {
+        force.addPair(0, 2, 1.0, 1.0);
+    }
+    catch (OpenMMException e) {
+        threw = true;
+    }
+    ASSERT(threw);
+
+    // the rejected pair must not have been stored, so the force is still usable
+    ASSERT_EQUAL(0, force.getNumPairs());
+    force.validate();
+    ASSERT_EQUAL(0, force.addPair(0, 1, 1.0, 1.0));
+
+    threw = false;
+    try {
+        force.setPairParameters(0, 1, 1, 1.0, 1.0);
+    }
+    catch (OpenMMException e) {
+        threw = true;
+    }
+    ASSERT(threw);
+    int group1, group2;
+    float k, r0;
+    OneDimComPairwiseForce::PairType type;
+    force.getPairParameters(0, group1, group2, k, r0, type);
+    ASSERT_EQUAL(0, group1);
+    ASSERT_EQUAL(1, group2);
+}
+
+void testBadGroup() {
+    // a group whose weights do not sum to 1 is rejected and not stored
+    OneDimComPairwiseForce force;
+    force.addGroup(vector<int>(1, 0), vector<float>(1, 1.0));
+    bool threw = false;
+    try {
+        force.addGroup(vector<int>(1, 1), vector<float>(1, 0.5));
+    }
+    catch (OpenMMException e) {
+        threw = true;
+    }
+    ASSERT(threw);
+    ASSERT_EQUAL(1, force.getNumGroups());
+    force.validate();
+}
+
+int main() {
+    try {
+        testBadPair();
+        testBadGroup();
+    }
+    catch(const exception& e) {
+        cout << "exception: " << e.what() << endl;
+        return 1;
+    }
+    cout << "Done" << endl;
+    return 0;
+}